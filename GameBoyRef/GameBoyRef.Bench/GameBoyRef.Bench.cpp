@@ -0,0 +1,77 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include "benchmarks.h"
+#include "hostcounters.h"
+
+static void usage() {
+	std::cerr
+		<< "usage: gameboyref-bench [options]\n"
+		<< "  --suite NAME        opcodes, random, memory, run or all (default)\n"
+		<< "  --repeat N          timed runs per measurement, default 5\n"
+		<< "  --passes N          passes over each opcode workload, default 10\n"
+		<< "  --instructions N    instructions or memory operations per run, default 10000000\n"
+		<< "  --perf              host hardware counters per guest opcode class (Linux)\n";
+}
+
+int main(int argc, char *argv[]) {
+	gameboy::BenchOptions options = { 5, 10, 10000000 };
+	std::string suite = "all";
+	bool perf = false;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--perf") == 0) {
+			perf = true;
+		}
+		else if (strcmp(argv[i], "--suite") == 0 && i + 1 < argc) {
+			suite = argv[++i];
+		}
+		else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+			options.repeat = (unsigned int)strtoul(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--passes") == 0 && i + 1 < argc) {
+			options.passes = (unsigned int)strtoul(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--instructions") == 0 && i + 1 < argc) {
+			options.instructions = strtoull(argv[++i], nullptr, 10);
+		}
+		else {
+			usage();
+			return 1;
+		}
+	}
+
+	if (options.repeat == 0 || options.passes == 0 || options.instructions == 0) {
+		usage();
+		return 1;
+	}
+
+	if (perf) {
+		if (!gameboy::runHostCounters(std::cout, options.passes)) {
+			std::cerr << "perf_event_open isn't available, check /proc/sys/kernel/perf_event_paranoid\n";
+			return 1;
+		}
+		return 0;
+	}
+
+	bool all = suite == "all";
+	if (!all && suite != "opcodes" && suite != "random" && suite != "memory" && suite != "run") {
+		usage();
+		return 1;
+	}
+
+	if (all || suite == "random") {
+		gameboy::benchRandomStream(std::cout, options);
+	}
+	if (all || suite == "memory") {
+		gameboy::benchMemory(std::cout, options);
+	}
+	if (all || suite == "run") {
+		gameboy::benchRun(std::cout, options);
+	}
+	if (all || suite == "opcodes") {
+		gameboy::benchOpcodes(std::cout, options);
+	}
+	return 0;
+}
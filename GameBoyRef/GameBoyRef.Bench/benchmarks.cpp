@@ -0,0 +1,276 @@
+#include "benchmarks.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <vector>
+#include "core.h"
+#include "cpuregisters.h"
+#include "functions.h"
+#include "lockstep.h"
+#include "memory.h"
+#include "oracle.h"
+#include "oraclecache.h"
+#include "workload.h"
+
+namespace gameboy {
+	static const double DmgClock = 4194304.0;
+	static volatile uint32_t sink; // Keeps results the compiler would otherwise discard
+
+	struct Stats {
+		double median;
+		double min;
+		double mean;
+		double stddev;
+	};
+
+	static Stats summarize(std::vector<double> samples) {
+		std::sort(samples.begin(), samples.end());
+		Stats stats;
+		size_t count = samples.size();
+		stats.median = count % 2 ? samples[count / 2] : (samples[count / 2 - 1] + samples[count / 2]) / 2;
+		stats.min = samples.front();
+
+		double sum = 0;
+		for (auto it = samples.begin(); it != samples.end(); ++it) {
+			sum += *it;
+		}
+		stats.mean = sum / count;
+
+		double squares = 0;
+		for (auto it = samples.begin(); it != samples.end(); ++it) {
+			squares += (*it - stats.mean) * (*it - stats.mean);
+		}
+		stats.stddev = count > 1 ? sqrt(squares / (count - 1)) : 0;
+		return stats;
+	}
+
+	// Runs body once to warm up, then repeat times, and returns ns per
+	// operation for each timed run. body returns the operations it did.
+	template <typename Body>
+	static Stats measure(unsigned int repeat, Body body) {
+		body();
+
+		std::vector<double> samples;
+		for (unsigned int i = 0; i < repeat; i++) {
+			auto start = std::chrono::steady_clock::now();
+			uint64_t operations = body();
+			auto elapsed = std::chrono::steady_clock::now() - start;
+			samples.push_back(std::chrono::duration<double, std::nano>(elapsed).count() / operations);
+		}
+		return summarize(samples);
+	}
+
+	static void printHeader(std::ostream &out, const char *name) {
+		out << std::left << std::setw(16) << name << std::right
+			<< std::setw(12) << "ns/op"
+			<< std::setw(12) << "min"
+			<< std::setw(12) << "mean"
+			<< std::setw(12) << "stddev"
+			<< std::setw(12) << "MIPS" << "\n";
+	}
+
+	static void printRow(std::ostream &out, const std::string &name, const Stats &stats) {
+		out << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(2)
+			<< std::setw(12) << stats.median
+			<< std::setw(12) << stats.min
+			<< std::setw(12) << stats.mean
+			<< std::setw(12) << stats.stddev
+			<< std::setw(12) << std::setprecision(stats.median > 1000 ? 5 : 2) << 1000.0 / stats.median << "\n";
+	}
+
+	// Every defined opcode on its own, 0xCBxx for the CB table
+	void benchOpcodes(std::ostream &out, const BenchOptions &options) {
+		printHeader(out, "opcode");
+
+		std::vector<uint16_t> opCodes = Workload::getDefined();
+		for (auto it = opCodes.begin(); it != opCodes.end(); ++it) {
+			Workload workload(std::vector<uint16_t>(1, *it), *it);
+			Stats stats = measure(options.repeat, [&] { return workload.run(options.passes); });
+
+			char name[8];
+			snprintf(name, sizeof(name), *it >= 0x100 ? "0xCB%02X" : "0x%02X", *it & 0xFF);
+			printRow(out, name, stats);
+		}
+	}
+
+	// Mirrors CpuRandomInstructionBenchmark: memory full of random bytes but
+	// never HALT, the core runs free. Every batch starts from a fork of the
+	// untouched image so code the stream overwrites can't stall it.
+	void benchRandomStream(std::ostream &out, const BenchOptions &options) {
+		static const uint64_t BatchSize = 0x10000;
+
+		std::mt19937 random(0x5EED);
+		Core pristine;
+		for (uint32_t address = 0; address < 0x10000; address++) {
+			uint8_t value = random();
+			pristine.memory->write(address, value == 0x76 ? 0x77 : value);
+		}
+		pristine.registers->pc = 0x0100;
+		pristine.registers->setSP(0xFFFE);
+
+		uint64_t cycles = 0;
+		double seconds = 0;
+		Stats stats = measure(options.repeat, [&] {
+			auto start = std::chrono::steady_clock::now();
+			uint64_t executed = 0;
+			while (executed < options.instructions) {
+				Core *core = pristine.fork();
+				for (uint64_t i = 0; i < BatchSize; i++) {
+					core->emulateCycle();
+				}
+				cycles += core->getClock();
+				executed += BatchSize;
+				delete core;
+			}
+			seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			return executed;
+		});
+
+		printHeader(out, "stream");
+		printRow(out, "random", stats);
+		out << "speedup over DMG: " << std::setprecision(1) << cycles * 4 / seconds / DmgClock << "x\n";
+	}
+
+	// Random addresses across the whole map, reads see a mix of written and untouched pages
+	void benchMemory(std::ostream &out, const BenchOptions &options) {
+		static const unsigned int Count = 0x1000;
+
+		std::mt19937 random(0x5EED);
+		std::vector<uint16_t> addresses(Count);
+		std::vector<uint8_t> values(Count);
+		for (unsigned int i = 0; i < Count; i++) {
+			addresses[i] = random();
+			values[i] = random();
+		}
+
+		Memory memory;
+		for (unsigned int i = 0; i < Count; i += 2) {
+			memory.write(addresses[i], values[i]);
+		}
+
+		uint64_t operations = options.instructions;
+		printHeader(out, "memory");
+		printRow(out, "read", measure(options.repeat, [&] {
+			uint32_t sum = 0;
+			for (uint64_t i = 0; i < operations; i++) {
+				sum += memory.read(addresses[i & (Count - 1)]);
+			}
+			sink = sum;
+			return operations;
+		}));
+		printRow(out, "write", measure(options.repeat, [&] {
+			for (uint64_t i = 0; i < operations; i++) {
+				memory.write(addresses[i & (Count - 1)], values[i & (Count - 1)]);
+			}
+			return operations;
+		}));
+		printRow(out, "readW", measure(options.repeat, [&] {
+			uint32_t sum = 0;
+			for (uint64_t i = 0; i < operations; i++) {
+				sum += memory.readW(addresses[i & (Count - 1)]);
+			}
+			sink = sum;
+			return operations;
+		}));
+		printRow(out, "mixed 7:2:1", measure(options.repeat, [&] {
+			uint32_t sum = 0;
+			for (uint64_t i = 0; i < operations; i++) {
+				unsigned int index = i & (Count - 1);
+				switch (i % 10) {
+				case 0: case 1:
+					memory.write(addresses[index], values[index]);
+					break;
+				case 2:
+					sum += memory.readW(addresses[index]);
+					break;
+				default:
+					sum += memory.read(addresses[index]);
+					break;
+				}
+			}
+			sink = sum;
+			return operations;
+		}));
+	}
+
+	// Run with 1024 memory records, the size the oracle tests use
+	void benchRun(std::ostream &out, const BenchOptions &options) {
+		std::mt19937 random(0x5EED);
+		std::string input;
+		for (unsigned int i = 0; i < 14; i++) {
+			input += std::to_string(i == 7 || i == 8 ? random() & 0xFFFF : i >= 9 ? random() & 1 : random() & 0xFF);
+			input += i < 13 ? "|" : ",";
+		}
+		for (unsigned int i = 0; i < 1024; i++) {
+			input += std::to_string(i) + ":" + std::to_string(random() & 0xFF) + (i < 1023 ? "|" : "");
+		}
+
+		std::vector<char> in(input.begin(), input.end());
+		in.push_back('\0');
+		std::vector<char> output(16384);
+		uint64_t calls = options.passes * 10;
+
+		printHeader(out, "oracle");
+		Stats stats = measure(options.repeat, [&] {
+			for (uint64_t i = 0; i < calls; i++) {
+				Run(in.data(), output.data());
+			}
+			return calls;
+		});
+		printRow(out, "Run", stats);
+
+		// Same input every call, so everything after the first is a hit
+		SetResultCache(1 << 16);
+		stats = measure(options.repeat, [&] {
+			for (uint64_t i = 0; i < calls; i++) {
+				Run(in.data(), output.data());
+			}
+			return calls;
+		});
+		SetResultCache(0);
+		printRow(out, "Run cached", stats);
+
+		OracleState state, result;
+		Oracle::parse(in.data(), state);
+		OracleCache cache(1 << 16);
+		stats = measure(options.repeat, [&] {
+			for (uint64_t i = 0; i < calls; i++) {
+				cache.execute(state, result);
+			}
+			return calls;
+		});
+		printRow(out, "OracleCache hit", stats);
+
+		// One opcode over many states, the shape of an opcode sweep
+		std::vector<OracleState> states(Lockstep::Lanes * 8, state), results(states.size());
+		std::vector<uint8_t> cycles(states.size());
+		for (auto it = states.begin(); it != states.end(); ++it) {
+			it->a = random();
+			it->b = random();
+			it->carry = random() & 1;
+			it->pc = 0;
+			it->memory[0].value = 0x88; // ADC A,B
+		}
+		stats = measure(options.repeat, [&] {
+			for (size_t i = 0; i < states.size(); i++) {
+				Oracle::execute(states[i], results[i]);
+			}
+			return states.size();
+		});
+		printRow(out, "execute sweep", stats);
+
+		Lockstep lockstep;
+		stats = measure(options.repeat, [&] {
+			for (uint64_t i = 0; i < options.passes; i++) {
+				lockstep.execute(states.data(), results.data(), cycles.data(), states.size());
+			}
+			return options.passes * states.size();
+		});
+		printRow(out, "lockstep sweep", stats);
+	}
+}
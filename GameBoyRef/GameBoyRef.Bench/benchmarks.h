@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cinttypes>
+#include <ostream>
+
+namespace gameboy {
+	// Throughput suites for the reference core. Each measurement is repeated
+	// and reported as the median with min, mean and standard deviation, in
+	// ns per operation and millions of operations per second.
+	struct BenchOptions {
+		unsigned int repeat;
+		unsigned int passes;
+		uint64_t instructions;
+	};
+
+	void benchOpcodes(std::ostream &out, const BenchOptions &options);
+	void benchRandomStream(std::ostream &out, const BenchOptions &options);
+	void benchMemory(std::ostream &out, const BenchOptions &options);
+	void benchRun(std::ostream &out, const BenchOptions &options);
+}
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "hostcounters.h"
+
+#include <chrono>
+#include <cinttypes>
+#include <iomanip>
+#include <vector>
+#include "perfcounters.h"
+#include "workload.h"
+
+namespace gameboy {
+	struct OpcodeClass {
+		const char *name;
+		std::vector<uint16_t> opCodes;
+	};
+
+	static const char *classify(uint16_t opCode) {
+		if (opCode >= 0x100) {
+			uint8_t cb = opCode & 0xFF;
+			return cb < 0x40 ? "cb shift/rotate" : cb < 0x80 ? "cb bit" : "cb res/set";
+		}
+
+		uint8_t low = opCode & 0x07;
+		if (opCode >= 0x40 && opCode < 0x80) {
+			return opCode == 0x76 ? "misc" : (low == 6 || (opCode >= 0x70 && opCode < 0x78)) ? "ld (hl)" : "ld r,r";
+		}
+		if (opCode >= 0x80 && opCode < 0xC0) {
+			return "alu";
+		}
+
+		switch (opCode) {
+		case 0x06: case 0x0E: case 0x16: case 0x1E: case 0x26: case 0x2E: case 0x3E:
+			return "ld r,n";
+		case 0x02: case 0x0A: case 0x12: case 0x1A: case 0x22: case 0x2A: case 0x32: case 0x3A: case 0x36:
+		case 0x08: case 0xE0: case 0xE2: case 0xEA: case 0xF0: case 0xF2: case 0xFA:
+			return "ld mem";
+		case 0x01: case 0x11: case 0x21: case 0x31: case 0xF8: case 0xF9:
+			return "ld 16";
+		case 0xC6: case 0xCE: case 0xD6: case 0xDE: case 0xE6: case 0xEE: case 0xF6: case 0xFE:
+			return "alu";
+		case 0x07: case 0x0F: case 0x17: case 0x1F:
+			return "rotate a";
+		case 0xC3: case 0xC2: case 0xCA: case 0xD2: case 0xDA: case 0xE9:
+		case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:
+			return "jump";
+		case 0xCD: case 0xC4: case 0xCC: case 0xD4: case 0xDC:
+		case 0xC9: case 0xD9: case 0xC0: case 0xC8: case 0xD0: case 0xD8:
+		case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+			return "call/ret";
+		case 0xC1: case 0xD1: case 0xE1: case 0xF1: case 0xC5: case 0xD5: case 0xE5: case 0xF5:
+			return "stack";
+		case 0x00: case 0x10: case 0x27: case 0x2F: case 0x37: case 0x3F: case 0xF3: case 0xFB:
+			return "misc";
+		default:
+			return "inc/dec/add16";
+		}
+	}
+
+	static std::vector<OpcodeClass> getClasses() {
+		std::vector<OpcodeClass> classes;
+		std::vector<uint16_t> defined = Workload::getDefined();
+		for (auto it = defined.begin(); it != defined.end(); ++it) {
+			const char *name = classify(*it);
+			auto found = classes.begin();
+			while (found != classes.end() && found->name != name) {
+				++found;
+			}
+			if (found == classes.end()) {
+				classes.push_back(OpcodeClass{ name, std::vector<uint16_t>() });
+				found = classes.end() - 1;
+			}
+			found->opCodes.push_back(*it);
+		}
+		return classes;
+	}
+
+	// Counters wrap the whole batch, so per instruction figures include the
+	// harness's register reset; the NOP-heavy "misc" row is the floor.
+	bool runHostCounters(std::ostream &out, unsigned int passes) {
+		PerfCounters counters;
+		if (!counters.open()) {
+			return false;
+		}
+
+		out << std::left << std::setw(18) << "class" << std::right
+			<< std::setw(8) << "opcodes"
+			<< std::setw(12) << "ns/op";
+		for (unsigned int i = 0; i < PerfCounters::CounterCount; i++) {
+			PerfCounters::Counter counter = (PerfCounters::Counter)i;
+			out << std::setw(16) << (counters.isAvailable(counter) ? PerfCounters::getName(counter) : "n/a");
+		}
+		out << "\n";
+
+		std::vector<OpcodeClass> classes = getClasses();
+		for (auto it = classes.begin(); it != classes.end(); ++it) {
+			Workload workload(it->opCodes, 0x5EED);
+			workload.run(1); // Warm up caches and predictors
+
+			counters.start();
+			auto start = std::chrono::steady_clock::now();
+			uint64_t executed = workload.run(passes);
+			auto elapsed = std::chrono::steady_clock::now() - start;
+			counters.stop();
+
+			double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+			out << std::left << std::setw(18) << it->name << std::right
+				<< std::setw(8) << it->opCodes.size()
+				<< std::setw(12) << std::fixed << std::setprecision(2) << ns / executed;
+			for (unsigned int i = 0; i < PerfCounters::CounterCount; i++) {
+				out << std::setw(16) << std::setprecision(3) << (double)counters.read((PerfCounters::Counter)i) / executed;
+			}
+			out << "\n";
+		}
+		return true;
+	}
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <ostream>
+
+namespace gameboy {
+	// Runs a batch of each guest opcode class with host hardware counters
+	// around it and reports host instructions, branch misses and L1 data
+	// misses per guest instruction. Returns false if counters can't be opened.
+	bool runHostCounters(std::ostream &out, unsigned int passes);
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "perfcounters.h"
+
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace gameboy {
+	PerfCounters::PerfCounters() {
+		for (unsigned int i = 0; i < CounterCount; i++) {
+			fds[i] = -1;
+		}
+	}
+
+	PerfCounters::~PerfCounters() {
+#ifdef __linux__
+		for (unsigned int i = 0; i < CounterCount; i++) {
+			if (fds[i] >= 0) {
+				close(fds[i]);
+			}
+		}
+#endif
+	}
+
+	// True if at least the instruction counter opened
+	bool PerfCounters::open() {
+#ifdef __linux__
+		static const struct {
+			uint32_t type;
+			uint64_t config;
+		} events[CounterCount] = {
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+			{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) }
+		};
+
+		for (unsigned int i = 0; i < CounterCount; i++) {
+			perf_event_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = events[i].type;
+			attr.config = events[i].config;
+			attr.disabled = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			fds[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+		}
+		return fds[Instructions] >= 0;
+#else
+		return false;
+#endif
+	}
+
+	void PerfCounters::start() {
+#ifdef __linux__
+		for (unsigned int i = 0; i < CounterCount; i++) {
+			if (fds[i] >= 0) {
+				ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+				ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+			}
+		}
+#endif
+	}
+
+	void PerfCounters::stop() {
+#ifdef __linux__
+		for (unsigned int i = 0; i < CounterCount; i++) {
+			if (fds[i] >= 0) {
+				ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+			}
+		}
+#endif
+	}
+
+	bool PerfCounters::isAvailable(Counter counter) const {
+		return fds[counter] >= 0;
+	}
+
+	// Count since the last start, 0 if the counter isn't available
+	uint64_t PerfCounters::read(Counter counter) const {
+		uint64_t value = 0;
+#ifdef __linux__
+		if (fds[counter] >= 0 && ::read(fds[counter], &value, sizeof(value)) != sizeof(value)) {
+			value = 0;
+		}
+#endif
+		return value;
+	}
+
+	const char *PerfCounters::getName(Counter counter) {
+		switch (counter) {
+		case Instructions: return "instructions";
+		case BranchMisses: return "branch-misses";
+		case L1DataMisses: return "l1d-misses";
+		default: return "";
+		}
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cinttypes>
+
+namespace gameboy {
+	// Host hardware counters for the calling thread through perf_event_open.
+	// Linux only, open() fails everywhere else or when the kernel refuses
+	// (perf_event_paranoid, containers). Counters that can't be opened on
+	// their own, usually the cache one in VMs, read as unavailable.
+	class PerfCounters {
+	public:
+		enum Counter {
+			Instructions,
+			BranchMisses,
+			L1DataMisses,
+			CounterCount
+		};
+
+		explicit PerfCounters();
+		virtual ~PerfCounters();
+
+		bool open();
+		void start();
+		void stop();
+		bool isAvailable(Counter counter) const;
+		uint64_t read(Counter counter) const;
+
+		static const char *getName(Counter counter);
+
+	private:
+		PerfCounters(const PerfCounters &other);
+		PerfCounters &operator=(const PerfCounters &other);
+
+		int fds[CounterCount];
+	};
+}
\ No newline at end of file
@@ -0,0 +1,88 @@
+#include "workload.h"
+
+#include <random>
+#include "core.h"
+#include "memory.h"
+
+namespace gameboy {
+	Workload::Workload(const std::vector<uint16_t> &opCodes, uint32_t seed) :
+		core(new Core()) {
+		std::mt19937 random(seed);
+
+		// Code lives in 0x0000-0x3FFF, everything registers can point at is above it
+		for (unsigned int i = 0; i < SlotCount && !opCodes.empty(); i++) {
+			uint16_t opCode = opCodes[random() % opCodes.size()];
+			uint16_t pc = i * 4;
+			uint8_t bytes[4] = { (uint8_t)opCode, (uint8_t)random(), (uint8_t)random(), (uint8_t)random() };
+			if (opCode >= 0x100) {
+				bytes[0] = 0xCB;
+				bytes[1] = (uint8_t)opCode;
+			}
+			else if (opCode == 0x08 || opCode == 0xEA || opCode == 0xFA) {
+				bytes[1] = 0xC0 | (bytes[1] & 0x1F); // LD (nn) stays in RAM, oracle word order puts the high byte first
+			}
+
+			for (unsigned int j = 0; j < 4; j++) {
+				core->memory->write(pc + j, bytes[j]);
+			}
+			slots.push_back(pc);
+		}
+
+		for (unsigned int i = 0; i < PresetCount; i++) {
+			CPURegisters registers;
+			registers.setA(random());
+			registers.setBC(0xC000 | (random() & 0x1FFF));
+			registers.setDE(0xC000 | (random() & 0x1FFF));
+			registers.setHL(0xC000 | (random() & 0x1FFF));
+			registers.setSP(0xD000 | (random() & 0x0FFE));
+			registers.setZeroFlag(random() & 1);
+			registers.setSubFlag(random() & 1);
+			registers.setHalfCarryFlag(random() & 1);
+			registers.setCarryFlag(random() & 1);
+			presets.push_back(registers);
+		}
+	}
+
+	Workload::~Workload() {
+		delete core;
+	}
+
+	// Runs every slot passes times, returns the instructions executed
+	uint64_t Workload::run(unsigned int passes) {
+		for (unsigned int pass = 0; pass < passes; pass++) {
+			for (unsigned int i = 0; i < slots.size(); i++) {
+				*core->registers = presets[i & (PresetCount - 1)];
+				core->registers->pc = slots[i];
+				core->emulateCycle();
+			}
+		}
+		return (uint64_t)passes * slots.size();
+	}
+
+	Core &Workload::getCore() {
+		return *core;
+	}
+
+	// Everything but the CB prefix itself and the 11 opcodes the CPU lacks
+	bool Workload::isDefined(uint16_t opCode) {
+		switch (opCode) {
+		case 0xCB:
+		case 0xD3: case 0xDB: case 0xDD:
+		case 0xE3: case 0xE4: case 0xEB: case 0xEC: case 0xED:
+		case 0xF4: case 0xFC: case 0xFD:
+			return false;
+		default:
+			return opCode < 0x200;
+		}
+	}
+
+	std::vector<uint16_t> Workload::getDefined() {
+		std::vector<uint16_t> opCodes;
+		for (uint16_t i = 0; i < 0x200; i++) {
+			if (isDefined(i)) {
+				opCodes.push_back(i);
+			}
+		}
+		return opCodes;
+	}
+}
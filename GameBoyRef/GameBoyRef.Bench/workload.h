@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cinttypes>
+#include <vector>
+#include "cpuregisters.h"
+
+namespace gameboy {
+	class Core;
+
+	// A Core loaded with SlotCount instructions picked at random from a set
+	// of opcodes (0x100-0x1FF for CB opcodes), each in its own 4 byte slot
+	// with random operands. Every step resets the registers from a random
+	// preset and jumps to the next slot, so jumps, calls and writes can't
+	// derail the run and branches go both ways.
+	class Workload {
+	public:
+		static const unsigned int SlotCount = 0x1000;
+		static const unsigned int PresetCount = 0x100;
+
+		explicit Workload(const std::vector<uint16_t> &opCodes, uint32_t seed);
+		virtual ~Workload();
+
+		uint64_t run(unsigned int passes);
+		Core &getCore();
+
+		static bool isDefined(uint16_t opCode);
+		static std::vector<uint16_t> getDefined();
+
+	private:
+		Workload(const Workload &other);
+		Workload &operator=(const Workload &other);
+
+		Core *core;
+		std::vector<uint16_t> slots;
+		std::vector<CPURegisters> presets;
+	};
+}
\ No newline at end of file
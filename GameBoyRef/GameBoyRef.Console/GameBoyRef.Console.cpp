@@ -1,12 +1,254 @@
 #include "stdafx.h"
-#include "functions.h"
 
-int main()
-{
-	char *input = "0|145|162|115|86|38|15|16760|0|1|1|0|0|1,0:7|1:42|2:37|3:92|4:25|5:0|6:127|7:185|8:48|9:110|10:56|11:135|12:9|13:2|14:222|15:22|16:11|17:140|18:86|19:1|20:66|21:202|22:218|23:19|24:207|25:52|26:2|27:208|28:10|29:4|30:252|31:115|32:171|33:17|34:14|35:25|36:113|37:144|38:229|39:145|40:51|41:150|42:140|43:145|44:89|45:26|46:105|47:83|48:72|49:249|50:53|51:253|52:239|53:106|54:85|55:132|56:79|57:17|58:141|59:229|60:253|61:174|62:174|63:43|64:114|65:196|66:220|67:247|68:244|69:196|70:165|71:123|72:166|73:197|74:205|75:172|76:61|77:72|78:186|79:180|80:202|81:174|82:136|83:17|84:206|85:255|86:132|87:65|88:187|89:137|90:201|91:95|92:2|93:255|94:147|95:133|96:232|97:97|98:31|99:149|100:62|101:113|102:95|103:131|104:83|105:186|106:86|107:41|108:156|109:169|110:71|111:7|112:87|113:216|114:26|115:78|116:38|117:156|118:92|119:115|120:63|121:154|122:60|123:106|124:251|125:69|126:120|127:167|128:49|129:72|130:196|131:220|132:41|133:36|134:117|135:89|136:79|137:4|138:190|139:20|140:168|141:90|142:164|143:18|144:66|145:194|146:7|147:41|148:228|149:69|150:94|151:75|152:4|153:171|154:85|155:163|156:53|157:245|158:136|159:13|160:65|161:175|162:248|163:84|164:229|165:107|166:221|167:50|168:99|169:193|170:255|171:34|172:222|173:72|174:202|175:229|176:246|177:41|178:40|179:57|180:62|181:78|182:194|183:236|184:233|185:120|186:216|187:126|188:207|189:210|190:35|191:90|192:124|193:176|194:211|195:249|196:98|197:79|198:45|199:214|200:228|201:212|202:198|203:35|204:70|205:60|206:109|207:187|208:225|209:111|210:173|211:11|212:204|213:78|214:207|215:242|216:236|217:11|218:106|219:108|220:147|221:95|222:99|223:145|224:157|225:164|226:165|227:45|228:116|229:208|230:131|231:166|232:252|233:81|234:84|235:105|236:136|237:158|238:166|239:173|240:10|241:28|242:156|243:95|244:36|245:24|246:141|247:45|248:224|249:225|250:12|251:86|252:229|253:192|254:66|255:133|256:113|257:53|258:133|259:161|260:150|261:64|262:71|263:16|264:236|265:6|266:14|267:123|268:250|269:102|270:106|271:77|272:101|273:189|274:97|275:119|276:194|277:3|278:108|279:133|280:23|281:120|282:77|283:147|284:195|285:44|286:193|287:60|288:14|289:206|290:247|291:82|292:25|293:4|294:22|295:202|296:212|297:139|298:114|299:30|300:9|301:18|302:51|303:121|304:118|305:191|306:240|307:39|308:94|309:203|310:195|311:109|312:201|313:255|314:138|315:30|316:242|317:180|318:77|319:191|320:69|321:210|322:108|323:43|324:111|325:23|326:52|327:96|328:167|329:151|330:162|331:54|332:145|333:78|334:124|335:4|336:69|337:211|338:28|339:4|340:60|341:153|342:221|343:67|344:11|345:138|346:137|347:25|348:122|349:247|350:215|351:32|352:62|353:178|354:217|355:54|356:166|357:7|358:10|359:94|360:138|361:144|362:128|363:199|364:40|365:140|366:220|367:123|368:131|369:133|370:217|371:31|372:151|373:72|374:131|375:171|376:245|377:41|378:32|379:229|380:142|381:26|382:230|383:175|384:192|385:130|386:247|387:222|388:117|389:69|390:94|391:61|392:201|393:189|394:121|395:172|396:24|397:22|398:26|399:126|400:173|401:13|402:150|403:245|404:30|405:184|406:136|407:246|408:47|409:45|410:65|411:125|412:231|413:37|414:208|415:112|416:169|417:208|418:7|419:166|420:148|421:254|422:6|423:61|424:38|425:155|426:85|427:218|428:206|429:215|430:146|431:223|432:14|433:161|434:55|435:129|436:132|437:241|438:145|439:7|440:250|441:1|442:174|443:71|444:4|445:225|446:86|447:164|448:237|449:9|450:2|451:71|452:15|453:116|454:234|455:175|456:7|457:88|458:206|459:130|460:98|461:173|462:39|463:87|464:154|465:98|466:110|467:69|468:237|469:78|470:235|471:184|472:63|473:255|474:172|475:146|476:79|477:190|478:56|479:69|480:69|481:177|482:237|483:196|484:213|485:75|486:207|487:154|488:183|489:135|490:121|491:43|492:34|493:15|494:164|495:76|496:218|497:87|498:173|499:162|500:115|501:16|502:182|503:158|504:30|505:73|506:8|507:15|508:200|509:87|510:96|511:72|512:31|513:137|514:61|515:177|516:192|517:98|518:130|519:79|520:146|521:212|522:142|523:101|524:213|525:192|526:149|527:48|528:90|529:95|530:184|531:247|532:16|533:150|534:210|535:52|536:250|537:78|538:166|539:139|540:66|541:192|542:209|543:95|544:39|545:48|546:11|547:153|548:209|549:243|550:139|551:119|552:212|553:94|554:16|555:158|556:130|557:80|558:201|559:93|560:180|561:216|562:180|563:104|564:159|565:104|566:55|567:137|568:183|569:9|570:183|571:113|572:187|573:246|574:12|575:209|576:2|577:46|578:62|579:164|580:180|581:251|582:94|583:103|584:212|585:64|586:34|587:178|588:134|589:51|590:177|591:169|592:133|593:73|594:215|595:106|596:11|597:105|598:192|599:190|600:249|601:130|602:226|603:200|604:59|605:25|606:188|607:222|608:81|609:62|610:155|611:83|612:18|613:37|614:168|615:184|616:121|617:76|618:148|619:94|620:70|621:133|622:3|623:131|624:87|625:13|626:236|627:114|628:31|629:162|630:198|631:153|632:110|633:128|634:171|635:50|636:25|637:149|638:43|639:186|640:132|641:68|642:96|643:71|644:152|645:94|646:151|647:96|648:160|649:31|650:240|651:190|652:212|653:98|654:120|655:115|656:127|657:95|658:113|659:46|660:45|661:73|662:190|663:175|664:120|665:1|666:229|667:145|668:122|669:117|670:158|671:227|672:32|673:218|674:217|675:1|676:37|677:187|678:235|679:249|680:118|681:139|682:210|683:255|684:177|685:7|686:197|687:12|688:8|689:55|690:179|691:185|692:36|693:253|694:140|695:59|696:133|697:176|698:207|699:150|700:120|701:5|702:230|703:42|704:128|705:12|706:158|707:250|708:136|709:118|710:78|711:195|712:116|713:119|714:184|715:161|716:119|717:191|718:254|719:112|720:60|721:217|722:137|723:66|724:194|725:229|726:191|727:35|728:77|729:158|730:123|731:116|732:235|733:84|734:128|735:112|736:165|737:167|738:127|739:164|740:105|741:202|742:131|743:146|744:233|745:239|746:69|747:173|748:69|749:234|750:195|751:198|752:178|753:95|754:89|755:159|756:124|757:163|758:104|759:155|760:77|761:122|762:172|763:233|764:250|765:218|766:216|767:31|768:247|769:71|770:252|771:207|772:64|773:89|774:7|775:114|776:85|777:247|778:89|779:210|780:159|781:18|782:222|783:99|784:219|785:181|786:194|787:140|788:250|789:224|790:244|791:2|792:63|793:227|794:87|795:238|796:29|797:154|798:151|799:15|800:23|801:37|802:181|803:253|804:238|805:243|806:134|807:88|808:87|809:231|810:74|811:132|812:74|813:149|814:252|815:59|816:156|817:73|818:14|819:68|820:23|821:76|822:36|823:22|824:82|825:250|826:144|827:92|828:2|829:25|830:84|831:186|832:95|833:74|834:187|835:121|836:92|837:224|838:116|839:231|840:47|841:105|842:52|843:19|844:150|845:112|846:183|847:169|848:231|849:27|850:81|851:212|852:140|853:82|854:247|855:202|856:1|857:159|858:170|859:244|860:99|861:41|862:86|863:62|864:147|865:143|866:36|867:255|868:218|869:130|870:223|871:188|872:212|873:38|874:21|875:173|876:24|877:17|878:128|879:226|880:66|881:230|882:117|883:230|884:199|885:127|886:46|887:13|888:83|889:240|890:120|891:189|892:53|893:128|894:131|895:6|896:19|897:246|898:127|899:6|900:75|901:184|902:206|903:100|904:60|905:149|906:255|907:101|908:61|909:73|910:178|911:239|912:30|913:200|914:177|915:124|916:179|917:111|918:118|919:19|920:96|921:23|922:172|923:233|924:10|925:34|926:134|927:84|928:162|929:14|930:153|931:33|932:146|933:121|934:151|935:138|936:23|937:17|938:169|939:50|940:128|941:201|942:207|943:9|944:62|945:137|946:158|947:109|948:206|949:7|950:82|951:164|952:127|953:108|954:165|955:51|956:11|957:229|958:90|959:26|960:14|961:171|962:194|963:46|964:175|965:144|966:93|967:164|968:48|969:39|970:100|971:162|972:197|973:68|974:147|975:151|976:72|977:163|978:171|979:129|980:131|981:25|982:133|983:155|984:187|985:245|986:162|987:37|988:211|989:100|990:126|991:50|992:183|993:143|994:36|995:213|996:6|997:160|998:89|999:173|1000:44|1001:249|1002:60|1003:166|1004:162|1005:176|1006:222|1007:59|1008:217|1009:14|1010:234|1011:104|1012:57|1013:216|1014:150|1015:244|1016:37|1017:39|1018:114|1019:186|1020:238|1021:55|1022:209|1023:204";
-	char *output = new char[16384];
-	auto result = Run(input, output);
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include "blargg.h"
+#include "callstack.h"
+#include "gpu.h"
+#include "oraclecache.h"
+#include "rewind.h"
+#include "runner.h"
+#include "sampler.h"
+#include "server.h"
+#include "symbols.h"
+#include "verifier.h"
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <csignal>
+#endif
 
-	return 0;
+static void usage() {
+	std::cerr
+		<< "usage: GameBoyRef.Console [options] CORPUS\n"
+		<< "       GameBoyRef.Console [options] --serve | --socket PATH\n"
+		<< "       GameBoyRef.Console [options] --rom PATH\n"
+		<< "       GameBoyRef.Console [options] --blargg DIR\n"
+		<< "  CORPUS              binary corpus, or text with \"input expected [cycles]\" per line\n"
+		<< "  --serve             answer binary oracle requests on stdin/stdout\n"
+		<< "  --socket PATH       answer binary oracle requests on a Unix domain socket\n"
+		<< "  --cache N           keep up to N results for repeated states when serving\n"
+		<< "  --rom PATH          run a ROM headless and print a hash of the last frame\n"
+		<< "  --frames N          frames to run the ROM for, default 60\n"
+		<< "  --sav PATH          keep battery backed cartridge RAM in PATH, e.g. the ROM's .sav file\n"
+		<< "  --until-pc ADDR     stop the ROM once PC reaches ADDR (hex)\n"
+		<< "  --until-serial TEXT stop the ROM once it has sent TEXT over serial\n"
+		<< "  --rewind N          snapshot each of the ROM's frames, keeping up to N, and step back through them at the end\n"
+		<< "  --sample N          sample the ROM's PC every N M-cycles and print self and inclusive cycles per function\n"
+		<< "  --folded PATH       track the ROM's call stack and write cycles per call path as folded stacks\n"
+		<< "  --sym PATH          .sym file naming the ROM's functions in profiles\n"
+		<< "  --blargg DIR        run every ROM in DIR and below it until it reports Passed or Failed\n"
+		<< "  --cycles N          M-cycles each Blargg ROM gets, default 120 s worth\n"
+		<< "  --threads N         worker threads, default one per core\n"
+		<< "  --max-failures N    failures to print, default 20\n";
 }
 
+int main(int argc, char *argv[])
+{
+	unsigned int threads = std::thread::hardware_concurrency();
+	unsigned int maxFailures = 20;
+	std::string path;
+	bool serve = false;
+	std::string socketPath;
+	size_t cacheSize = 0;
+	std::string romPath;
+	uint64_t frames = 60;
+	std::string savPath;
+	long untilPc = -1;
+	std::string untilSerial;
+	unsigned int rewindFrames = 0;
+	unsigned int sampleInterval = 0;
+	std::string foldedPath;
+	std::string symPath;
+	std::string blarggPath;
+	uint64_t cycleLimit = 120 * gameboy::Runner::CyclesPerSecond;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			threads = (unsigned int)strtoul(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--max-failures") == 0 && i + 1 < argc) {
+			maxFailures = (unsigned int)strtoul(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--serve") == 0) {
+			serve = true;
+		}
+		else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+			socketPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+			cacheSize = (size_t)strtoull(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--rom") == 0 && i + 1 < argc) {
+			romPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+			frames = strtoull(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--sav") == 0 && i + 1 < argc) {
+			savPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--until-pc") == 0 && i + 1 < argc) {
+			untilPc = strtol(argv[++i], nullptr, 16) & 0xFFFF;
+		}
+		else if (strcmp(argv[i], "--until-serial") == 0 && i + 1 < argc) {
+			untilSerial = argv[++i];
+		}
+		else if (strcmp(argv[i], "--rewind") == 0 && i + 1 < argc) {
+			rewindFrames = (unsigned int)strtoul(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--sample") == 0 && i + 1 < argc) {
+			sampleInterval = (unsigned int)strtoul(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--folded") == 0 && i + 1 < argc) {
+			foldedPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--sym") == 0 && i + 1 < argc) {
+			symPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--blargg") == 0 && i + 1 < argc) {
+			blarggPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+			cycleLimit = strtoull(argv[++i], nullptr, 10);
+		}
+		else if (argv[i][0] != '-' && path.empty()) {
+			path = argv[i];
+		}
+		else {
+			usage();
+			return 2;
+		}
+	}
+
+	if (!blarggPath.empty()) {
+		std::vector<std::string> roms;
+		if (!gameboy::BlarggSuite::list(blarggPath, roms)) {
+			std::cerr << "can't read " << blarggPath << "\n";
+			return 2;
+		}
+		if (roms.empty()) {
+			std::cerr << "no .gb or .gbc files in " << blarggPath << "\n";
+			return 2;
+		}
+
+		gameboy::BlarggSuite suite(roms, cycleLimit);
+		auto start = std::chrono::steady_clock::now();
+		suite.run(threads);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		suite.report(std::cout);
+		std::cout << "\n" << roms.size() << " ROMs, " << suite.count(gameboy::BlarggSuite::Passed) << " passed, "
+			<< suite.count(gameboy::BlarggSuite::Failed) << " failed, " << suite.count(gameboy::BlarggSuite::TimedOut) << " timed out, "
+			<< suite.count(gameboy::BlarggSuite::NotLoaded) << " not loaded in " << seconds << " s\n";
+		return suite.count(gameboy::BlarggSuite::Passed) == roms.size() ? 0 : 1;
+	}
+
+	if (!romPath.empty()) {
+		std::unique_ptr<gameboy::Runner> runner(gameboy::Runner::open(romPath, savPath));
+		if (!runner) {
+			std::cerr << "can't load " << romPath << (savPath.empty() ? "" : " or open " + savPath) << "\n";
+			return 2;
+		}
+
+		gameboy::SymbolTable symbols;
+		if (!symPath.empty() && !symbols.load(symPath)) {
+			std::cerr << "can't read " << symPath << "\n";
+			return 2;
+		}
+		std::unique_ptr<gameboy::Sampler> sampler(sampleInterval != 0 ? new gameboy::Sampler(sampleInterval) : nullptr);
+		runner->setSampler(sampler.get());
+		std::ofstream folded;
+		std::unique_ptr<gameboy::CallStack> callStack;
+		if (!foldedPath.empty()) {
+			folded.open(foldedPath);
+			if (!folded) {
+				std::cerr << "can't write " << foldedPath << "\n";
+				return 2;
+			}
+			callStack.reset(new gameboy::CallStack());
+			runner->setCallStack(callStack.get());
+		}
+
+		if (untilPc >= 0) {
+			runner->setUntilPc((uint16_t)untilPc);
+		}
+		runner->addUntilSerial(untilSerial);
+		std::unique_ptr<gameboy::Rewind> rewind(rewindFrames != 0 ? new gameboy::Rewind(1, rewindFrames, 0) : nullptr);
+		runner->setRewind(rewind.get());
+		bool stopped = runner->run(frames * gameboy::Gpu::FrameCycles);
+		runner->setSampler(nullptr);
+		runner->setCallStack(nullptr);
+
+		std::cout << romPath << ": " << (stopped ? "stopped" : "ran") << " after " << runner->getFrames() << " frames, "
+			<< runner->getCycles() << " cycles, PC " << std::hex << std::setfill('0') << std::setw(4) << runner->getPc() << "\n"
+			<< "frame hash " << std::setw(16) << runner->getFrameHash() << std::dec << "\n"
+			<< runner->getSeconds() << " s, " << runner->getSpeed() << "x real time\n";
+		if (!runner->getSerialOutput().empty()) {
+			std::cout << "serial output:\n" << runner->getSerialOutput() << "\n";
+		}
+		if (rewind) {
+			size_t bytes = rewind->memoryUsage();
+			unsigned int rewound = 0;
+			while (runner->stepBack()) {
+				++rewound;
+			}
+			std::cout << "rewound " << rewound << " snapshots (" << bytes / 1024 << " KiB, " << rewind->dropped() << " dropped) to frame "
+				<< runner->getFrames() << ", PC " << std::hex << std::setw(4) << runner->getPc() << std::dec << "\n";
+		}
+		if (sampler) {
+			std::cout << "profile, " << sampler->getSampleCount() << " samples every " << sampler->getInterval() << " cycles:\n";
+			sampler->writeReport(std::cout, symbols);
+		}
+		if (callStack) {
+			callStack->writeFolded(folded, symbols);
+		}
+		return stopped || (untilPc < 0 && untilSerial.empty()) ? 0 : 1;
+	}
+
+	if (serve || !socketPath.empty()) {
+		std::unique_ptr<gameboy::OracleCache> cache(cacheSize != 0 ? new gameboy::OracleCache(cacheSize) : nullptr);
+		gameboy::Server server(threads, cache.get());
+#ifdef _WIN32
+		_setmode(_fileno(stdin), _O_BINARY);
+		_setmode(_fileno(stdout), _O_BINARY);
+#else
+		signal(SIGPIPE, SIG_IGN);
+#endif
+		if (!socketPath.empty()) {
+			server.listen(socketPath);
+			std::cerr << "can't listen on " << socketPath << "\n";
+			return 2;
+		}
+		return server.serve(0, 1) ? 0 : 1;
+	}
+
+	if (path.empty()) {
+		usage();
+		return 2;
+	}
+
+	std::unique_ptr<gameboy::Verifier> verifier(gameboy::Verifier::open(path));
+	if (!verifier) {
+		std::cerr << "can't read " << path << "\n";
+		return 2;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	verifier->run(threads, std::cout, maxFailures);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << verifier->size() << (verifier->isBinary() ? " binary" : " text") << " vectors, "
+		<< verifier->getPassCount() << " passed, " << verifier->getFailCount() << " failed in "
+		<< seconds << " s (" << (uint64_t)(verifier->size() / (seconds > 0 ? seconds : 1)) << " vectors/s)\n";
+	return verifier->getFailCount() == 0 ? 0 : 1;
+}
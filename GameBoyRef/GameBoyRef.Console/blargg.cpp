@@ -0,0 +1,210 @@
+#include "stdafx.h"
+#include "blargg.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <thread>
+#include "runner.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+namespace gameboy {
+	static const char *const statusNames[] = { "passed", "FAILED", "timed out", "not loaded" };
+
+	static bool isRom(const std::string &name) {
+		size_t dot = name.rfind('.');
+		if (dot == std::string::npos) {
+			return false;
+		}
+
+		std::string extension = name.substr(dot);
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		return extension == ".gb" || extension == ".gbc";
+	}
+
+	static std::string baseName(const std::string &path) {
+		size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? path : path.substr(slash + 1);
+	}
+
+	// Appends the .gb and .gbc files in directory and its subdirectories, such
+	// as a suite's individual/, sorted by name with each directory's own ROMs
+	// first. Returns false if directory can't be read.
+	bool BlarggSuite::list(const std::string &directory, std::vector<std::string> &paths) {
+		std::vector<std::string> names, subdirectories;
+#ifdef _WIN32
+		WIN32_FIND_DATAA data;
+		HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &data);
+		if (find == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		do {
+			if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+				if (strcmp(data.cFileName, ".") != 0 && strcmp(data.cFileName, "..") != 0) {
+					subdirectories.push_back(data.cFileName);
+				}
+			}
+			else if (isRom(data.cFileName)) {
+				names.push_back(data.cFileName);
+			}
+		} while (FindNextFileA(find, &data));
+		FindClose(find);
+#else
+		DIR *dir = opendir(directory.c_str());
+		if (dir == nullptr) {
+			return false;
+		}
+		while (dirent *entry = readdir(dir)) {
+			bool isDirectory = entry->d_type == DT_DIR;
+			if (entry->d_type == DT_UNKNOWN) {
+				struct stat info;
+				isDirectory = stat((directory + "/" + entry->d_name).c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+			}
+
+			if (isDirectory) {
+				if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+					subdirectories.push_back(entry->d_name);
+				}
+			}
+			else if (isRom(entry->d_name)) {
+				names.push_back(entry->d_name);
+			}
+		}
+		closedir(dir);
+#endif
+
+		std::sort(names.begin(), names.end());
+		for (auto it = names.begin(); it != names.end(); ++it) {
+			paths.push_back(directory + "/" + *it);
+		}
+
+		std::sort(subdirectories.begin(), subdirectories.end());
+		for (auto it = subdirectories.begin(); it != subdirectories.end(); ++it) {
+			list(directory + "/" + *it, paths);
+		}
+		return true;
+	}
+
+	BlarggSuite::BlarggSuite(const std::vector<std::string> &paths, uint64_t cycleLimit) :
+		paths(paths),
+		cycleLimit(cycleLimit),
+		results(paths.size()),
+		next(0) {
+	}
+
+	BlarggSuite::~BlarggSuite() {
+	}
+
+	// ROMs are handed out one at a time, so a few slow ones don't leave the
+	// other threads idle behind a fixed split
+	void BlarggSuite::run(unsigned int threads) {
+		next = 0;
+		if (threads == 0) {
+			threads = 1;
+		}
+		if (threads > paths.size()) {
+			threads = (unsigned int)paths.size();
+		}
+
+		std::vector<std::thread> pool;
+		for (unsigned int i = 0; i < threads; i++) {
+			pool.push_back(std::thread(&BlarggSuite::worker, this));
+		}
+		for (auto it = pool.begin(); it != pool.end(); ++it) {
+			it->join();
+		}
+	}
+
+	// One line per ROM in directory order, then the serial output of every
+	// ROM that didn't pass
+	void BlarggSuite::report(std::ostream &out) const {
+		size_t width = 4;
+		for (auto it = results.begin(); it != results.end(); ++it) {
+			width = std::max(width, it->name.size());
+		}
+
+		out << std::left << std::setw(width) << "ROM" << "  " << std::setw(10) << "result"
+			<< std::right << std::setw(12) << "emulated s" << std::setw(10) << "wall s" << "\n";
+		out << std::fixed << std::setprecision(2);
+		for (auto it = results.begin(); it != results.end(); ++it) {
+			out << std::left << std::setw(width) << it->name << "  " << std::setw(10) << statusNames[it->status]
+				<< std::right << std::setw(12) << (double)it->cycles / Runner::CyclesPerSecond
+				<< std::setw(10) << it->seconds << "\n";
+		}
+		out << std::defaultfloat;
+
+		for (auto it = results.begin(); it != results.end(); ++it) {
+			if (it->status != Passed && !it->output.empty()) {
+				out << "\n" << it->name << ":\n" << it->output;
+				if (it->output.back() != '\n') {
+					out << "\n";
+				}
+			}
+		}
+	}
+
+	unsigned int BlarggSuite::count(Status status) const {
+		unsigned int total = 0;
+		for (auto it = results.begin(); it != results.end(); ++it) {
+			if (it->status == status) {
+				++total;
+			}
+		}
+
+		return total;
+	}
+
+	const std::vector<BlarggSuite::Result> &BlarggSuite::getResults() const {
+		return results;
+	}
+
+	void BlarggSuite::worker() {
+		for (;;) {
+			unsigned int index = next++;
+			if (index >= paths.size()) {
+				return;
+			}
+			runRom(index);
+		}
+	}
+
+	// Failing ROMs print "Failed" before the details of what failed, so the
+	// run goes on a little after it to catch the rest of the report
+	void BlarggSuite::runRom(unsigned int index) {
+		Result &result = results[index];
+		result.name = baseName(paths[index]);
+		result.cycles = 0;
+		result.seconds = 0;
+
+		std::unique_ptr<Runner> runner(Runner::open(paths[index]));
+		if (!runner) {
+			result.status = NotLoaded;
+			return;
+		}
+
+		runner->addUntilSerial("Passed");
+		runner->addUntilSerial("Failed");
+		if (!runner->run(cycleLimit)) {
+			result.status = TimedOut;
+		}
+		else if (runner->getMatch() == "Passed") {
+			result.status = Passed;
+		}
+		else {
+			result.status = Failed;
+			runner->clearUntil();
+			runner->run(Runner::CyclesPerSecond / 4);
+		}
+
+		result.cycles = runner->getCycles();
+		result.seconds = runner->getSeconds();
+		result.output = runner->getSerialOutput();
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <cinttypes>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace gameboy {
+	// Runs a directory of Blargg test ROMs on a pool of threads. Each ROM
+	// runs on its own Core until it reports "Passed" or "Failed" over
+	// serial or runs out of cycles.
+	class BlarggSuite {
+	public:
+		enum Status {
+			Passed,
+			Failed,
+			TimedOut,
+			NotLoaded
+		};
+
+		struct Result {
+			std::string name;
+			Status status;
+			uint64_t cycles;
+			double seconds;
+			std::string output; // Everything sent over serial
+		};
+
+		static bool list(const std::string &directory, std::vector<std::string> &paths);
+
+		explicit BlarggSuite(const std::vector<std::string> &paths, uint64_t cycleLimit);
+		virtual ~BlarggSuite();
+
+		void run(unsigned int threads);
+		void report(std::ostream &out) const;
+		unsigned int count(Status status) const;
+		const std::vector<Result> &getResults() const;
+
+	private:
+		BlarggSuite(const BlarggSuite &);
+		BlarggSuite &operator=(const BlarggSuite &);
+
+		void worker();
+		void runRom(unsigned int index);
+
+		std::vector<std::string> paths;
+		uint64_t cycleLimit;
+		std::vector<Result> results;
+		std::atomic<unsigned int> next;
+	};
+}
\ No newline at end of file
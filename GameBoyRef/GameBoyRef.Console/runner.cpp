@@ -0,0 +1,168 @@
+#include "stdafx.h"
+#include "runner.h"
+
+#include <chrono>
+#include "cartridge.h"
+#include "cpuregisters.h"
+#include "gpu.h"
+#include "rewind.h"
+#include "serial.h"
+
+namespace gameboy {
+	// Battery backed cartridge RAM is kept in savePath if one is given, other
+	// cartridges ignore it. Returns null if the ROM can't be read, its
+	// cartridge type isn't supported or the save file can't be opened.
+	Runner *Runner::open(const std::string &path, const std::string &savePath) {
+		Core *core = new Core();
+		if (!core->loadCartridge(path)) {
+			delete core;
+			return nullptr;
+		}
+		if (!savePath.empty() && core->cartridge->hasBattery() && core->cartridge->getRamSize() > 0 && !core->cartridge->openSave(savePath)) {
+			delete core;
+			return nullptr;
+		}
+
+		core->boot();
+		return new Runner(core);
+	}
+
+	Runner::Runner(Core *core) :
+		core(core),
+		rewind(nullptr),
+		stopAtPc(false),
+		untilPc(0),
+		cycles(0),
+		seconds(0) {
+	}
+
+	Runner::~Runner() {
+		delete core;
+	}
+
+	void Runner::setUntilPc(uint16_t pc) {
+		stopAtPc = true;
+		untilPc = pc;
+	}
+
+	// Stops once the serial output so far contains text
+	void Runner::addUntilSerial(const std::string &text) {
+		if (!text.empty()) {
+			untilSerial.push_back(text);
+		}
+	}
+
+	void Runner::clearUntil() {
+		stopAtPc = false;
+		untilSerial.clear();
+	}
+
+	// Samples the guest PC from now on, null stops sampling. Not owned.
+	void Runner::setSampler(Sampler *sampler) {
+		core->setSampler(sampler);
+	}
+
+	// Tracks guest calls from now on, null stops tracking. Not owned.
+	void Runner::setCallStack(CallStack *callStack) {
+		core->setCallStack(callStack);
+	}
+
+	// Captures a snapshot into rewind after every frame the LCD completes
+	// from now on, null stops capturing. Not owned.
+	void Runner::setRewind(Rewind *rewind) {
+		this->rewind = rewind;
+	}
+
+	// Goes back to the newest snapshot and drops it. Returns false once
+	// there are none left.
+	bool Runner::stepBack() {
+		return rewind != nullptr && rewind->stepBack(*core);
+	}
+
+	// Runs for up to budget M-cycles. Returns true if a stop condition was
+	// met first.
+	bool Runner::run(uint64_t budget) {
+		uint64_t start = core->getClock();
+		uint64_t end = start + budget;
+		size_t checked = 0;
+		bool stopped = false;
+		match.clear();
+
+		uint64_t frames = core->gpu->getFrameCount();
+		auto began = std::chrono::steady_clock::now();
+		while (core->getClock() < end) {
+			core->emulateCycle();
+			if (rewind != nullptr && core->gpu->getFrameCount() != frames) {
+				frames = core->gpu->getFrameCount();
+				rewind->frame(*core);
+			}
+			if (stopAtPc && core->registers->pc == untilPc) {
+				stopped = true;
+				break;
+			}
+			if (!untilSerial.empty() && matches(checked)) {
+				stopped = true;
+				break;
+			}
+		}
+
+		seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+		cycles += core->getClock() - start;
+		return stopped;
+	}
+
+	// The serial string that stopped the last run, empty if none did
+	const std::string &Runner::getMatch() const {
+		return match;
+	}
+
+	// M-cycles run so far
+	uint64_t Runner::getCycles() const {
+		return cycles;
+	}
+
+	// Frames the LCD has completed, none while it's off
+	uint64_t Runner::getFrames() const {
+		return core->gpu->getFrameCount();
+	}
+
+	uint64_t Runner::getFrameHash() const {
+		return core->gpu->getFrameHash();
+	}
+
+	double Runner::getSeconds() const {
+		return seconds;
+	}
+
+	// Emulated time over wall clock time, 1 is real time
+	double Runner::getSpeed() const {
+		return seconds > 0 ? (double)cycles / CyclesPerSecond / seconds : 0;
+	}
+
+	uint16_t Runner::getPc() const {
+		return core->registers->pc;
+	}
+
+	const std::string &Runner::getSerialOutput() const {
+		return core->serial->getOutput();
+	}
+
+	// Only searches again when new output has arrived since the last check
+	bool Runner::matches(size_t &checked) {
+		const std::string &output = core->serial->getOutput();
+		if (output.size() == checked) {
+			return false;
+		}
+
+		for (auto it = untilSerial.begin(); it != untilSerial.end(); ++it) {
+			size_t from = checked >= it->size() ? checked - it->size() + 1 : 0;
+			if (output.find(*it, from) != std::string::npos) {
+				match = *it;
+				return true;
+			}
+		}
+
+		checked = output.size();
+		return false;
+	}
+}
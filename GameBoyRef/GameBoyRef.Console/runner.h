@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include "core.h"
+
+namespace gameboy {
+	class CallStack;
+	class Rewind;
+	class Sampler;
+
+	// Runs a ROM with no display or input for a number of cycles, or until
+	// the PC reaches an address or the game sends one of a set of strings
+	// over serial, and keeps the wall clock time it took.
+	class Runner {
+	public:
+		static const uint64_t CyclesPerSecond = 1048576; // M-cycles
+
+		static Runner *open(const std::string &path, const std::string &savePath = std::string());
+		virtual ~Runner();
+
+		void setUntilPc(uint16_t pc);
+		void addUntilSerial(const std::string &text);
+		void clearUntil();
+		void setSampler(Sampler *sampler);
+		void setCallStack(CallStack *callStack);
+		void setRewind(Rewind *rewind);
+		bool stepBack();
+		bool run(uint64_t budget);
+		const std::string &getMatch() const;
+		uint64_t getCycles() const;
+		uint64_t getFrames() const;
+		uint64_t getFrameHash() const;
+		double getSeconds() const;
+		double getSpeed() const;
+		uint16_t getPc() const;
+		const std::string &getSerialOutput() const;
+
+	private:
+		Runner(Core *core);
+		Runner(const Runner &);
+		Runner &operator=(const Runner &);
+
+		bool matches(size_t &checked);
+
+		Core *core;
+		Rewind *rewind;
+		bool stopAtPc;
+		uint16_t untilPc;
+		std::vector<std::string> untilSerial;
+		std::string match;
+		uint64_t cycles;
+		double seconds;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,304 @@
+#include "stdafx.h"
+#include "server.h"
+
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include "corpus.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace gameboy {
+	struct Server::Stream {
+		int out;
+		std::map<uint64_t, std::vector<uint8_t>> done; // Responses waiting for earlier ones
+		uint64_t submitted;
+		uint64_t written;
+		bool finished; // No more requests coming
+		bool failed;
+		std::mutex mutex;
+		std::condition_variable ready;
+		std::condition_variable space;
+	};
+
+	// Reads exactly size bytes. Returns false on an error or end of input,
+	// which is clean only if nothing was read.
+	static bool readFully(int in, uint8_t *data, size_t size, bool &clean) {
+		size_t done = 0;
+		clean = false;
+		while (done < size) {
+#ifdef _WIN32
+			int count = _read(in, data + done, (unsigned int)(size - done));
+#else
+			ssize_t count = read(in, data + done, size - done);
+#endif
+			if (count <= 0) {
+				clean = count == 0 && done == 0;
+				return false;
+			}
+			done += count;
+		}
+		return true;
+	}
+
+	static bool writeFully(int out, const uint8_t *data, size_t size) {
+		size_t done = 0;
+		while (done < size) {
+#ifdef _WIN32
+			int count = _write(out, data + done, (unsigned int)(size - done));
+#else
+			ssize_t count = write(out, data + done, size - done);
+#endif
+			if (count <= 0) {
+				return false;
+			}
+			done += count;
+		}
+		return true;
+	}
+
+	static void append(std::vector<uint8_t> &buffer, const void *data, size_t size) {
+		const uint8_t *bytes = static_cast<const uint8_t *>(data);
+		buffer.insert(buffer.end(), bytes, bytes + size);
+	}
+
+	Server::Server(unsigned int threads, OracleCache *cache) :
+		cache(cache),
+		maxInFlight(threads != 0 ? threads * 4 : 4),
+		stopping(false) {
+		for (unsigned int i = 0; i < (threads != 0 ? threads : 1); i++) {
+			this->threads.push_back(std::thread(&Server::worker, this));
+		}
+	}
+
+	Server::~Server() {
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (auto it = threads.begin(); it != threads.end(); ++it) {
+			it->join();
+		}
+	}
+
+	// Handles requests until the input ends. Returns false if the stream
+	// broke or sent something too big to be a message.
+	bool Server::serve(int in, int out) {
+		Stream stream;
+		stream.out = out;
+		stream.submitted = 0;
+		stream.written = 0;
+		stream.finished = false;
+		stream.failed = false;
+		std::thread output(&Server::writer, this, std::ref(stream));
+
+		bool ok = true;
+		for (;;) {
+			uint8_t header[4];
+			bool clean;
+			if (!readFully(in, header, sizeof(header), clean)) {
+				ok = clean;
+				break;
+			}
+
+			uint32_t length = header[0] | header[1] << 8 | header[2] << 16 | (uint32_t)header[3] << 24;
+			if (length > MaxMessage) {
+				ok = false;
+				break;
+			}
+
+			Job job;
+			job.stream = &stream;
+			job.request.resize(length);
+			if (!readFully(in, job.request.data(), length, clean)) {
+				ok = false;
+				break;
+			}
+
+			{
+				std::unique_lock<std::mutex> guard(stream.mutex);
+				stream.space.wait(guard, [&] { return stream.failed || stream.submitted - stream.written < maxInFlight; });
+				if (stream.failed) {
+					break;
+				}
+				job.sequence = stream.submitted++;
+			}
+
+			{
+				std::lock_guard<std::mutex> guard(mutex);
+				queue.push_back(std::move(job));
+			}
+			wake.notify_one();
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(stream.mutex);
+			stream.finished = true;
+		}
+		stream.ready.notify_one();
+		output.join();
+		return ok && !stream.failed;
+	}
+
+	// Serves every connection on a Unix domain socket at path, each on its
+	// own reader thread sharing the worker pool. Only returns on an error.
+	bool Server::listen(const std::string &path) {
+#ifdef _WIN32
+		return false;
+#else
+		sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(address.sun_path)) {
+			return false;
+		}
+		strcpy(address.sun_path, path.c_str());
+
+		int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (listener < 0) {
+			return false;
+		}
+		unlink(path.c_str());
+		if (bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || ::listen(listener, 16) != 0) {
+			close(listener);
+			return false;
+		}
+
+		for (;;) {
+			int connection = accept(listener, nullptr, nullptr);
+			if (connection < 0) {
+				close(listener);
+				return false;
+			}
+
+			std::thread([this, connection] {
+				serve(connection, connection);
+				close(connection);
+			}).detach();
+		}
+#endif
+	}
+
+	void Server::worker() {
+		Scratch scratch;
+		std::vector<uint8_t> response;
+
+		for (;;) {
+			Job job;
+			{
+				std::unique_lock<std::mutex> guard(mutex);
+				wake.wait(guard, [this] { return stopping || !queue.empty(); });
+				if (queue.empty()) {
+					return;
+				}
+				job = std::move(queue.front());
+				queue.pop_front();
+			}
+
+			process(job.request, response, scratch);
+
+			Stream &stream = *job.stream;
+			{
+				std::lock_guard<std::mutex> guard(stream.mutex);
+				stream.done[job.sequence].swap(response);
+			}
+			stream.ready.notify_one();
+		}
+	}
+
+	// Writes responses in request order
+	void Server::writer(Stream &stream) {
+		std::unique_lock<std::mutex> guard(stream.mutex);
+		for (;;) {
+			stream.ready.wait(guard, [&] {
+				return stream.done.count(stream.written) != 0 || (stream.finished && stream.written == stream.submitted);
+			});
+
+			auto it = stream.done.find(stream.written);
+			if (it == stream.done.end()) {
+				return;
+			}
+
+			std::vector<uint8_t> response;
+			response.swap(it->second);
+			stream.done.erase(it);
+			guard.unlock();
+
+			uint32_t length = (uint32_t)response.size();
+			uint8_t header[4] = { (uint8_t)length, (uint8_t)(length >> 8), (uint8_t)(length >> 16), (uint8_t)(length >> 24) };
+			bool ok = stream.failed || (writeFully(stream.out, header, sizeof(header)) && writeFully(stream.out, response.data(), response.size()));
+
+			guard.lock();
+			stream.written++;
+			if (!ok) {
+				stream.failed = true;
+			}
+			stream.space.notify_one();
+		}
+	}
+
+	void Server::process(const std::vector<uint8_t> &request, std::vector<uint8_t> &response, Scratch &scratch) {
+		response.clear();
+		uint32_t count = 0;
+		append(response, &count, sizeof(count));
+
+		const uint8_t *data = request.data();
+		const uint8_t *end = data + request.size();
+		if (end - data < (ptrdiff_t)sizeof(count)) {
+			return;
+		}
+		memcpy(&count, data, sizeof(count));
+		data += sizeof(count);
+
+		for (uint32_t i = 0; i < count; i++) {
+			CorpusRegisters registers;
+			uint16_t memoryCount;
+			if (end - data < (ptrdiff_t)(sizeof(registers) + sizeof(memoryCount))) {
+				response.resize(sizeof(count), 0);
+				return;
+			}
+			memcpy(&registers, data, sizeof(registers));
+			memcpy(&memoryCount, data + sizeof(registers), sizeof(memoryCount));
+			data += sizeof(registers) + sizeof(memoryCount);
+			if (end - data < (ptrdiff_t)(memoryCount * sizeof(CorpusMemory))) {
+				response.resize(sizeof(count), 0);
+				return;
+			}
+
+			Corpus::unpack(registers, scratch.input);
+			scratch.input.memory.resize(memoryCount);
+			for (unsigned int j = 0; j < memoryCount; j++, data += sizeof(CorpusMemory)) {
+				CorpusMemory entry;
+				memcpy(&entry, data, sizeof(entry));
+				scratch.input.memory[j] = MemoryRecord{ entry.address, entry.value };
+			}
+
+			uint8_t cycles = cache != nullptr ? cache->execute(scratch.input, scratch.output) : Oracle::execute(scratch.input, scratch.output);
+			if (scratch.output.memory.size() > UINT16_MAX) {
+				response.resize(sizeof(count), 0); // 65535 records in and the instruction wrote one more
+				return;
+			}
+
+			Corpus::pack(scratch.output, registers);
+			memoryCount = (uint16_t)scratch.output.memory.size();
+			response.push_back(cycles);
+			append(response, &registers, sizeof(registers));
+			append(response, &memoryCount, sizeof(memoryCount));
+
+			size_t at = response.size();
+			response.resize(at + memoryCount * sizeof(CorpusMemory));
+			for (unsigned int j = 0; j < memoryCount; j++, at += sizeof(CorpusMemory)) {
+				CorpusMemory entry = { scratch.output.memory[j].address, scratch.output.memory[j].value, 0 };
+				memcpy(&response[at], &entry, sizeof(entry));
+			}
+		}
+
+		memcpy(response.data(), &count, sizeof(count));
+	}
+}
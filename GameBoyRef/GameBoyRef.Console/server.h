@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cinttypes>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "oracle.h"
+#include "oraclecache.h"
+
+namespace gameboy {
+	// Serves the oracle over a byte stream: stdin/stdout or connections on a
+	// Unix domain socket. Every message is a little-endian uint32 payload
+	// length followed by the payload.
+	//
+	// Request:  uint32 count, then count states of
+	//           CorpusRegisters, uint16 memory count, CorpusMemory[count]
+	// Response: uint32 count, then count results of
+	//           uint8 cycles, CorpusRegisters, uint16 memory count,
+	//           CorpusMemory[count]
+	//
+	// A request that doesn't decode, or has a result with more memory records
+	// than a uint16 can count, gets a response with count 0. Requests on
+	// a stream run on the worker pool as they arrive and responses go back in
+	// request order.
+	class Server {
+	public:
+		static const uint32_t MaxMessage = 64 << 20;
+
+		explicit Server(unsigned int threads, OracleCache *cache);
+		virtual ~Server();
+
+		bool serve(int in, int out);
+		bool listen(const std::string &path);
+
+	private:
+		struct Stream;
+
+		struct Job {
+			Stream *stream;
+			uint64_t sequence;
+			std::vector<uint8_t> request;
+		};
+
+		struct Scratch {
+			OracleState input;
+			OracleState output;
+		};
+
+		Server(const Server &);
+		Server &operator=(const Server &);
+
+		void worker();
+		void writer(Stream &stream);
+		void process(const std::vector<uint8_t> &request, std::vector<uint8_t> &response, Scratch &scratch);
+
+		OracleCache *cache;
+		unsigned int maxInFlight; // Requests per stream queued or running before reading stops
+		std::deque<Job> queue;
+		bool stopping;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::vector<std::thread> threads;
+	};
+}
\ No newline at end of file
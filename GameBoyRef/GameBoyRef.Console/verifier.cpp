@@ -0,0 +1,254 @@
+#include "stdafx.h"
+#include "verifier.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+namespace gameboy {
+	static const uint64_t ChunkSize = 256; // Vectors a worker takes at a time
+
+	// Returns null if the file can't be read
+	Verifier *Verifier::open(const std::string &path) {
+		Verifier *verifier = new Verifier();
+		verifier->corpus = Corpus::open(path);
+		if (verifier->corpus != nullptr) {
+			return verifier;
+		}
+
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file) {
+			delete verifier;
+			return nullptr;
+		}
+
+		std::vector<char> &text = verifier->text;
+		text.resize((size_t)file.tellg() + 1);
+		file.seekg(0);
+		file.read(text.data(), text.size() - 1);
+		text.back() = '\0';
+
+		// Split in place, each field ends up null terminated
+		unsigned int line = 0;
+		char *start = text.data();
+		while (*start != '\0') {
+			char *end = strchr(start, '\n');
+			if (end == nullptr) {
+				end = start + strlen(start);
+			}
+			else {
+				*end++ = '\0';
+			}
+			line++;
+
+			char *fields[3] = {};
+			unsigned int count = 0;
+			for (char *c = start; *c != '\0' && *c != '#'; ) {
+				if (*c == ' ' || *c == '\t' || *c == '\r') {
+					*c++ = '\0';
+					continue;
+				}
+				if (count < 3) {
+					fields[count] = c;
+				}
+				count++;
+				while (*c != '\0' && *c != ' ' && *c != '\t' && *c != '\r') {
+					c++;
+				}
+			}
+
+			if (count > 0) {
+				static const char empty[] = "";
+				verifier->vectors.push_back(TextVector{ fields[0], fields[1] != nullptr ? fields[1] : empty,
+					fields[2] != nullptr ? atoi(fields[2]) : -1, line });
+			}
+			start = end;
+		}
+		return verifier;
+	}
+
+	Verifier::Verifier() :
+		corpus(nullptr),
+		next(0),
+		passCount(0),
+		failCount(0) {
+	}
+
+	Verifier::~Verifier() {
+		delete corpus;
+	}
+
+	uint64_t Verifier::size() const {
+		return corpus != nullptr ? corpus->size() : vectors.size();
+	}
+
+	bool Verifier::isBinary() const {
+		return corpus != nullptr;
+	}
+
+	// Failures past maxFailures are counted but not written
+	void Verifier::run(unsigned int threads, std::ostream &out, unsigned int maxFailures) {
+		if (threads == 0) {
+			threads = 1;
+		}
+
+		next = 0;
+		passCount = 0;
+		failCount = 0;
+		std::vector<std::thread> workers;
+		for (unsigned int i = 0; i < threads; i++) {
+			workers.push_back(std::thread(&Verifier::worker, this, std::ref(out), maxFailures));
+		}
+		for (auto it = workers.begin(); it != workers.end(); ++it) {
+			it->join();
+		}
+	}
+
+	uint64_t Verifier::getPassCount() const {
+		return passCount.load();
+	}
+
+	uint64_t Verifier::getFailCount() const {
+		return failCount.load();
+	}
+
+	void Verifier::worker(std::ostream &out, unsigned int maxFailures) {
+		Scratch scratch;
+		std::string name, fields;
+		uint64_t total = size();
+		uint64_t passed = 0;
+
+		for (;;) {
+			uint64_t first = next.fetch_add(ChunkSize);
+			if (first >= total) {
+				break;
+			}
+
+			uint64_t last = first + ChunkSize < total ? first + ChunkSize : total;
+			for (uint64_t i = first; i < last; i++) {
+				if (check(i, scratch, name, fields)) {
+					passed++;
+					continue;
+				}
+
+				if (failCount.fetch_add(1) < maxFailures) {
+					std::lock_guard<std::mutex> guard(mutex);
+					out << "FAIL " << name << ": " << fields << "\n";
+				}
+			}
+		}
+
+		passCount.fetch_add(passed);
+	}
+
+	bool Verifier::check(uint64_t index, Scratch &scratch, std::string &name, std::string &fields) {
+		int expectedCycles, actualCycles;
+		char label[48];
+
+		if (corpus != nullptr) {
+			if (corpus->verify(index, scratch.input, scratch.actual)) {
+				return true;
+			}
+
+			const CorpusRecord &record = corpus->getRecord(index);
+			snprintf(label, sizeof(label), record.opCode >= 0x100 ? "record %llu opcode CB%02X" : "record %llu opcode %02X",
+				(unsigned long long)index, record.opCode & 0xFF);
+			name = label;
+			if (!corpus->getOutput(index, scratch.expected)) {
+				fields = "memory out of range";
+				return false;
+			}
+			expectedCycles = record.cycles;
+		}
+		else {
+			const TextVector &vector = vectors[index];
+			snprintf(label, sizeof(label), "line %u", vector.line);
+			if (!Oracle::parse(vector.input, scratch.input) || !Oracle::parse(vector.expected, scratch.expected)) {
+				name = label;
+				fields = "malformed";
+				return false;
+			}
+
+			actualCycles = Oracle::execute(scratch.input, scratch.actual);
+			if (Oracle::equals(scratch.expected, scratch.actual) && (vector.cycles < 0 || vector.cycles == actualCycles)) {
+				return true;
+			}
+			name = label;
+			expectedCycles = vector.cycles;
+		}
+
+		actualCycles = Oracle::execute(scratch.input, scratch.actual);
+		fields = describe(scratch.expected, scratch.actual, expectedCycles, actualCycles);
+		return false;
+	}
+
+	// Lists the fields that differ as "name expected/actual", memory
+	// addresses in hex
+	std::string Verifier::describe(const OracleState &expected, const OracleState &actual, int expectedCycles, int actualCycles) {
+		static const char *names[] = { "A", "B", "C", "D", "E", "H", "L", "SP", "PC", "FZ", "FN", "FH", "FC", "IME" };
+		const unsigned int expectedValues[] = {
+			expected.a, expected.b, expected.c, expected.d, expected.e, expected.h, expected.l, expected.sp, expected.pc,
+			expected.zero, expected.subtract, expected.halfCarry, expected.carry, expected.ime
+		};
+		const unsigned int actualValues[] = {
+			actual.a, actual.b, actual.c, actual.d, actual.e, actual.h, actual.l, actual.sp, actual.pc,
+			actual.zero, actual.subtract, actual.halfCarry, actual.carry, actual.ime
+		};
+
+		std::string fields;
+		char field[48];
+		auto add = [&fields](const char *text) {
+			if (!fields.empty()) {
+				fields += ' ';
+			}
+			fields += text;
+		};
+
+		for (unsigned int i = 0; i < 14; i++) {
+			if (expectedValues[i] != actualValues[i]) {
+				snprintf(field, sizeof(field), "%s %u/%u", names[i], expectedValues[i], actualValues[i]);
+				add(field);
+			}
+		}
+		if (expectedCycles >= 0 && expectedCycles != actualCycles) {
+			snprintf(field, sizeof(field), "cycles %d/%d", expectedCycles, actualCycles);
+			add(field);
+		}
+
+		// Both lists are in address order, a missing address shows as -
+		const unsigned int MaxAddresses = 8;
+		unsigned int differences = 0;
+		auto e = expected.memory.begin(), a = actual.memory.begin();
+		while (e != expected.memory.end() || a != actual.memory.end()) {
+			bool hasExpected = e != expected.memory.end() && (a == actual.memory.end() || e->address <= a->address);
+			bool hasActual = a != actual.memory.end() && (e == expected.memory.end() || a->address <= e->address);
+			uint16_t address = hasExpected ? e->address : a->address;
+			if (!hasExpected || !hasActual || e->value != a->value) {
+				if (differences++ < MaxAddresses) {
+					char expectedText[4] = "-", actualText[4] = "-";
+					if (hasExpected) {
+						snprintf(expectedText, sizeof(expectedText), "%u", e->value);
+					}
+					if (hasActual) {
+						snprintf(actualText, sizeof(actualText), "%u", a->value);
+					}
+					snprintf(field, sizeof(field), "[%04X] %s/%s", address, expectedText, actualText);
+					add(field);
+				}
+			}
+			if (hasExpected) {
+				++e;
+			}
+			if (hasActual) {
+				++a;
+			}
+		}
+		if (differences > MaxAddresses) {
+			snprintf(field, sizeof(field), "and %u more addresses", differences - MaxAddresses);
+			add(field);
+		}
+		return fields;
+	}
+}
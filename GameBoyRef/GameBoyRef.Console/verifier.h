@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cinttypes>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "corpus.h"
+#include "oracle.h"
+
+namespace gameboy {
+	// Checks a corpus of oracle vectors against the reference Core on a pool
+	// of threads. The corpus is either a binary corpus file or text with one
+	// vector per line, "input expected [cycles]" in the Run format; blank
+	// lines and lines starting with # are skipped.
+	class Verifier {
+	public:
+		static Verifier *open(const std::string &path);
+		virtual ~Verifier();
+
+		uint64_t size() const;
+		bool isBinary() const;
+		void run(unsigned int threads, std::ostream &out, unsigned int maxFailures);
+		uint64_t getPassCount() const;
+		uint64_t getFailCount() const;
+
+		static std::string describe(const OracleState &expected, const OracleState &actual, int expectedCycles, int actualCycles);
+
+	private:
+		struct TextVector {
+			const char *input;
+			const char *expected;
+			int cycles; // -1 if the line doesn't give one
+			unsigned int line;
+		};
+
+		struct Scratch {
+			OracleState input;
+			OracleState expected;
+			OracleState actual;
+		};
+
+		Verifier();
+		Verifier(const Verifier &);
+		Verifier &operator=(const Verifier &);
+
+		void worker(std::ostream &out, unsigned int maxFailures);
+		bool check(uint64_t index, Scratch &scratch, std::string &name, std::string &fields);
+
+		Corpus *corpus;
+		std::vector<char> text;
+		std::vector<TextVector> vectors;
+		std::atomic<uint64_t> next;
+		std::atomic<uint64_t> passCount;
+		std::atomic<uint64_t> failCount;
+		std::mutex mutex;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include "fuzzer.h"
+
+static void usage() {
+	std::cerr
+		<< "usage: gameboyref-fuzz [options]\n"
+		<< "  --cases N           states to generate, default 1000000\n"
+		<< "  --threads N         worker threads, default one per core\n"
+		<< "  --seed N            first thread's seed, default 1\n"
+		<< "  --mode NAME         candidate to compare against the reference, all or none, default all\n"
+		<< "  --output PATH       where mismatches go, default fuzz-mismatches.txt\n"
+		<< "  --max-mismatches N  mismatches to minimize and write, default 100\n"
+		<< "  --corpus PATH       also write every state and its reference result as a binary corpus\n";
+}
+
+int main(int argc, char *argv[]) {
+	uint64_t cases = 1000000;
+	unsigned int threads = std::thread::hardware_concurrency();
+	uint32_t seed = 1;
+	std::string mode = "all";
+	std::string output = "fuzz-mismatches.txt";
+	unsigned int maxMismatches = 100;
+	std::string corpusPath;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--cases") == 0 && i + 1 < argc) {
+			cases = strtoull(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			threads = (unsigned int)strtoul(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc) {
+			mode = argv[++i];
+		}
+		else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+			output = argv[++i];
+		}
+		else if (strcmp(argv[i], "--max-mismatches") == 0 && i + 1 < argc) {
+			maxMismatches = (unsigned int)strtoul(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--corpus") == 0 && i + 1 < argc) {
+			corpusPath = argv[++i];
+		}
+		else {
+			usage();
+			return 2;
+		}
+	}
+
+	std::vector<gameboy::Executor> candidates;
+	std::vector<gameboy::Executor> available = gameboy::Fuzzer::getCandidates();
+	for (auto it = available.begin(); it != available.end(); ++it) {
+		if (mode == "all" || mode == it->name) {
+			candidates.push_back(*it);
+		}
+	}
+	if (candidates.empty() && mode != "none") {
+		std::cerr << "unknown mode " << mode << ", available:";
+		for (auto it = available.begin(); it != available.end(); ++it) {
+			std::cerr << " " << it->name;
+		}
+		std::cerr << "\n";
+		return 2;
+	}
+
+	std::ofstream out(output);
+	if (!out) {
+		std::cerr << "can't write " << output << "\n";
+		return 2;
+	}
+
+	std::unique_ptr<gameboy::CorpusWriter> corpus;
+	if (!corpusPath.empty()) {
+		corpus.reset(gameboy::CorpusWriter::create(corpusPath));
+		if (!corpus) {
+			std::cerr << "can't write " << corpusPath << "\n";
+			return 2;
+		}
+	}
+
+	gameboy::Fuzzer fuzzer(candidates, out, maxMismatches);
+	fuzzer.setCorpus(corpus.get());
+	auto start = std::chrono::steady_clock::now();
+	fuzzer.run(cases, threads, seed);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (corpus && !corpus->close()) {
+		std::cerr << "can't write " << corpusPath << "\n";
+		return 2;
+	}
+
+	std::cout << fuzzer.getCaseCount() << " cases, " << candidates.size() << " modes, "
+		<< fuzzer.getMismatchCount() << " mismatches in " << seconds << " s ("
+		<< (uint64_t)(fuzzer.getCaseCount() * 60 / seconds) << " cases/min)\n";
+	return fuzzer.getMismatchCount() == 0 ? 0 : 1;
+}
@@ -0,0 +1,263 @@
+#include "fuzzer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include "core.h"
+#include "functions.h"
+#include "lockstep.h"
+#include "oraclecache.h"
+#include "savestate.h"
+
+namespace gameboy {
+	static int executeReference(const OracleState &input, OracleState &output) {
+		return Oracle::execute(input, output);
+	}
+
+	// Through the text interface the C# tests call
+	static int executeText(const OracleState &input, OracleState &output) {
+		static thread_local std::vector<char> buffer(0x10000);
+		std::string text;
+		Oracle::format(input, text);
+		std::vector<char> in(text.begin(), text.end());
+		in.push_back('\0');
+
+		if (!Run(in.data(), buffer.data()) || !Oracle::parse(buffer.data(), output)) {
+			output = OracleState();
+		}
+		return -1;
+	}
+
+	// On a fork, so writes take the copy on write path
+	static int executeFork(const OracleState &input, OracleState &output) {
+		Core parent;
+		Oracle::load(parent, input);
+		std::unique_ptr<Core> child(parent.fork());
+		child->emulateCycle();
+		Oracle::store(*child, output);
+		return (int)child->getClock();
+	}
+
+	// After a round trip through a save state
+	static int executeSaveState(const OracleState &input, OracleState &output) {
+		static thread_local std::unique_ptr<SaveState> state(new SaveState);
+		Core source;
+		Oracle::load(source, input);
+		source.saveState(*state);
+
+		Core core;
+		if (!core.loadState(*state)) {
+			output = OracleState();
+			return -1;
+		}
+		core.emulateCycle();
+		Oracle::store(core, output);
+		return (int)core.getClock();
+	}
+
+	// From the result cache. A decoy that differs from input in every byte
+	// outside the cache key runs first, so the answer comes from its entry;
+	// a key that misses a byte the instruction depends on shows up as a
+	// mismatch. The decoy's memory is reversed to take the unsorted path.
+	static int executeCache(const OracleState &input, OracleState &output) {
+		static OracleCache cache(1 << 16);
+		uint16_t addresses[OracleCache::KeyAddresses];
+		OracleCache::getAddresses(input, addresses);
+
+		OracleState decoy(input);
+		for (auto it = decoy.memory.begin(); it != decoy.memory.end(); ++it) {
+			if (std::find(addresses, addresses + OracleCache::KeyAddresses, it->address) == addresses + OracleCache::KeyAddresses) {
+				it->value ^= 0xA5;
+			}
+		}
+		std::reverse(decoy.memory.begin(), decoy.memory.end());
+		cache.execute(decoy, output);
+		return cache.execute(input, output);
+	}
+
+	// One lane of the lockstep interpreter
+	static int executeLockstep(const OracleState &input, OracleState &output) {
+		static thread_local Lockstep lockstep;
+		uint8_t cycles;
+		lockstep.execute(&input, &output, &cycles, 1);
+		return cycles;
+	}
+
+	const Executor Fuzzer::reference = { "reference", executeReference };
+
+	// Optimized execution modes register here
+	std::vector<Executor> Fuzzer::getCandidates() {
+		std::vector<Executor> candidates;
+		candidates.push_back(Executor{ "text", executeText });
+		candidates.push_back(Executor{ "fork", executeFork });
+		candidates.push_back(Executor{ "savestate", executeSaveState });
+		candidates.push_back(Executor{ "cache", executeCache });
+		candidates.push_back(Executor{ "lockstep", executeLockstep });
+		return candidates;
+	}
+
+	// Same shape as CpuTests.GenerateRandomState: random registers and flags,
+	// the instruction at 0 and random bytes up to MemorySize. opCode
+	// 0x100-0x1FF is a CB instruction.
+	void Fuzzer::generate(std::mt19937 &random, uint16_t opCode, OracleState &state) {
+		state.a = random();
+		state.b = random();
+		state.c = random();
+		state.d = random();
+		state.e = random();
+		state.h = random();
+		state.l = random();
+		state.sp = random();
+		state.pc = 0;
+		state.zero = random() & 1;
+		state.subtract = random() & 1;
+		state.halfCarry = random() & 1;
+		state.carry = random() & 1;
+		state.ime = random() & 1;
+
+		state.memory.clear();
+		uint16_t address = 0;
+		if (opCode >= 0x100) {
+			state.memory.push_back(MemoryRecord{ address++, 0xCB });
+		}
+		state.memory.push_back(MemoryRecord{ address++, (uint8_t)opCode });
+		while (address < MemorySize) {
+			state.memory.push_back(MemoryRecord{ address++, (uint8_t)random() });
+		}
+	}
+
+	Fuzzer::Fuzzer(const std::vector<Executor> &candidates, std::ostream &out, unsigned int maxMismatches) :
+		candidates(candidates),
+		out(out),
+		maxMismatches(maxMismatches),
+		corpus(nullptr),
+		caseCount(0),
+		mismatchCount(0) {
+	}
+
+	Fuzzer::~Fuzzer() {
+	}
+
+	// Every generated state and its reference result also go to corpus
+	void Fuzzer::setCorpus(CorpusWriter *corpus) {
+		this->corpus = corpus;
+	}
+
+	void Fuzzer::run(uint64_t cases, unsigned int threads, uint32_t seed) {
+		if (threads == 0) {
+			threads = 1;
+		}
+
+		std::vector<std::thread> workers;
+		for (unsigned int i = 0; i < threads; i++) {
+			uint64_t share = cases / threads + (i < cases % threads ? 1 : 0);
+			workers.push_back(std::thread(&Fuzzer::worker, this, share, seed + i));
+		}
+		for (auto it = workers.begin(); it != workers.end(); ++it) {
+			it->join();
+		}
+	}
+
+	uint64_t Fuzzer::getCaseCount() const {
+		return caseCount.load();
+	}
+
+	uint64_t Fuzzer::getMismatchCount() const {
+		return mismatchCount.load();
+	}
+
+	void Fuzzer::worker(uint64_t cases, uint32_t seed) {
+		std::mt19937 random(seed);
+		OracleState state, expected, actual;
+
+		for (uint64_t i = 0; i < cases; i++) {
+			generate(random, random() % 0x200, state);
+			int cycles = reference.execute(state, expected);
+			if (corpus != nullptr) {
+				std::lock_guard<std::mutex> guard(mutex);
+				corpus->add(state, expected, (uint8_t)cycles);
+			}
+
+			for (auto it = candidates.begin(); it != candidates.end(); ++it) {
+				int candidateCycles = it->execute(state, actual);
+				if (Oracle::equals(expected, actual) && (candidateCycles < 0 || candidateCycles == cycles)) {
+					continue;
+				}
+
+				if (mismatchCount.fetch_add(1) < maxMismatches) {
+					OracleState minimized(state);
+					minimize(minimized, *it);
+					report(minimized, *it);
+				}
+			}
+			caseCount.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	bool Fuzzer::differs(const OracleState &state, const Executor &candidate) {
+		OracleState expected, actual;
+		int cycles = reference.execute(state, expected);
+		int candidateCycles = candidate.execute(state, actual);
+		return !Oracle::equals(expected, actual) || (candidateCycles >= 0 && candidateCycles != cycles);
+	}
+
+	// Drops memory records in shrinking chunks, then zeroes registers, keeping
+	// every change that still reproduces. The instruction bytes are kept.
+	void Fuzzer::minimize(OracleState &state, const Executor &candidate) {
+		size_t fixed = state.memory.size() > 0 && state.memory[0].value == 0xCB ? 2 : 1;
+		for (size_t chunk = (state.memory.size() - fixed) / 2; chunk > 0; chunk /= 2) {
+			size_t start = fixed;
+			while (start < state.memory.size()) {
+				OracleState smaller(state);
+				size_t end = start + chunk < smaller.memory.size() ? start + chunk : smaller.memory.size();
+				smaller.memory.erase(smaller.memory.begin() + start, smaller.memory.begin() + end);
+				if (differs(smaller, candidate)) {
+					state = smaller;
+				}
+				else {
+					start += chunk;
+				}
+			}
+		}
+
+		uint8_t *bytes[] = { &state.a, &state.b, &state.c, &state.d, &state.e, &state.h, &state.l };
+		for (unsigned int i = 0; i < sizeof(bytes) / sizeof(bytes[0]); i++) {
+			uint8_t saved = *bytes[i];
+			*bytes[i] = 0;
+			if (!differs(state, candidate)) {
+				*bytes[i] = saved;
+			}
+		}
+
+		uint16_t sp = state.sp;
+		state.sp = 0;
+		if (!differs(state, candidate)) {
+			state.sp = sp;
+		}
+	}
+
+	// The input line can be fed straight back to Run
+	void Fuzzer::report(const OracleState &state, const Executor &candidate) {
+		OracleState expected, actual;
+		int cycles = reference.execute(state, expected);
+		int candidateCycles = candidate.execute(state, actual);
+
+		std::string input, expectedText, actualText;
+		Oracle::format(state, input);
+		Oracle::format(expected, expectedText);
+		Oracle::format(actual, actualText);
+
+		char opCode[8];
+		bool cb = !state.memory.empty() && state.memory[0].value == 0xCB;
+		snprintf(opCode, sizeof(opCode), cb ? "CB%02X" : "%02X", state.memory.size() > (cb ? 1u : 0u) ? state.memory[cb ? 1 : 0].value : 0);
+
+		std::lock_guard<std::mutex> guard(mutex);
+		out << "# " << candidate.name << " opcode " << opCode << "\n"
+			<< input << "\n"
+			<< "# expected " << expectedText << " cycles " << cycles << "\n"
+			<< "# actual " << actualText << " cycles " << candidateCycles << "\n";
+		out.flush();
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cinttypes>
+#include <mutex>
+#include <ostream>
+#include <random>
+#include <vector>
+#include "corpus.h"
+#include "oracle.h"
+
+namespace gameboy {
+	// One way of running an instruction. Returns the M-cycles taken, or -1 if
+	// the mode can't tell.
+	struct Executor {
+		const char *name;
+		int (*execute)(const OracleState &input, OracleState &output);
+	};
+
+	// Runs random oracle-shaped states through the reference Core and through
+	// every candidate execution mode, on as many threads as asked. States that
+	// disagree are shrunk and written out as reproducible cases.
+	class Fuzzer {
+	public:
+		static const unsigned int MemorySize = 1024; // Bytes of random memory per state, as CpuTests generates
+
+		explicit Fuzzer(const std::vector<Executor> &candidates, std::ostream &out, unsigned int maxMismatches);
+		virtual ~Fuzzer();
+
+		void setCorpus(CorpusWriter *corpus);
+		void run(uint64_t cases, unsigned int threads, uint32_t seed);
+		uint64_t getCaseCount() const;
+		uint64_t getMismatchCount() const;
+
+		static const Executor reference;
+		static std::vector<Executor> getCandidates();
+		static void generate(std::mt19937 &random, uint16_t opCode, OracleState &state);
+
+	private:
+		void worker(uint64_t cases, uint32_t seed);
+		bool differs(const OracleState &state, const Executor &candidate);
+		void minimize(OracleState &state, const Executor &candidate);
+		void report(const OracleState &state, const Executor &candidate);
+
+		std::vector<Executor> candidates;
+		std::ostream &out;
+		unsigned int maxMismatches;
+		CorpusWriter *corpus;
+		std::atomic<uint64_t> caseCount;
+		std::atomic<uint64_t> mismatchCount;
+		std::mutex mutex;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include <cstring>
+#include <iostream>
+#include "tests.h"
+
+// Each test is registered with ctest by name in CMakeLists.txt
+static const struct {
+	const char *name;
+	void (*run)();
+} tests[] = {
+	{ "savestate", gameboy::testSaveState },
+	{ "fork", gameboy::testFork },
+	{ "mbc1", gameboy::testMbc1 },
+	{ "mbc3", gameboy::testMbc3 },
+	{ "mbc5", gameboy::testMbc5 },
+	{ "dma", gameboy::testDma },
+	{ "interrupts", gameboy::testInterrupts },
+	{ "halt", gameboy::testHalt },
+	{ "sampler", gameboy::testSampler },
+	{ "callstack", gameboy::testCallStack },
+	{ "rewind", gameboy::testRewind },
+	{ "batterysave", gameboy::testBatterySave },
+	{ "lockstep", gameboy::testLockstep },
+	{ "calloverlap", gameboy::testCallOverlap },
+	{ "romcache", gameboy::testRomCache }
+};
+
+static unsigned int failures = 0;
+
+namespace gameboy {
+	void check(bool passed, const char *expression, const char *file, int line) {
+		if (!passed) {
+			std::cerr << file << ":" << line << ": CHECK(" << expression << ") failed\n";
+			++failures;
+		}
+	}
+}
+
+static bool run(unsigned int index) {
+	unsigned int before = failures;
+	tests[index].run();
+	bool passed = failures == before;
+	std::cout << tests[index].name << (passed ? " passed\n" : " failed\n");
+	return passed;
+}
+
+// Runs the tests named on the command line, or every test
+int main(int argc, char *argv[]) {
+	const unsigned int count = sizeof(tests) / sizeof(tests[0]);
+	bool passed = true;
+	if (argc == 1) {
+		for (unsigned int i = 0; i < count; i++) {
+			passed = run(i) && passed;
+		}
+		return passed ? 0 : 1;
+	}
+
+	for (int arg = 1; arg < argc; arg++) {
+		unsigned int i = 0;
+		while (i < count && strcmp(tests[i].name, argv[arg]) != 0) {
+			++i;
+		}
+		if (i == count) {
+			std::cerr << "unknown test " << argv[arg] << "\n";
+			return 2;
+		}
+		passed = run(i) && passed;
+	}
+	return passed ? 0 : 1;
+}
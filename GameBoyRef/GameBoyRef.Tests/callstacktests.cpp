@@ -0,0 +1,78 @@
+#include <map>
+#include <sstream>
+#include <string>
+#include "callstack.h"
+#include "core.h"
+#include "cpuregisters.h"
+#include "symbols.h"
+#include "tests.h"
+
+namespace gameboy {
+	// Main goes round a loop of CALL, RST, a routine that returns with POP HL
+	// and JP (HL), and a timer interrupt whose handler enables interrupts and
+	// takes a serial interrupt inside it
+	void testCallStack() {
+		std::vector<uint8_t> image = makeImage(0x00, 2, 0x00);
+		put(image, 0x08, { 0x00, 0xC9 }); // Rst08: NOP, RET
+		put(image, 0x50, { 0xC3, 0x40, 0x02 }); // JP TimerHandler
+		put(image, 0x58, { 0xC3, 0x60, 0x02 }); // JP SerialHandler
+		put(image, 0x150, {
+			0x3E, 0x0C, 0xE0, 0xFF, 0xFB, // IE timer and serial, EI
+			0xCD, 0x00, 0x02, // CALL Func
+			0xCF, // RST 08
+			0xCD, 0x20, 0x02, // CALL Jumper
+			0x3E, 0x04, 0xE0, 0x0F, // Request the timer interrupt
+			0x18, 0xF3 // Back to CALL Func at 0x155
+		});
+		put(image, 0x200, { 0x00, 0x00, 0x00, 0xC9 }); // Func
+		put(image, 0x220, { 0xE1, 0xE9 }); // Jumper: POP HL, JP (HL)
+		put(image, 0x240, { 0xF5, 0xFB, 0x3E, 0x08, 0xE0, 0x0F, 0x00, 0xF1, 0xD9 }); // TimerHandler
+		put(image, 0x260, { 0x00, 0x00, 0xD9 }); // SerialHandler
+		Core core;
+		CHECK(core.loadCartridge(makeRom(image)));
+		core.boot();
+		core.registers->pc = 0x150;
+
+		CallStack callStack;
+		core.setCallStack(&callStack);
+		unsigned int deepest = 0;
+		while (core.getClock() < 20000 || core.registers->pc != 0x155) {
+			core.emulateCycle();
+			if (callStack.getDepth() > deepest) {
+				deepest = callStack.getDepth();
+			}
+		}
+		CHECK(callStack.getDepth() == 0);
+		CHECK(deepest == 2);
+
+		SymbolTable symbols;
+		symbols.add(0, 0x08, "Rst08");
+		symbols.add(0, 0x50, "TimerVector");
+		symbols.add(0, 0x58, "SerialVector");
+		symbols.add(0, 0x150, "Main");
+		symbols.add(0, 0x200, "Func");
+		symbols.add(0, 0x220, "Jumper");
+		std::stringstream folded;
+		callStack.writeFolded(folded, symbols);
+
+		std::map<std::string, uint64_t> paths;
+		std::string line;
+		while (std::getline(folded, line)) {
+			size_t space = line.rfind(' ');
+			paths[line.substr(0, space)] = std::stoull(line.substr(space + 1));
+		}
+		CHECK(paths.size() == 6);
+		CHECK(paths["Main"] > 0);
+		CHECK(paths["Main;Func"] > 0);
+		CHECK(paths["Main;Rst08"] > 0);
+		CHECK(paths["Main;Jumper"] > 0);
+		CHECK(paths["Main;TimerVector"] > 0);
+		CHECK(paths["Main;TimerVector;SerialVector"] > 0);
+
+		// Func gets 3 NOPs and the RET each time round, the CALL is Main's.
+		// Jumper only gets the POP, which unwinds its frame before JP (HL).
+		CHECK(paths["Main;Func"] % 7 == 0);
+		CHECK(paths["Main;Jumper"] % 3 == 0);
+		CHECK(paths["Main;Func"] / 7 == paths["Main;Jumper"] / 3);
+	}
+}
@@ -0,0 +1,197 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include "cartridge.h"
+#include "core.h"
+#include "mbc3cartridge.h"
+#include "memory.h"
+#include "rom.h"
+#include "savestate.h"
+#include "tests.h"
+
+namespace gameboy {
+	// Every bank ends with its own number, high byte then low byte
+	static std::shared_ptr<const Rom> bankedRom(uint8_t type, unsigned int banks, uint8_t ramSize) {
+		std::vector<uint8_t> image = makeImage(type, banks, ramSize);
+		put(image, 0x150, { 0x18, 0xFE }); // JR to itself
+		for (unsigned int bank = 0; bank < banks; bank++) {
+			image[bank * 0x4000 + 0x3FFE] = (uint8_t)(bank >> 8);
+			image[bank * 0x4000 + 0x3FFF] = (uint8_t)bank;
+		}
+		return makeRom(image);
+	}
+
+	static unsigned int bankAt(Core &core, uint16_t window) {
+		return (core.memory->read(window + 0x3FFE) << 8) | core.memory->read(window + 0x3FFF);
+	}
+
+	void testMbc1() {
+		Core core;
+		CHECK(core.loadCartridge(bankedRom(0x03, 128, 0x03)));
+		core.boot();
+		Memory *memory = core.memory;
+		CHECK(bankAt(core, 0x0000) == 0);
+		CHECK(bankAt(core, 0x4000) == 1);
+
+		memory->write(0x2000, 0x05);
+		CHECK(bankAt(core, 0x4000) == 0x05);
+		memory->write(0x4000, 0x01);
+		CHECK(bankAt(core, 0x4000) == 0x25);
+		memory->write(0x2000, 0x20); // Low bits 0 select the next bank
+		CHECK(bankAt(core, 0x4000) == 0x21);
+		CHECK(bankAt(core, 0x0000) == 0);
+		memory->write(0x6000, 0x01); // Mode 1 banks 0x0000 and RAM with the high bits
+		CHECK(bankAt(core, 0x0000) == 0x20);
+
+		CHECK(memory->read(0xA000) == 0xFF); // RAM still disabled
+		memory->write(0xA000, 0x12);
+		memory->write(0x0000, 0x0A);
+		CHECK(memory->read(0xA000) != 0x12);
+		memory->write(0x4000, 0x02);
+		memory->write(0xA000, 0xB2);
+		memory->write(0x4000, 0x00);
+		memory->write(0xA000, 0xB0);
+		CHECK(memory->read(0xA000) == 0xB0);
+		memory->write(0x4000, 0x02);
+		CHECK(memory->read(0xA000) == 0xB2);
+		CHECK(bankAt(core, 0x4000) == 0x41);
+
+		memory->write(0x6000, 0x00); // Mode 0 always uses RAM bank 0
+		CHECK(memory->read(0xA000) == 0xB0);
+		CHECK(bankAt(core, 0x0000) == 0);
+		memory->write(0x0000, 0x00);
+		CHECK(memory->read(0xA000) == 0xFF);
+	}
+
+	void testMbc3() {
+		Core core;
+		CHECK(core.loadCartridge(bankedRom(0x10, 128, 0x03)));
+		core.boot();
+		Memory *memory = core.memory;
+
+		memory->write(0x2000, 0x45);
+		CHECK(bankAt(core, 0x4000) == 0x45);
+		memory->write(0x2000, 0x00);
+		CHECK(bankAt(core, 0x4000) == 1);
+
+		memory->write(0x0000, 0x0A);
+		memory->write(0x4000, 0x03);
+		memory->write(0xA000, 0x33);
+		memory->write(0x4000, 0x00);
+		memory->write(0xA000, 0x30);
+		memory->write(0x4000, 0x03);
+		CHECK(memory->read(0xA000) == 0x33);
+
+		// The clock runs on emulated cycles and is read through a latch
+		memory->write(0x4000, 0x08);
+		memory->write(0x6000, 0x00);
+		memory->write(0x6000, 0x01);
+		uint8_t seconds = memory->read(0xA000);
+		core.runUntil(core.getClock() + 5 * Mbc3Cartridge::CyclesPerSecond);
+		CHECK(memory->read(0xA000) == seconds);
+		memory->write(0x6000, 0x00);
+		memory->write(0x6000, 0x01);
+		CHECK(memory->read(0xA000) == (seconds + 5) % 60);
+
+		// Setting minutes, then halting the clock
+		memory->write(0x4000, 0x09);
+		memory->write(0xA000, 42);
+		memory->write(0x4000, 0x0C);
+		memory->write(0xA000, 0x40);
+		core.runUntil(core.getClock() + 3 * Mbc3Cartridge::CyclesPerSecond);
+		memory->write(0x6000, 0x00);
+		memory->write(0x6000, 0x01);
+		CHECK(memory->read(0xA000) == 0x40);
+		memory->write(0x4000, 0x09);
+		CHECK(memory->read(0xA000) == 42);
+		memory->write(0x4000, 0x08);
+		CHECK(memory->read(0xA000) == (seconds + 5) % 60);
+
+		memory->write(0x4000, 0x00);
+		CHECK(memory->read(0xA000) == 0x30);
+	}
+
+	void testMbc5() {
+		Core core;
+		CHECK(core.loadCartridge(bankedRom(0x1B, 512, 0x04)));
+		core.boot();
+		Memory *memory = core.memory;
+
+		memory->write(0x2000, 0x34);
+		memory->write(0x3000, 0x01);
+		CHECK(bankAt(core, 0x4000) == 0x134);
+		memory->write(0x2000, 0x00);
+		memory->write(0x3000, 0x00);
+		CHECK(bankAt(core, 0x4000) == 0); // Bank 0 is selectable
+
+		// All 16 RAM banks, the last of which save states used to drop
+		memory->write(0x0000, 0x0A);
+		for (unsigned int bank = 0; bank < 16; bank++) {
+			memory->write(0x4000, bank);
+			memory->write(0xBFFF, 0xF0 | bank);
+		}
+		for (unsigned int bank = 0; bank < 16; bank++) {
+			memory->write(0x4000, bank);
+			CHECK(memory->read(0xBFFF) == (0xF0 | bank));
+		}
+
+		std::unique_ptr<SaveState> state(new SaveState());
+		core.saveState(*state);
+		memory->write(0xBFFF, 0x00);
+		memory->write(0x4000, 0x00);
+		CHECK(core.loadState(*state));
+		CHECK(memory->read(0xBFFF) == 0xFF);
+		memory->write(0x4000, 0x08);
+		CHECK(memory->read(0xBFFF) == 0xF8);
+	}
+
+	// Battery backed RAM written through the .sav mapping is there for the
+	// next core that opens the same file
+	void testBatterySave() {
+		const char *path = "batterysave.sav";
+		std::remove(path);
+		std::shared_ptr<const Rom> rom = bankedRom(0x1B, 8, 0x03);
+		for (unsigned int run = 0; run < 2; run++) {
+			Core core;
+			CHECK(core.loadCartridge(rom));
+			CHECK(core.cartridge->openSave(path));
+			core.boot();
+			Memory *memory = core.memory;
+			memory->write(0x0000, 0x0A);
+			for (unsigned int bank = 0; bank < 4; bank++) {
+				memory->write(0x4000, bank);
+				CHECK(memory->read(0xA000) == (run == 0 ? 0x00 : 0xA0 | bank));
+				memory->write(0xA000, 0xA0 | bank);
+			}
+			memory->write(0x0000, 0x00);
+		}
+
+		Core plain;
+		CHECK(plain.loadCartridge(bankedRom(0x1A, 8, 0x03)));
+		CHECK(!plain.cartridge->openSave(path)); // No battery
+		std::remove(path);
+	}
+
+	// Every spelling of a path shares one image while anything holds it
+	void testRomCache() {
+		const char *path = "romcache.gb";
+		std::vector<uint8_t> image = makeImage(0x00, 2, 0x00);
+		{
+			std::ofstream file(path, std::ios::binary);
+			file.write(reinterpret_cast<const char *>(image.data()), image.size());
+		}
+
+		std::shared_ptr<const Rom> rom = Rom::open(path);
+		CHECK(rom != nullptr);
+		CHECK(Rom::open(std::string("./") + path) == rom);
+		CHECK(rom->getBankCount() == 2);
+
+		std::weak_ptr<const Rom> released = rom;
+		rom.reset();
+		CHECK(released.expired());
+		rom = Rom::open(path);
+		CHECK(rom != nullptr && memcmp(rom->getBank(1), &image[Rom::BankSize], Rom::BankSize) == 0);
+		std::remove(path);
+	}
+}
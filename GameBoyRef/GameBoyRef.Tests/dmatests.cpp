@@ -0,0 +1,60 @@
+#include <memory>
+#include "core.h"
+#include "memory.h"
+#include "savestate.h"
+#include "tests.h"
+
+namespace gameboy {
+	// OAM reads see the open bus for DmaCycles after a DMA starts, then the
+	// copied bytes, for the guest and the host alike
+	void testDma() {
+		std::vector<uint8_t> image = makeImage(0x00, 2, 0x00);
+		put(image, 0x150, {
+			0xAF, 0xE0, 0x40, // LCD off
+			0x21, 0x00, 0xC1, 0x06, 0xA0, 0x3E, 0x10, // C100-C19F = 0x10, 0x11, ...
+			0x22, 0x3C, 0x05, 0x20, 0xFB,
+			0x3E, 0xC1, 0xE0, 0x46, // DMA from C100
+			0xFA, 0x00, 0xFE, 0xEA, 0x00, 0xC0, // C000 = (FE00) while blocked
+			0x06, 0x32, 0x05, 0x20, 0xFD, // 200 cycles
+			0xFA, 0x00, 0xFE, 0xEA, 0x01, 0xC0, // C001 = (FE00)
+			0xFA, 0x9F, 0xFE, 0xEA, 0x02, 0xC0, // C002 = (FE9F)
+			0x18, 0xFE
+		});
+		Core core;
+		CHECK(core.loadCartridge(makeRom(image)));
+		core.boot();
+		core.runUntil(5000);
+		Memory *memory = core.memory;
+		CHECK(memory->read(0xC000) == 0xFF);
+		CHECK(memory->read(0xC001) == 0x10);
+		CHECK(memory->read(0xC002) == 0xAF);
+		CHECK(!memory->isDmaActive());
+
+		// Echo RAM sources read WRAM
+		memory->write(0xC105, 0x77);
+		uint64_t start = core.getClock();
+		memory->write(Memory::DmaAddress, 0xE1);
+		CHECK(memory->isDmaActive());
+		CHECK(memory->read(0xFE05) == 0xFF);
+
+		Core *child = core.fork();
+		CHECK(child->memory->isDmaActive());
+		CHECK(child->memory->read(0xFE05) == 0xFF);
+		std::unique_ptr<SaveState> state(new SaveState());
+		core.saveState(*state);
+		CHECK(state->memory[0xFE05] == 0x77);
+
+		while (core.getClock() < start + Memory::DmaCycles) {
+			CHECK(memory->read(0xFE05) == 0xFF);
+			core.emulateCycle();
+		}
+		CHECK(!memory->isDmaActive());
+		CHECK(memory->read(0xFE05) == 0x77);
+		CHECK(child->memory->read(0xFE05) == 0xFF);
+
+		child->runUntil(start + Memory::DmaCycles);
+		CHECK(!child->memory->isDmaActive());
+		CHECK(child->memory->read(0xFE05) == 0x77);
+		delete child;
+	}
+}
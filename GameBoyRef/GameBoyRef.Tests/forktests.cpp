@@ -0,0 +1,61 @@
+#include "core.h"
+#include "cpuregisters.h"
+#include "memory.h"
+#include "tests.h"
+
+namespace gameboy {
+	// A forked core shares pages with its parent until a write, after which
+	// neither side sees the other's writes, cartridge RAM included
+	void testFork() {
+		std::vector<uint8_t> image = makeImage(0x1A, 4, 0x03); // MBC5 with 32 KiB of RAM
+		put(image, 0x150, { 0x18, 0xFE }); // JR to itself
+		Core *parent = new Core();
+		CHECK(parent->loadCartridge(makeRom(image)));
+		parent->boot();
+
+		parent->memory->write(0x0000, 0x0A); // Cartridge RAM on
+		parent->memory->write(0xA000, 0x11);
+		parent->memory->write(0x8000, 0x22);
+		parent->memory->write(0xC000, 0x33);
+		parent->memory->write(0xD123, 0x44);
+		parent->memory->write(0xFF80, 0x55);
+		CHECK(parent->memory->getOwnedPageCount() > 0);
+
+		Core *child = parent->fork();
+		CHECK(parent->memory->getOwnedPageCount() == 0);
+		CHECK(child->memory->getOwnedPageCount() == 0);
+		CHECK(child->getClock() == parent->getClock());
+		CHECK(child->registers->pc == parent->registers->pc);
+		CHECK(child->memory->read(0xA000) == 0x11);
+		CHECK(child->memory->read(0x8000) == 0x22);
+		CHECK(child->memory->read(0xC000) == 0x33);
+		CHECK(child->memory->read(0xD123) == 0x44);
+		CHECK(child->memory->read(0xFF80) == 0x55);
+
+		child->memory->write(0xA000, 0x66);
+		child->memory->write(0xC000, 0x77);
+		child->memory->write(0xFF80, 0x88);
+		CHECK(child->memory->getOwnedPageCount() == 1); // 0xC0xx, cartridge RAM and HRAM aren't paged
+		parent->memory->write(0xD123, 0x99);
+		parent->memory->write(0x8000, 0xAA);
+		CHECK(parent->memory->read(0xA000) == 0x11);
+		CHECK(parent->memory->read(0xC000) == 0x33);
+		CHECK(parent->memory->read(0xFF80) == 0x55);
+		CHECK(child->memory->read(0xD123) == 0x44);
+		CHECK(child->memory->read(0x8000) == 0x22);
+		CHECK(child->memory->getOwnedPageCount() == 3); // The parent's copies left the child the originals
+
+		// Pages outlive the core that made them
+		Core *grandchild = child->fork();
+		delete parent;
+		delete child;
+		CHECK(grandchild->memory->read(0xA000) == 0x66);
+		CHECK(grandchild->memory->read(0xC000) == 0x77);
+		CHECK(grandchild->memory->read(0xD123) == 0x44);
+		CHECK(grandchild->memory->getOwnedPageCount() >= 2);
+
+		grandchild->runUntil(grandchild->getClock() + 10000);
+		CHECK(grandchild->registers->pc == 0x150);
+		delete grandchild;
+	}
+}
@@ -0,0 +1,90 @@
+#include "core.h"
+#include "cpuregisters.h"
+#include "memory.h"
+#include "serial.h"
+#include "tests.h"
+
+namespace gameboy {
+	// Handlers at 0x50 and 0x58 count timer and serial interrupts in 0xFF80
+	// and 0xFF81
+	static std::vector<uint8_t> countingImage() {
+		std::vector<uint8_t> image = makeImage(0x00, 2, 0x00);
+		put(image, 0x50, { 0xF5, 0xF0, 0x80, 0x3C, 0xE0, 0x80, 0xF1, 0xD9 });
+		put(image, 0x58, { 0xF5, 0xF0, 0x81, 0x3C, 0xE0, 0x81, 0xF1, 0xD9 });
+		return image;
+	}
+
+	// TIMA overflows every 16 ticks of 4 cycles while a serial transfer
+	// finishes once, with the guest halted in between
+	void testInterrupts() {
+		std::vector<uint8_t> image = countingImage();
+		put(image, 0x150, {
+			0x3E, 0x0C, 0xE0, 0xFF, 0xAF, 0xE0, 0x0F, // IE timer and serial, IF clear
+			0x3E, 0xF0, 0xE0, 0x06, 0xE0, 0x05, // TMA and TIMA 0xF0
+			0x3E, 0x05, 0xE0, 0x07, // TAC on, 4 cycles a tick
+			0x3E, 0x41, 0xE0, 0x01, 0x3E, 0x81, 0xE0, 0x02, // Send 'A' on the internal clock
+			0xFB, 0x76, 0x00, 0x18, 0xFC // EI, then HALT forever
+		});
+		Core core;
+		CHECK(core.loadCartridge(makeRom(image)));
+		core.boot();
+		core.runUntil(200);
+		Memory *memory = core.memory;
+		uint8_t timer = memory->read(0xFF80);
+		CHECK(timer > 0);
+		core.runUntil(core.getClock() + 64 * 200);
+		timer = memory->read(0xFF80) - timer;
+		CHECK(timer >= 199 && timer <= 201);
+		CHECK(memory->read(0xFF81) == 1);
+		CHECK(core.serial->getOutput() == "A");
+		CHECK(memory->read(Serial::DataAddress) == 0xFF);
+		CHECK((memory->read(Serial::ControlAddress) & 0x80) == 0);
+		CHECK(core.registers->getIME());
+		CHECK(core.registers->getSP() == 0xFFFE);
+	}
+
+	// An interrupt taken just before a HALT returns to the HALT, which then
+	// waits for the next one. With IME clear a pending interrupt still ends
+	// the HALT, without being taken.
+	void testHalt() {
+		std::vector<uint8_t> image = countingImage();
+		put(image, 0x150, {
+			0x3E, 0x04, 0xE0, 0xFF, 0xFB, 0x00, // IE timer, EI
+			0x3E, 0x04, 0xE0, 0x0F, // Request the timer interrupt
+			0x76, // HALT at 0x15A
+			0x3E, 0x01, 0xEA, 0x00, 0xC0, 0x18, 0xFE // C000 = 1
+		});
+		Core core;
+		CHECK(core.loadCartridge(makeRom(image)));
+		core.boot();
+		core.runUntil(20000);
+		Memory *memory = core.memory;
+		CHECK(memory->read(0xFF80) == 1);
+		CHECK(memory->read(0xC000) == 0);
+		CHECK(core.registers->pc == 0x15A);
+
+		memory->write(Memory::InterruptFlagAddress, 0x04);
+		core.runUntil(core.getClock() + 100);
+		CHECK(memory->read(0xFF80) == 2);
+		CHECK(memory->read(0xC000) == 1);
+
+		image[0x154] = 0xF3; // DI instead of EI
+		Core disabled;
+		CHECK(disabled.loadCartridge(makeRom(image)));
+		disabled.boot();
+		disabled.runUntil(100);
+		memory = disabled.memory;
+		CHECK(memory->read(0xC000) == 1);
+		CHECK(memory->read(0xFF80) == 0);
+
+		memory->write(0xC000, 0x00);
+		memory->write(Memory::InterruptFlagAddress, 0x00);
+		disabled.registers->pc = 0x15A;
+		disabled.runUntil(disabled.getClock() + 20000);
+		CHECK(memory->read(0xC000) == 0);
+		memory->write(Memory::InterruptFlagAddress, 0x04);
+		disabled.runUntil(disabled.getClock() + 100);
+		CHECK(memory->read(0xC000) == 1);
+		CHECK(memory->read(0xFF80) == 0);
+	}
+}
@@ -0,0 +1,97 @@
+#include <random>
+#include "lockstep.h"
+#include "oracle.h"
+#include "tests.h"
+
+namespace gameboy {
+	// Random registers and flags with the instruction at 0 and random bytes
+	// after it. opCode 0x100-0x1FF is a CB instruction.
+	static OracleState randomState(std::mt19937 &random, uint16_t opCode) {
+		OracleState state;
+		state.a = random();
+		state.b = random();
+		state.c = random();
+		state.d = random();
+		state.e = random();
+		state.h = random();
+		state.l = random();
+		state.sp = random();
+		state.pc = 0;
+		state.zero = random() & 1;
+		state.subtract = random() & 1;
+		state.halfCarry = random() & 1;
+		state.carry = random() & 1;
+		state.ime = random() & 1;
+
+		uint16_t address = 0;
+		if (opCode >= 0x100) {
+			state.memory.push_back(MemoryRecord{ address++, 0xCB });
+		}
+		state.memory.push_back(MemoryRecord{ address++, (uint8_t)opCode });
+		while (address < 16) {
+			state.memory.push_back(MemoryRecord{ address++, (uint8_t)random() });
+		}
+		return state;
+	}
+
+	static void add(std::vector<OracleState> &inputs, std::mt19937 &random, uint16_t opCode, unsigned int count) {
+		for (unsigned int i = 0; i < count; i++) {
+			inputs.push_back(randomState(random, opCode));
+		}
+	}
+
+	// One array through Lockstep::execute covering full batches, batches cut
+	// short by a new instruction, lanes whose inputs are split up by
+	// instructions that take the Oracle::execute path, and every vectorized
+	// instruction. Each output has to match Oracle::execute on its own input.
+	void testLockstep() {
+		std::mt19937 random(49);
+		std::vector<OracleState> inputs;
+		add(inputs, random, 0x80, Lockstep::Lanes * 2 + 6); // ADD A,B: two full batches and a partial one
+		add(inputs, random, 0x3C, 5); // INC A
+		add(inputs, random, 0x77, 1); // LD (HL),A in the middle of the INC A batch
+		add(inputs, random, 0x3C, 5);
+		add(inputs, random, 0xC3, 2); // JP nn
+		add(inputs, random, 0x3C, Lockstep::Lanes - 3); // Fills a batch exactly
+		add(inputs, random, 0x111, Lockstep::Lanes + 1); // RL C
+		for (unsigned int i = 0; i < 20; i++) {
+			add(inputs, random, i & 1 ? 0x27 : 0xC6, 1 + i % 3); // DAA and ADD A,n taking turns
+		}
+		OracleState unordered = randomState(random, 0x80);
+		std::swap(unordered.memory[2], unordered.memory[5]);
+		inputs.push_back(unordered);
+		add(inputs, random, 0x80, 3);
+		for (uint16_t opCode = 0; opCode < 0x200; opCode++) {
+			if (Lockstep::isVectorized(opCode)) {
+				add(inputs, random, opCode, 3);
+			}
+		}
+		add(inputs, random, 0x76, 1); // HALT last, nothing may be left in a batch
+
+		std::vector<OracleState> outputs(inputs.size());
+		std::vector<uint8_t> cycles(inputs.size(), 0xFF);
+		Lockstep lockstep;
+		lockstep.execute(inputs.data(), outputs.data(), cycles.data(), inputs.size());
+
+		unsigned int mismatches = 0;
+		for (size_t i = 0; i < inputs.size(); i++) {
+			OracleState expected;
+			uint8_t expectedCycles = Oracle::execute(inputs[i], expected);
+			if (!Oracle::equals(expected, outputs[i]) || cycles[i] != expectedCycles) {
+				mismatches++;
+			}
+		}
+		CHECK(mismatches == 0);
+
+		// Again without cycles, into the same object
+		std::vector<OracleState> again(inputs.size());
+		lockstep.execute(inputs.data(), again.data(), nullptr, inputs.size());
+		mismatches = 0;
+		for (size_t i = 0; i < inputs.size(); i++) {
+			if (!Oracle::equals(outputs[i], again[i])) {
+				mismatches++;
+			}
+		}
+		CHECK(mismatches == 0);
+	}
+}
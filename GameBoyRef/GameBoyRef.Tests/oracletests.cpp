@@ -0,0 +1,38 @@
+#include "oracle.h"
+#include "tests.h"
+
+namespace gameboy {
+	static OracleState callState(uint8_t opCode, uint16_t sp) {
+		OracleState state = OracleState();
+		state.pc = 0x1000;
+		state.sp = sp;
+		state.memory.push_back(MemoryRecord{ 0x1000, opCode });
+		state.memory.push_back(MemoryRecord{ 0x1001, 0x34 });
+		state.memory.push_back(MemoryRecord{ 0x1002, 0x12 });
+		return state;
+	}
+
+	static uint16_t callTarget(uint8_t opCode, uint16_t sp) {
+		OracleState output;
+		Oracle::execute(callState(opCode, sp), output);
+		return output.pc;
+	}
+
+	// CALL pushes the return address before reading its target, so a stack
+	// just above the instruction overwrites the target it jumps to. The
+	// oracle pushes and reads words high byte first.
+	void testCallOverlap() {
+		const uint8_t calls[] = { 0xCD, 0xC4, 0xD4 }; // CALL nn, CALL NZ,nn and CALL NC,nn with the flags clear
+		for (unsigned int i = 0; i < sizeof(calls); i++) {
+			CHECK(callTarget(calls[i], 0x2000) == 0x3412);
+			CHECK(callTarget(calls[i], 0x1002) == 0x0312); // Pushes 10 03 at 0x1000
+			CHECK(callTarget(calls[i], 0x1003) == 0x1003); // Pushes 10 03 at 0x1001
+			CHECK(callTarget(calls[i], 0x1004) == 0x3410); // Pushes 10 03 at 0x1002
+			CHECK(callTarget(calls[i], 0x1005) == 0x3412);
+		}
+
+		OracleState output;
+		CHECK(Oracle::execute(callState(0xCD, 0x1003), output) == 6);
+		CHECK(output.sp == 0x1001);
+	}
+}
@@ -0,0 +1,74 @@
+#include <cstring>
+#include <memory>
+#include "core.h"
+#include "gpu.h"
+#include "memory.h"
+#include "rewind.h"
+#include "savestate.h"
+#include "tests.h"
+
+namespace gameboy {
+	static void runFrame(Core &core) {
+		core.runUntil(core.gpu->getNextVBlank());
+	}
+
+	// Stepping back to frame j loads exactly the state saved at frame j, for
+	// keyframes and deltas alike, and running on from there repeats history
+	void testRewind() {
+		const unsigned int Frames = 12;
+		std::vector<uint8_t> image = makeImage(0x00, 2, 0x00);
+		put(image, 0x40, { 0x34, 0xD9 }); // VBlank: INC (HL), RETI
+		put(image, 0x150, {
+			0x3E, 0x01, 0xE0, 0xFF, 0x21, 0x00, 0xC0, 0xFB, // IE VBlank, HL = C000, EI
+			0x11, 0x00, 0xD0, 0x1A, 0x3C, 0x12, 0x13, 0xCB, 0xAA, 0xCB, 0xE2, 0x18, 0xF6 // Count through D000-DFFF forever
+		});
+		Core core;
+		CHECK(core.loadCartridge(makeRom(image)));
+		core.boot();
+
+		Rewind rewind(1, 64, 4);
+		std::vector<std::unique_ptr<SaveState>> expected;
+		for (unsigned int frame = 0; frame < Frames; frame++) {
+			runFrame(core);
+			expected.emplace_back(new SaveState());
+			core.saveState(*expected.back());
+			rewind.frame(core);
+			CHECK(rewind.size() == frame + 1); // Waits for the worker, nothing is dropped
+		}
+		CHECK(rewind.dropped() == 0);
+		CHECK(core.memory->read(0xC000) >= Frames);
+
+		std::unique_ptr<SaveState> actual(new SaveState());
+		for (unsigned int j = Frames; j-- > 5;) {
+			CHECK(rewind.stepBack(core));
+			core.saveState(*actual);
+			CHECK(memcmp(actual.get(), expected[j].get(), sizeof(SaveState)) == 0);
+		}
+		CHECK(rewind.size() == 5);
+
+		for (unsigned int frame = 6; frame < Frames; frame++) {
+			runFrame(core);
+			core.saveState(*actual);
+			CHECK(memcmp(actual.get(), expected[frame].get(), sizeof(SaveState)) == 0);
+		}
+
+		// Full groups are evicted once the ring is full, the oldest kept
+		// snapshot still decodes
+		Rewind bounded(1, 8, 4);
+		for (unsigned int frame = 0; frame < 20; frame++) {
+			runFrame(core);
+			bounded.frame(core);
+			CHECK(bounded.size() <= 8);
+		}
+		runFrame(core);
+		unsigned int kept = bounded.size();
+		CHECK(kept >= 4);
+		uint64_t clock = core.getClock();
+		for (unsigned int i = 0; i < kept; i++) {
+			CHECK(bounded.stepBack(core));
+			CHECK(core.getClock() < clock);
+			clock = core.getClock();
+		}
+		CHECK(!bounded.stepBack(core));
+	}
+}
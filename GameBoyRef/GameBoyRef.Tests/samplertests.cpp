@@ -0,0 +1,62 @@
+#include <map>
+#include <sstream>
+#include <string>
+#include "core.h"
+#include "sampler.h"
+#include "symbols.h"
+#include "tests.h"
+
+namespace gameboy {
+	// Main calls Sub forever, Sub calls Leaf 4 times and Leaf spins for a
+	// while, so Leaf has most of the self cycles and Main all the inclusive
+	void testSampler() {
+		std::vector<uint8_t> image = makeImage(0x00, 2, 0x00);
+		put(image, 0x150, { 0xCD, 0x60, 0x01, 0x18, 0xFB }); // Main: CALL Sub, JR Main
+		put(image, 0x160, { 0x06, 0x04, 0xCD, 0x70, 0x01, 0x05, 0x20, 0xFA, 0xC9 }); // Sub
+		put(image, 0x170, { 0x0E, 0x14, 0x0D, 0x20, 0xFD, 0xC9 }); // Leaf
+		Core core;
+		CHECK(core.loadCartridge(makeRom(image)));
+		core.boot();
+
+		Sampler sampler(7);
+		core.setSampler(&sampler);
+		core.runUntil(100000);
+		core.setSampler(nullptr);
+		uint64_t samples = sampler.getSampleCount();
+		CHECK(samples > 100000 / 13 && samples <= 100000 / 7); // Samples land on the first instruction boundary past the interval
+
+		SymbolTable symbols;
+		symbols.add(0, 0x150, "Main");
+		symbols.add(0, 0x160, "Sub");
+		symbols.add(0, 0x170, "Leaf");
+		std::stringstream report;
+		sampler.writeReport(report, symbols);
+
+		struct Cost {
+			uint64_t self;
+			uint64_t inclusive;
+		};
+		std::map<std::string, Cost> costs;
+		std::string line;
+		std::getline(report, line);
+		CHECK(line == "function,self_cycles,inclusive_cycles");
+		uint64_t self = 0;
+		while (std::getline(report, line)) {
+			size_t first = line.find(',');
+			size_t second = line.find(',', first + 1);
+			Cost cost = { std::stoull(line.substr(first + 1, second - first - 1)), std::stoull(line.substr(second + 1)) };
+			costs[line.substr(0, first)] = cost;
+			self += cost.self;
+		}
+
+		uint64_t total = samples * 7;
+		CHECK(costs.size() == 3);
+		CHECK(self == total);
+		CHECK(costs["Main"].inclusive == total);
+		CHECK(costs["Sub"].inclusive == costs["Sub"].self + costs["Leaf"].self);
+		CHECK(costs["Leaf"].inclusive == costs["Leaf"].self);
+		CHECK(costs["Leaf"].self > costs["Sub"].self);
+		CHECK(costs["Sub"].self > costs["Main"].self);
+		CHECK(costs["Main"].self > 0);
+	}
+}
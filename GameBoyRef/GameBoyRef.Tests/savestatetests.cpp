@@ -0,0 +1,61 @@
+#include <cstring>
+#include <memory>
+#include "core.h"
+#include "memory.h"
+#include "savestate.h"
+#include "tests.h"
+
+namespace gameboy {
+	// Increments its way around WRAM forever while the VBlank and timer
+	// interrupts count themselves in 0xFF81 and 0xFF80
+	static std::shared_ptr<const Rom> counterRom() {
+		std::vector<uint8_t> image = makeImage(0x00, 2, 0x00);
+		put(image, 0x40, { 0xF5, 0xF0, 0x81, 0x3C, 0xE0, 0x81, 0xF1, 0xD9 });
+		put(image, 0x50, { 0xF5, 0xF0, 0x80, 0x3C, 0xE0, 0x80, 0xF1, 0xD9 });
+		put(image, 0x150, {
+			0x3E, 0x05, 0xE0, 0x07, // TAC: timer on, 16 cycles a tick
+			0x3E, 0x05, 0xE0, 0xFF, // IE: VBlank and timer
+			0x21, 0x00, 0xC0, 0xFB, // LD HL,0xC000, EI
+			0x34, 0x23, 0xCB, 0xAC, 0x18, 0xFA // INC (HL), INC HL, RES 5,H, JR back
+		});
+		return makeRom(image);
+	}
+
+	// Running on from a loaded state matches running on from where it was
+	// saved, in the same Core and in a fresh one
+	void testSaveState() {
+		auto rom = counterRom();
+		Core core;
+		CHECK(core.loadCartridge(rom));
+		core.boot();
+		core.runUntil(100000);
+
+		std::unique_ptr<SaveState> saved(new SaveState());
+		std::unique_ptr<SaveState> expected(new SaveState());
+		std::unique_ptr<SaveState> actual(new SaveState());
+		core.saveState(*saved);
+		core.runUntil(300000);
+		core.saveState(*expected);
+		CHECK(core.memory->read(0xFF80) != 0);
+		CHECK(core.memory->read(0xFF81) != 0);
+
+		CHECK(core.loadState(*saved));
+		CHECK(core.getClock() == saved->clock);
+		core.runUntil(300000);
+		core.saveState(*actual);
+		CHECK(memcmp(actual.get(), expected.get(), sizeof(SaveState)) == 0);
+
+		Core other;
+		CHECK(other.loadCartridge(rom));
+		CHECK(other.loadState(*saved));
+		other.runUntil(300000);
+		other.saveState(*actual);
+		CHECK(memcmp(actual.get(), expected.get(), sizeof(SaveState)) == 0);
+
+		saved->version = SaveStateVersion - 1;
+		CHECK(!other.loadState(*saved));
+		saved->version = SaveStateVersion;
+		saved->magic = 0;
+		CHECK(!other.loadState(*saved));
+	}
+}
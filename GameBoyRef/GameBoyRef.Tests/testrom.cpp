@@ -0,0 +1,24 @@
+#include <cstring>
+#include "rom.h"
+#include "tests.h"
+
+namespace gameboy {
+	std::vector<uint8_t> makeImage(uint8_t type, unsigned int banks, uint8_t ramSize) {
+		std::vector<uint8_t> image(banks * Rom::BankSize, 0);
+		put(image, 0x100, { 0x00, 0xC3, 0x50, 0x01 }); // NOP, JP 0x150
+		image[0x147] = type;
+		for (unsigned int size = 2; size < banks; size *= 2) {
+			++image[0x148];
+		}
+		image[0x149] = ramSize;
+		return image;
+	}
+
+	void put(std::vector<uint8_t> &image, size_t offset, std::initializer_list<uint8_t> bytes) {
+		memcpy(&image[offset], bytes.begin(), bytes.size());
+	}
+
+	std::shared_ptr<const Rom> makeRom(const std::vector<uint8_t> &image) {
+		return Rom::create(image.data(), image.size());
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+namespace gameboy {
+	class Rom;
+
+	// Records a failed CHECK, the test keeps running
+	void check(bool passed, const char *expression, const char *file, int line);
+
+	// In-memory ROM image of banks 16 KiB banks with the header's cartridge
+	// type and RAM size code filled in. The entry point jumps to 0x150.
+	std::vector<uint8_t> makeImage(uint8_t type, unsigned int banks, uint8_t ramSize);
+	void put(std::vector<uint8_t> &image, size_t offset, std::initializer_list<uint8_t> bytes);
+	std::shared_ptr<const Rom> makeRom(const std::vector<uint8_t> &image);
+
+	void testSaveState();
+	void testFork();
+	void testMbc1();
+	void testMbc3();
+	void testMbc5();
+	void testDma();
+	void testInterrupts();
+	void testHalt();
+	void testSampler();
+	void testCallStack();
+	void testRewind();
+	void testBatterySave();
+	void testLockstep();
+	void testCallOverlap();
+	void testRomCache();
+}
+
+#define CHECK(condition) gameboy::check((condition), #condition, __FILE__, __LINE__)
\ No newline at end of file
@@ -0,0 +1,188 @@
+#include "batch.h"
+
+#include <thread>
+#include "gpu.h"
+#include "joypad.h"
+#include "rom.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace gameboy {
+	// Keeps the calling thread on one CPU, worker i on CPU i wrapping around.
+	// Elsewhere the scheduler decides.
+	static void pinThread(unsigned int index) {
+		unsigned int cpus = std::thread::hardware_concurrency();
+		if (cpus == 0) {
+			return;
+		}
+
+#ifdef _WIN32
+		SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << (index % cpus % (sizeof(DWORD_PTR) * 8)));
+#elif defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(index % cpus, &set);
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+	}
+
+	// threads 0 means one per core
+	BatchRunner::BatchRunner(unsigned int threads, bool pin) :
+		threads(threads != 0 ? threads : std::thread::hardware_concurrency()),
+		pin(pin),
+		jobs(nullptr),
+		results(nullptr),
+		done(0),
+		steals(0) {
+		if (this->threads == 0) {
+			this->threads = 1;
+		}
+	}
+
+	BatchRunner::~BatchRunner() {
+	}
+
+	void BatchRunner::setJobCallback(JobCallback callback) {
+		jobCallback = callback;
+	}
+
+	void BatchRunner::setProgressCallback(ProgressCallback callback) {
+		progressCallback = callback;
+	}
+
+	// Runs every job and returns when all are done, results[i] for jobs[i]
+	void BatchRunner::run(const std::vector<BatchJob> &jobs, std::vector<BatchResult> &results) {
+		results.assign(jobs.size(), BatchResult());
+		if (jobs.empty()) {
+			return;
+		}
+
+		this->jobs = &jobs;
+		this->results = &results;
+		done = 0;
+
+		unsigned int count = jobs.size() < threads ? (unsigned int)jobs.size() : threads;
+		queues.clear();
+		for (unsigned int i = 0; i < count; i++) {
+			queues.emplace_back(new Queue());
+			for (size_t job = jobs.size() * i / count; job < jobs.size() * (i + 1) / count; job++) {
+				queues[i]->jobs.push_back(job);
+			}
+		}
+
+		std::vector<std::thread> pool;
+		for (unsigned int i = 0; i < count; i++) {
+			pool.push_back(std::thread(&BatchRunner::work, this, i));
+		}
+		for (auto it = pool.begin(); it != pool.end(); ++it) {
+			it->join();
+		}
+
+		queues.clear();
+		this->jobs = nullptr;
+		this->results = nullptr;
+	}
+
+	unsigned int BatchRunner::getThreadCount() const {
+		return threads;
+	}
+
+	// Jobs taken from another worker's queue, over every run so far
+	uint64_t BatchRunner::getSteals() const {
+		return steals;
+	}
+
+	void BatchRunner::work(unsigned int index) {
+		if (pin) {
+			pinThread(index);
+		}
+
+		Worker worker;
+		worker.base = nullptr;
+		size_t job;
+		while (take(index, job)) {
+			runJob(worker, job);
+		}
+		delete worker.base;
+	}
+
+	// The owner works through its own queue from the front, thieves take
+	// from the back where the jobs furthest from the owner's ROM are
+	bool BatchRunner::take(unsigned int index, size_t &job) {
+		{
+			Queue &own = *queues[index];
+			std::lock_guard<std::mutex> guard(own.mutex);
+			if (!own.jobs.empty()) {
+				job = own.jobs.front();
+				own.jobs.pop_front();
+				return true;
+			}
+		}
+
+		for (size_t i = 1; i < queues.size(); i++) {
+			Queue &victim = *queues[(index + i) % queues.size()];
+			std::lock_guard<std::mutex> guard(victim.mutex);
+			if (!victim.jobs.empty()) {
+				job = victim.jobs.back();
+				victim.jobs.pop_back();
+				++steals;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void BatchRunner::runJob(Worker &worker, size_t index) {
+		const BatchJob &job = (*jobs)[index];
+		BatchResult &result = (*results)[index];
+
+		if (job.rom != worker.baseRom) {
+			delete worker.base;
+			worker.base = new Core();
+			worker.baseRom = job.rom;
+			if (job.rom && worker.base->loadCartridge(job.rom)) {
+				worker.base->boot();
+			}
+			else {
+				delete worker.base;
+				worker.base = nullptr;
+			}
+		}
+
+		result.loaded = worker.base != nullptr;
+		result.cycles = 0;
+		result.frameHash = 0;
+		if (worker.base != nullptr) {
+			Core *core = worker.base->fork();
+			uint64_t start = core->getClock();
+			auto input = job.inputs.begin();
+			for (uint64_t frame = 0; frame < job.frames; frame++) {
+				for (; input != job.inputs.end() && input->frame <= frame; ++input) {
+					core->joypad->setButtons(input->buttons);
+				}
+
+				core->runUntil(start + (frame + 1) * Gpu::FrameCycles);
+			}
+
+			result.cycles = core->getClock() - start;
+			result.frameHash = core->gpu->getFrameHash();
+			if (jobCallback) {
+				jobCallback(index, *core, result);
+			}
+			delete core;
+		}
+
+		std::lock_guard<std::mutex> guard(progressMutex);
+		size_t count = ++done;
+		if (progressCallback) {
+			progressCallback(count, jobs->size());
+		}
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cinttypes>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "core.h"
+
+namespace gameboy {
+	class Rom;
+
+	// Sets the joypad to buttons (Joypad::Button bits) from frame on
+	struct BatchInput {
+		uint64_t frame;
+		uint8_t buttons;
+	};
+
+	struct BatchJob {
+		std::shared_ptr<const Rom> rom;
+		std::vector<BatchInput> inputs; // Sorted by frame
+		uint64_t frames;
+	};
+
+	struct BatchResult {
+		bool loaded; // False if the cartridge type isn't supported
+		uint64_t cycles;
+		uint64_t frameHash; // Gpu::getFrameHash after the last frame
+	};
+
+	// Runs independent emulation jobs on a pool of threads. A frame here is
+	// Gpu::FrameCycles M-cycles whether or not the LCD is on.
+	//
+	// Jobs are dealt to the workers in contiguous runs and each worker keeps
+	// a booted Core for the ROM it last ran, so a job only costs a fork of
+	// that Core. A worker that runs out of jobs steals from the back of the
+	// next worker's queue, then the one after, so neighbours share load
+	// first. With pinning each worker stays on one CPU, and because the
+	// worker allocates its own Cores those land on that CPU's NUMA node.
+	class GAMEBOY_API BatchRunner {
+	public:
+		// Called on the worker that ran the job, before its Core is freed
+		typedef std::function<void(size_t index, const Core &core, const BatchResult &result)> JobCallback;
+		// Called with jobs done so far, never by two threads at once
+		typedef std::function<void(size_t done, size_t total)> ProgressCallback;
+
+		explicit BatchRunner(unsigned int threads = 0, bool pin = false);
+		virtual ~BatchRunner();
+
+		void setJobCallback(JobCallback callback);
+		void setProgressCallback(ProgressCallback callback);
+		void run(const std::vector<BatchJob> &jobs, std::vector<BatchResult> &results);
+		unsigned int getThreadCount() const;
+		uint64_t getSteals() const;
+
+	private:
+		struct Queue {
+			std::mutex mutex;
+			std::deque<size_t> jobs;
+		};
+
+		struct Worker {
+			Core *base; // Booted on base ROM, forked for every job on it
+			std::shared_ptr<const Rom> baseRom;
+		};
+
+		BatchRunner(const BatchRunner &);
+		BatchRunner &operator=(const BatchRunner &);
+
+		void work(unsigned int index);
+		bool take(unsigned int index, size_t &job);
+		void runJob(Worker &worker, size_t index);
+
+		unsigned int threads;
+		bool pin;
+		JobCallback jobCallback;
+		ProgressCallback progressCallback;
+		const std::vector<BatchJob> *jobs;
+		std::vector<BatchResult> *results;
+		std::vector<std::unique_ptr<Queue>> queues;
+		size_t done; // Guarded by progressMutex
+		std::atomic<uint64_t> steals;
+		std::mutex progressMutex;
+	};
+}
\ No newline at end of file
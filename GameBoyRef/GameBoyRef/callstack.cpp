@@ -0,0 +1,131 @@
+#include "callstack.h"
+
+#include <map>
+#include <string>
+#include "core.h"
+#include "cpuregisters.h"
+#include "sampler.h"
+#include "symbols.h"
+
+namespace gameboy {
+	CallStack::CallStack() {
+		clear();
+	}
+
+	CallStack::~CallStack() {
+	}
+
+	// Drops the shadow frames and treats the current PC as the outermost
+	// routine, used when tracking starts or the core jumps to another state
+	void CallStack::restart(const Core &core) {
+		frames.clear();
+		current = 0;
+		if (nodes[0].cycles == 0) {
+			nodes[0].location = location(core, core.registers->pc);
+		}
+	}
+
+	void CallStack::clear() {
+		nodes.clear();
+		frames.clear();
+		children.clear();
+		nodes.push_back(Node{ 0, 0, 0 });
+		current = 0;
+	}
+
+	// Called after every instruction. The instruction's cycles go to the path
+	// it ran in: a CALL's to the caller, a RET's to the routine returning.
+	void CallStack::step(const Core &core, uint8_t opCode, bool taken, uint8_t cycles) {
+		nodes[current].cycles += cycles;
+
+		switch (opCode) {
+		case 0xC4: case 0xCC: case 0xD4: case 0xDC:
+			if (!taken) {
+				break;
+			}
+			// Fall through
+		case 0xCD:
+		case 0xC7: case 0xCF: case 0xD7: case 0xDF:
+		case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+			call(core);
+			break;
+		case 0xC0: case 0xC8: case 0xD0: case 0xD8:
+			if (!taken) {
+				break;
+			}
+			// Fall through
+		case 0xC9:
+		case 0xD9:
+			ret(core);
+			break;
+		}
+
+		// SP moved past a frame's return slot without a RET, e.g. POP HL then JP (HL)
+		uint16_t sp = core.registers->getSP();
+		if (!frames.empty() && sp > frames.back().slot) {
+			unwind(sp - 1);
+		}
+	}
+
+	// After a call or interrupt has pushed its return address and jumped
+	void CallStack::call(const Core &core) {
+		uint16_t slot = core.registers->getSP();
+		unwind(slot);
+
+		uint32_t target = location(core, core.registers->pc);
+		uint64_t key = ((uint64_t)current << 32) | target;
+		auto found = children.find(key);
+		unsigned int node;
+		if (found != children.end()) {
+			node = found->second;
+		}
+		else {
+			node = nodes.size();
+			nodes.push_back(Node{ target, current, 0 });
+			children.emplace(key, node);
+		}
+
+		frames.push_back(Frame{ node, slot });
+		current = node;
+	}
+
+	// After a return has popped its address, the slot it came from is SP - 2
+	void CallStack::ret(const Core &core) {
+		unwind(core.registers->getSP() - 2);
+	}
+
+	unsigned int CallStack::getDepth() const {
+		return frames.size();
+	}
+
+	// One line per distinct call path, "outer;inner cycles"
+	void CallStack::writeFolded(std::ostream &out, const SymbolTable &symbols) const {
+		std::vector<std::string> names(nodes.size());
+		std::map<std::string, uint64_t> folded;
+		for (unsigned int i = 0; i < nodes.size(); i++) {
+			const Node &node = nodes[i];
+			std::string name = symbols.resolve(node.location >> 16, node.location & 0xFFFF);
+			names[i] = i == 0 ? name : names[node.parent] + ";" + name; // Parents always come first
+			if (node.cycles > 0) {
+				folded[names[i]] += node.cycles;
+			}
+		}
+
+		for (auto it = folded.begin(); it != folded.end(); ++it) {
+			out << it->first << " " << it->second << "\n";
+		}
+	}
+
+	// Pops every frame whose return slot is at or below slot, those have been
+	// returned through or overwritten
+	void CallStack::unwind(uint16_t slot) {
+		while (!frames.empty() && frames.back().slot <= slot) {
+			frames.pop_back();
+		}
+		current = frames.empty() ? 0 : frames.back().node;
+	}
+
+	uint32_t CallStack::location(const Core &core, uint16_t address) {
+		return (Sampler::getBank(core, address) << 16) | address;
+	}
+}
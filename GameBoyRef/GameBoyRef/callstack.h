@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cinttypes>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+#include "core.h"
+
+namespace gameboy {
+	class SymbolTable;
+
+	// Shadow of the guest call stack that charges every instruction's cycles
+	// to the current call path, exported as folded stacks for flame graphs.
+	//
+	// Frames remember the stack slot their return address was pushed to, so
+	// the tracker follows SP rather than trusting calls and returns to pair
+	// up. A return unwinds every frame at or below its slot, and once SP moves
+	// above a frame's slot (a return address popped by hand) the frame is
+	// gone too. Jumps, including JP (HL) jump tables, don't change the path.
+	class GAMEBOY_API CallStack {
+	public:
+		explicit CallStack();
+		virtual ~CallStack();
+
+		void restart(const Core &core);
+		void clear();
+		void step(const Core &core, uint8_t opCode, bool taken, uint8_t cycles);
+		void call(const Core &core);
+		void ret(const Core &core);
+		unsigned int getDepth() const;
+		void writeFolded(std::ostream &out, const SymbolTable &symbols) const;
+
+	private:
+		struct Node {
+			uint32_t location; // Bank << 16 | address of the routine entered
+			unsigned int parent;
+			uint64_t cycles;
+		};
+
+		struct Frame {
+			unsigned int node;
+			uint16_t slot;
+		};
+
+		void unwind(uint16_t slot);
+		static uint32_t location(const Core &core, uint16_t address);
+
+		std::vector<Node> nodes;
+		std::vector<Frame> frames;
+		std::unordered_map<uint64_t, unsigned int> children; // Parent << 32 | location to node
+		unsigned int current;
+	};
+}
\ No newline at end of file
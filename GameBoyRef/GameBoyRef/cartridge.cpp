@@ -0,0 +1,259 @@
+#include "cartridge.h"
+
+#include <cstring>
+#include "mbc1cartridge.h"
+#include "mbc3cartridge.h"
+#include "mbc5cartridge.h"
+#include "memory.h"
+#include "rom.h"
+#include "savefile.h"
+#include "savestate.h"
+
+namespace gameboy {
+	static const uint16_t TypeAddress = 0x0147;
+	static const uint16_t RamSizeAddress = 0x0149;
+
+	static unsigned int headerRamSize(const Rom &rom) {
+		switch (rom.getBank(0)[RamSizeAddress]) {
+		case 0x01: return 0x800;
+		case 0x02: return 0x2000;
+		case 0x03: return 0x8000;
+		case 0x04: return 0x20000;
+		case 0x05: return 0x10000;
+		default: return 0;
+		}
+	}
+
+	// Picks the controller from the header, returns null for unsupported types
+	Cartridge *Cartridge::create(std::shared_ptr<const Rom> rom) {
+		unsigned int ramSize = headerRamSize(*rom);
+		static_assert(0x20000 <= SaveStateCartridgeRamSize, "Save states must hold the largest cartridge RAM");
+		uint8_t type = rom->getBank(0)[TypeAddress];
+
+		Cartridge *cartridge = nullptr;
+		switch (type) {
+		case 0x00:
+		case 0x08:
+		case 0x09:
+			cartridge = new Cartridge(rom, ramSize);
+			break;
+		case 0x01:
+		case 0x02:
+		case 0x03:
+			cartridge = new Mbc1Cartridge(rom, ramSize);
+			break;
+		case 0x0F:
+		case 0x10:
+			cartridge = new Mbc3Cartridge(rom, ramSize, true);
+			break;
+		case 0x11:
+		case 0x12:
+		case 0x13:
+			cartridge = new Mbc3Cartridge(rom, ramSize, false);
+			break;
+		case 0x19:
+		case 0x1A:
+		case 0x1B:
+		case 0x1C:
+		case 0x1D:
+		case 0x1E:
+			cartridge = new Mbc5Cartridge(rom, ramSize);
+			break;
+		default:
+			return nullptr;
+		}
+
+		switch (type) {
+		case 0x03:
+		case 0x09:
+		case 0x0F:
+		case 0x10:
+		case 0x13:
+		case 0x1B:
+		case 0x1E:
+			cartridge->battery = true;
+			break;
+		}
+		return cartridge;
+	}
+
+	Cartridge::Cartridge(std::shared_ptr<const Rom> rom, unsigned int ramSize) :
+		rom(rom),
+		memory(nullptr),
+		clock(nullptr),
+		saveFile(nullptr),
+		battery(false),
+		ramSize(ramSize) {
+		// Small RAM chips still get a whole bank so the page table can map it directly
+		ramBanks = (ramSize + RamBankSize - 1) / RamBankSize;
+		ram = ramBanks > 0 ? new uint8_t[ramBanks * RamBankSize] : nullptr;
+		if (ram != nullptr) {
+			memset(ram, 0, ramBanks * RamBankSize);
+		}
+
+		ramEnabled = ramBanks > 0; // No controller, RAM is always on
+		romBank = 1;
+		ramBank = 0;
+	}
+
+	Cartridge::Cartridge(const Cartridge &other) :
+		rom(other.rom),
+		memory(nullptr),
+		clock(nullptr),
+		saveFile(nullptr),
+		battery(other.battery),
+		ramSize(other.ramSize),
+		ramBanks(other.ramBanks),
+		ramEnabled(other.ramEnabled),
+		romBank(other.romBank),
+		ramBank(other.ramBank) {
+		ram = ramBanks > 0 ? new uint8_t[ramBanks * RamBankSize] : nullptr;
+		if (ram != nullptr) {
+			memcpy(ram, other.ram, ramBanks * RamBankSize);
+		}
+	}
+
+	Cartridge::~Cartridge() {
+		if (saveFile != nullptr) {
+			delete saveFile;
+		}
+		else {
+			delete[] ram;
+		}
+	}
+
+	Cartridge *Cartridge::clone() const {
+		return new Cartridge(*this);
+	}
+
+	void Cartridge::attach(Memory *memory, const uint64_t *clock) {
+		this->memory = memory;
+		this->clock = clock;
+		map();
+	}
+
+	void Cartridge::write(uint16_t /*address*/, uint8_t /*value*/) {
+	}
+
+	void Cartridge::writeRam(uint16_t address, uint8_t value) {
+		if (ramEnabled && ramBanks > 0) {
+			ram[(ramBank % ramBanks) * RamBankSize + (address - 0xA000)] = value;
+			if (saveFile != nullptr) {
+				saveFile->markDirty();
+			}
+		}
+	}
+
+	void Cartridge::saveState(SaveState &state) const {
+		CartridgeState &cartridge = state.cartridge;
+		memset(&cartridge, 0, sizeof(cartridge));
+		cartridge.romBank = romBank;
+		cartridge.ramBank = ramBank;
+		cartridge.ramEnabled = ramEnabled ? 1 : 0;
+
+		unsigned int saved = ramBanks * RamBankSize;
+		memcpy(state.cartridgeRam, ram, saved);
+		memset(&state.cartridgeRam[saved], 0, SaveStateCartridgeRamSize - saved);
+	}
+
+	void Cartridge::loadState(const SaveState &state) {
+		const CartridgeState &cartridge = state.cartridge;
+		romBank = cartridge.romBank;
+		ramBank = cartridge.ramBank;
+		ramEnabled = cartridge.ramEnabled != 0;
+
+		memcpy(ram, state.cartridgeRam, ramBanks * RamBankSize);
+		if (saveFile != nullptr) {
+			saveFile->markDirty();
+		}
+
+		if (memory != nullptr) {
+			map();
+		}
+	}
+
+	// Backs cartridge RAM with a .sav file, loading whatever the file already
+	// holds. Games write straight into the mapping, the file is synced in the
+	// background when RAM is disabled and periodically. Clones get a private copy.
+	bool Cartridge::openSave(const std::string &path) {
+		if (!battery || ramBanks == 0 || saveFile != nullptr) {
+			return false;
+		}
+
+		SaveFile *file = SaveFile::open(path, ramBanks * RamBankSize);
+		if (file == nullptr) {
+			return false;
+		}
+
+		delete[] ram;
+		saveFile = file;
+		ram = file->getData();
+
+		if (memory != nullptr) {
+			map();
+		}
+		return true;
+	}
+
+	// Syncs and detaches the .sav file, RAM contents carry over to a heap buffer
+	void Cartridge::closeSave() {
+		if (saveFile == nullptr) {
+			return;
+		}
+
+		uint8_t *copy = new uint8_t[ramBanks * RamBankSize];
+		memcpy(copy, ram, ramBanks * RamBankSize);
+		ram = copy;
+		delete saveFile;
+		saveFile = nullptr;
+
+		if (memory != nullptr) {
+			map();
+		}
+	}
+
+	std::shared_ptr<const Rom> Cartridge::getRom() const {
+		return rom;
+	}
+
+	uint8_t *Cartridge::getRam() {
+		return ram;
+	}
+
+	unsigned int Cartridge::getRamSize() const {
+		return ramSize;
+	}
+
+	// Bank mapped at 0x4000-0x7FFF
+	unsigned int Cartridge::getRomBank() const {
+		return romBank % rom->getBankCount();
+	}
+
+	bool Cartridge::hasBattery() const {
+		return battery;
+	}
+
+	void Cartridge::map() {
+		memory->mapRomBank(0x0000, 0);
+		memory->mapRomBank(0x4000, romBank);
+		mapRam(ramBank);
+	}
+
+	// Points 0xA000-0xBFFF at a RAM bank, or at open bus while RAM is disabled
+	void Cartridge::mapRam(unsigned int bank) {
+		if (ramEnabled && ramBanks > 0) {
+			memory->mapExternal(0xA000, &ram[(bank % ramBanks) * RamBankSize], RamBankSize);
+		}
+		else {
+			memory->mapExternal(0xA000, nullptr, RamBankSize);
+		}
+	}
+
+	// Games disable RAM once they're done saving, a good point to sync the file
+	void Cartridge::enableRam(bool enabled) {
+		if (ramEnabled && !enabled && saveFile != nullptr) {
+			saveFile->flush();
+		}
+		ramEnabled = enabled;
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cinttypes>
+#include <memory>
+#include <string>
+#include "core.h"
+
+namespace gameboy {
+	class Memory;
+	class Rom;
+	class SaveFile;
+	struct SaveState;
+
+	// Cartridge without a memory bank controller, also the base for the MBCs.
+	// Bank switches never touch the read path, they repoint Memory's page table
+	// at the selected ROM or RAM bank so banked reads cost the same as fixed ones.
+	class GAMEBOY_API Cartridge {
+	public:
+		static const unsigned int RamBankSize = 0x2000;
+
+		static Cartridge *create(std::shared_ptr<const Rom> rom);
+		explicit Cartridge(std::shared_ptr<const Rom> rom, unsigned int ramSize);
+		virtual ~Cartridge();
+
+		virtual Cartridge *clone() const;
+		void attach(Memory *memory, const uint64_t *clock);
+		virtual void write(uint16_t address, uint8_t value);
+		virtual void writeRam(uint16_t address, uint8_t value);
+		virtual void saveState(SaveState &state) const;
+		virtual void loadState(const SaveState &state);
+		bool openSave(const std::string &path);
+		void closeSave();
+
+		std::shared_ptr<const Rom> getRom() const;
+		uint8_t *getRam();
+		unsigned int getRamSize() const;
+		unsigned int getRomBank() const;
+		bool hasBattery() const;
+
+	protected:
+		Cartridge(const Cartridge &other);
+		virtual void map();
+		void mapRam(unsigned int bank);
+		void enableRam(bool enabled);
+
+		std::shared_ptr<const Rom> rom;
+		Memory *memory;
+		const uint64_t *clock;
+		uint8_t *ram;
+		SaveFile *saveFile;
+		bool battery;
+		unsigned int ramSize;
+		unsigned int ramBanks;
+		bool ramEnabled;
+		unsigned int romBank;
+		unsigned int ramBank;
+
+	private:
+		Cartridge &operator=(const Cartridge &other);
+	};
+}
\ No newline at end of file
@@ -1,33 +1,84 @@
 #include "core.h"
 
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
+#include <limits>
+#include "callstack.h"
+#include "cartridge.h"
 #include "cpuregisters.h"
+#include "gpu.h"
+#include "joypad.h"
 #include "memory.h"
+#include "profile.h"
+#include "rom.h"
+#include "sampler.h"
+#include "savestate.h"
+#include "serial.h"
+#include "timer.h"
 
 namespace gameboy {
 	Core::Core() :
 		registers(new CPURegisters),
-		memory(new Memory()) {
+		memory(new Memory()),
+		cartridge(nullptr),
+		gpu(nullptr),
+		joypad(nullptr),
+		serial(nullptr),
+		timer(nullptr) {
 		conditional = false;
+		halted = false;
 		clock = 0;
+		fetched = 0;
+		sampler = nullptr;
+		nextSample = std::numeric_limits<uint64_t>::max();
+		callStack = nullptr;
 	}
 
+	Core::Core(Memory *memory) :
+		registers(new CPURegisters),
+		memory(memory),
+		cartridge(nullptr),
+		gpu(nullptr),
+		joypad(nullptr),
+		serial(nullptr),
+		timer(nullptr) {
+		conditional = false;
+		halted = false;
+		clock = 0;
+		fetched = 0;
+		sampler = nullptr;
+		nextSample = std::numeric_limits<uint64_t>::max();
+		callStack = nullptr;
+	}
+
+	const Core::opCode Core::interrupts[] = {
+		&Core::INT40, &Core::INT48, &Core::INT50, &Core::INT58, &Core::INT60
+	};
+
 	Core::~Core() {
+		delete timer;
+		delete serial;
+		delete joypad;
+		delete gpu;
+		delete cartridge;
 		delete memory;
 		delete registers;
 	}
 
 	void Core::emulateCycle() {
 		uint8_t lastClocks = 0;
-		uint8_t opCode = memory->read(registers->pc++);
-		uint8_t cb = memory->read(registers->pc);
+		fetched = memory->fetch(registers->pc++);
+		uint8_t opCode = fetched & 0xFF;
+		uint8_t cb = (fetched >> 8) & 0xFF;
 
 		(this->*opCodes[opCode])();
 
+		bool taken = conditional;
 		if (opCode == 0xCB) {
 			lastClocks = opCodeCBCycles[cb];
 		}
-		else if (conditional) {
+		else if (taken) {
 			conditional = false;
 			lastClocks = opCodeCondCycles[opCode];
 		}
@@ -36,10 +87,234 @@ namespace gameboy {
 		}
 
 		clock += lastClocks;
+#ifdef GAMEBOY_PROFILE
+		OpcodeProfile::local().record(opCode, cb, lastClocks, taken);
+#endif
+		if (callStack != nullptr) {
+			callStack->step(*this, opCode, taken, lastClocks);
+		}
+		if (clock >= memory->nextEvent) {
+			memory->update(clock);
+			if (cartridge != nullptr) {
+				dispatchInterrupt();
+			}
+		}
+		if (clock >= nextSample) {
+			sampler->sample(*this);
+			nextSample = clock + sampler->getInterval();
+		}
+	}
+
+	// Runs instructions until clock reaches end. In hardware mode a HALT with
+	// nothing pending jumps straight to the next bus event, the sample or end
+	// rather than stepping one cycle at a time, so a halted guest costs one
+	// step per event. Tracing a call stack turns the jump off.
+	void Core::runUntil(uint64_t end) {
+		while (clock < end) {
+			emulateCycle();
+
+			if (!halted || cartridge == nullptr || callStack != nullptr) {
+				continue;
+			}
+			if (memory->getPendingInterrupts() != 0) {
+				continue;
+			}
+
+			uint64_t wake = std::min(std::min(memory->nextEvent, nextSample), end);
+			if (wake > clock + 1) {
+				clock = wake - 1; // The next HALT step lands on wake
+			}
+		}
 	}
 
 	void Core::handleCB() {
-		(this->*opCodesCB[memory->read(registers->pc++)])();
+		(this->*opCodesCB[nextOperand()])();
+	}
+
+	// Only runs in hardware mode, after a bus event. Anything that can make an
+	// interrupt due (a device request, writing IF or IE, EI, RETI) schedules
+	// one, so the check costs nothing between events. A pending interrupt
+	// wakes HALT even with IME clear.
+	void Core::dispatchInterrupt() {
+		uint8_t pending = memory->getPendingInterrupts();
+		if (pending == 0) {
+			return;
+		}
+
+		if (halted) {
+			halted = false;
+			++registers->pc;
+		}
+		if (!registers->getIME()) {
+			return;
+		}
+
+		unsigned int index = 0;
+		while ((pending & (0x1 << index)) == 0) {
+			++index;
+		}
+
+		memory->acknowledgeInterrupt(0x1 << index);
+		(this->*interrupts[index])();
+		clock += 5;
+		if (callStack != nullptr) {
+			callStack->call(*this);
+		}
+	}
+
+	void Core::saveState(SaveState &state) const {
+		state.magic = SaveStateMagic;
+		state.version = SaveStateVersion;
+		state.size = sizeof(SaveState);
+		state.clock = clock;
+		state.conditional = conditional ? 1 : 0;
+		state.halted = halted ? 1 : 0;
+		state.reserved = 0;
+		state.padding = 0;
+		registers->saveState(state);
+		memory->saveState(state);
+		memset(&state.io, 0, sizeof(state.io));
+
+		if (cartridge != nullptr) {
+			cartridge->saveState(state);
+			gpu->saveState(state);
+			joypad->saveState(state);
+			serial->saveState(state);
+			timer->saveState(state);
+		}
+		else {
+			memset(&state.cartridge, 0, sizeof(state.cartridge));
+			memset(state.cartridgeRam, 0, sizeof(state.cartridgeRam));
+		}
+	}
+
+	bool Core::loadState(const SaveState &state) {
+		if (state.magic != SaveStateMagic || state.version != SaveStateVersion || state.size != sizeof(SaveState)) {
+			return false;
+		}
+
+		clock = state.clock;
+		conditional = state.conditional != 0;
+		halted = state.halted != 0;
+		registers->loadState(state);
+		memory->loadState(state);
+
+		if (cartridge != nullptr) {
+			cartridge->loadState(state);
+			gpu->loadState(state);
+			joypad->loadState(state);
+			serial->loadState(state);
+			timer->loadState(state);
+		}
+		setSampler(sampler); // Clock moved, restart the interval
+		setCallStack(callStack);
+		return true;
+	}
+
+	// The child shares every memory page with this core until either side
+	// writes to it, so forking costs a page table copy rather than 64 KiB
+	Core *Core::fork() const {
+		Core *child = new Core(new Memory(*memory));
+		*child->registers = *registers;
+		child->conditional = conditional;
+		child->halted = halted;
+		child->clock = clock;
+
+		if (cartridge != nullptr) {
+			child->cartridge = cartridge->clone();
+			child->memory->mapCartridge(child->cartridge, &child->clock);
+			child->cartridge->attach(child->memory, &child->clock);
+			child->gpu = new Gpu(*gpu);
+			child->gpu->attach(child->memory);
+			child->joypad = new Joypad(*joypad);
+			child->joypad->attach(child->memory);
+			child->serial = new Serial(*serial);
+			child->serial->attach(child->memory);
+			child->timer = new Timer(*timer);
+			child->timer->attach(child->memory);
+		}
+		return child;
+	}
+
+	bool Core::loadCartridge(const std::string &path) {
+		auto rom = Rom::open(path);
+		return rom && loadCartridge(rom);
+	}
+
+	// Returns false if the cartridge type isn't supported
+	bool Core::loadCartridge(std::shared_ptr<const Rom> rom) {
+		Cartridge *loaded = Cartridge::create(rom);
+		if (loaded == nullptr) {
+			return false;
+		}
+
+		delete cartridge;
+		cartridge = loaded;
+		memory->mapCartridge(cartridge, &clock);
+		cartridge->attach(memory, &clock);
+
+		if (gpu == nullptr) {
+			gpu = new Gpu();
+			gpu->attach(memory);
+			joypad = new Joypad();
+			joypad->attach(memory);
+			serial = new Serial();
+			serial->attach(memory);
+			timer = new Timer();
+			timer->attach(memory);
+		}
+		return true;
+	}
+
+	// Sets the registers the way the DMG boot ROM leaves them and starts at
+	// the cartridge entry point. Call once a cartridge is loaded.
+	void Core::boot() {
+		static const struct {
+			uint16_t address;
+			uint8_t value;
+		} io[] = {
+			{ 0xFF00, 0xCF }, { 0xFF05, 0x00 }, { 0xFF06, 0x00 }, { 0xFF07, 0x00 },
+			{ 0xFF10, 0x80 }, { 0xFF11, 0xBF }, { 0xFF12, 0xF3 }, { 0xFF14, 0xBF },
+			{ 0xFF16, 0x3F }, { 0xFF17, 0x00 }, { 0xFF19, 0xBF }, { 0xFF1A, 0x7F },
+			{ 0xFF1B, 0xFF }, { 0xFF1C, 0x9F }, { 0xFF1E, 0xBF }, { 0xFF20, 0xFF },
+			{ 0xFF21, 0x00 }, { 0xFF22, 0x00 }, { 0xFF23, 0xBF }, { 0xFF24, 0x77 },
+			{ 0xFF25, 0xF3 }, { 0xFF26, 0xF1 }, { 0xFF40, 0x91 }, { 0xFF42, 0x00 },
+			{ 0xFF43, 0x00 }, { 0xFF45, 0x00 }, { 0xFF47, 0xFC }, { 0xFF48, 0xFF },
+			{ 0xFF49, 0xFF }, { 0xFF4A, 0x00 }, { 0xFF4B, 0x00 }, { 0xFF0F, 0xE1 },
+			{ 0xFFFF, 0x00 }
+		};
+
+		registers->setAF(0x01B0);
+		registers->setBC(0x0013);
+		registers->setDE(0x00D8);
+		registers->setHL(0x014D);
+		registers->setSP(0xFFFE);
+		registers->setIME(false);
+		registers->pc = 0x0100;
+		for (unsigned int i = 0; i < sizeof(io) / sizeof(io[0]); i++) {
+			memory->write(io[i].address, io[i].value);
+		}
+	}
+
+	// Samples the guest PC every sampler->getInterval() M-cycles, null stops
+	// sampling. The sampler isn't owned and forked cores don't inherit it.
+	void Core::setSampler(Sampler *sampler) {
+		this->sampler = sampler;
+		nextSample = sampler != nullptr ? clock + sampler->getInterval() : std::numeric_limits<uint64_t>::max();
+	}
+
+	// Tracks guest calls from the current PC on, null stops tracking. Not
+	// owned and not inherited by forks.
+	void Core::setCallStack(CallStack *callStack) {
+		this->callStack = callStack;
+		if (callStack != nullptr) {
+			callStack->restart(*this);
+		}
+	}
+
+	// M-cycles executed so far
+	uint64_t Core::getClock() const {
+		return clock;
 	}
 
 	void Core::xx() {
@@ -1,6 +1,8 @@
 #pragma once
 
-#ifdef GAMEBOYREF_EXPORTS
+#if !defined(_WIN32)
+#define GAMEBOY_API
+#elif defined(GAMEBOYREF_EXPORTS)
 #define GAMEBOY_API __declspec(dllexport) 
 #else
 #define GAMEBOY_API __declspec(dllimport) 
@@ -8,10 +10,21 @@
 
 #include <cstdlib>
 #include <cinttypes>
+#include <memory>
+#include <string>
 
 namespace gameboy {
 	class CPURegisters;
 	class Memory;
+	class Cartridge;
+	class Gpu;
+	class Joypad;
+	class Serial;
+	class Timer;
+	class CallStack;
+	class Rom;
+	class Sampler;
+	struct SaveState;
 }
 
 namespace gameboy {
@@ -20,19 +33,51 @@ namespace gameboy {
 		explicit Core();
 		virtual ~Core();
 		void emulateCycle();
+		void runUntil(uint64_t end);
 		void handleCB();
 		void xx();
 		void CBxx();
+		void saveState(SaveState &state) const;
+		bool loadState(const SaveState &state);
+		Core *fork() const;
+		bool loadCartridge(const std::string &path);
+		bool loadCartridge(std::shared_ptr<const Rom> rom);
+		void boot();
+		void setSampler(Sampler *sampler);
+		void setCallStack(CallStack *callStack);
+		uint64_t getClock() const;
 		CPURegisters *registers;
 		Memory *memory;
+		Cartridge *cartridge;
+		Gpu *gpu;
+		Joypad *joypad;
+		Serial *serial;
+		Timer *timer;
 
 	private:
+		friend class Lockstep; // Reads the cycle tables
+
+		explicit Core(Memory *memory);
+
+		void dispatchInterrupt();
+
+		uint8_t operand() const;
+		uint8_t nextOperand();
+		uint16_t operandW() const;
+		uint16_t callTarget();
+
 		bool conditional;
-		unsigned int clock;
+		bool halted; // HALT ran and pc is held on it until an interrupt is pending
+		uint64_t clock;
+		uint32_t fetched; // Opcode and the three bytes after it, read together by emulateCycle
+		Sampler *sampler;
+		uint64_t nextSample;
+		CallStack *callStack;
 
 		typedef void (Core::*opCode) ();
 		static const opCode opCodes[];
 		static const opCode opCodesCB[];
+		static const opCode interrupts[];
 		static const uint8_t opCodeCycles[];
 		static const uint8_t opCodeCondCycles[];
 		static const uint8_t opCodeCBCycles[];
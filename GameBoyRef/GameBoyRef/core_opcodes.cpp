@@ -4,15 +4,34 @@
 #include "memory.h"
 
 namespace gameboy {
+	//----------OPERANDS----------//
+	//Immediates come from the bytes emulateCycle already fetched, registers->pc points just past the opcode
+	uint8_t Core::operand() const { return (fetched >> 8) & 0xFF; }
+	uint8_t Core::nextOperand() { ++registers->pc; return (fetched >> 8) & 0xFF; }
+
+	uint16_t Core::operandW() const {
+		uint8_t first = (fetched >> 8) & 0xFF;
+		uint8_t second = (fetched >> 16) & 0xFF;
+		return memory->isLittleEndian() ? (second << 8) | first : (first << 8) | second;
+	}
+
+	//CALL pushes before it reads its target, a push over the operand bytes changes the target
+	uint16_t Core::callTarget() {
+		if ((uint16_t)(registers->pc - registers->getSP() + 1) <= 2) {
+			return memory->readW(registers->pc);
+		}
+		return operandW();
+	}
+
 	//----------8-BIT LOADS----------//
 	//register = n
-	void Core::LDrnA() { registers->setA(memory->read(registers->pc++)); }
-	void Core::LDrnB() { registers->setB(memory->read(registers->pc++)); }
-	void Core::LDrnC() { registers->setC(memory->read(registers->pc++)); }
-	void Core::LDrnD() { registers->setD(memory->read(registers->pc++)); }
-	void Core::LDrnE() { registers->setE(memory->read(registers->pc++)); }
-	void Core::LDrnH() { registers->setH(memory->read(registers->pc++)); }
-	void Core::LDrnL() { registers->setL(memory->read(registers->pc++)); }
+	void Core::LDrnA() { registers->setA(nextOperand()); }
+	void Core::LDrnB() { registers->setB(nextOperand()); }
+	void Core::LDrnC() { registers->setC(nextOperand()); }
+	void Core::LDrnD() { registers->setD(nextOperand()); }
+	void Core::LDrnE() { registers->setE(nextOperand()); }
+	void Core::LDrnH() { registers->setH(nextOperand()); }
+	void Core::LDrnL() { registers->setL(nextOperand()); }
 
 	//register = register
 	//A
@@ -84,7 +103,7 @@ namespace gameboy {
 	//A = (RR)
 	void Core::LDABCM() { registers->setA(memory->read(registers->getBC())); }
 	void Core::LDADEM() { registers->setA(memory->read(registers->getDE())); }
-	void Core::LDAmm() { registers->setA(memory->read(memory->readW(registers->pc))); registers->pc += 2; }
+	void Core::LDAmm() { registers->setA(memory->read(operandW())); registers->pc += 2; }
 
 	//(HL) = register
 	void Core::LDHLMrA() { memory->write(registers->getHL(), registers->getA()); }
@@ -95,13 +114,13 @@ namespace gameboy {
 	void Core::LDHLMrH() { memory->write(registers->getHL(), registers->getH()); }
 	void Core::LDHLMrL() { memory->write(registers->getHL(), registers->getL()); }
 
-	void Core::LDHLmn() { memory->write(registers->getHL(), memory->read(registers->pc)); ++registers->pc; }
+	void Core::LDHLmn() { memory->write(registers->getHL(), operand()); ++registers->pc; }
 
 	//(RR) = A
 	void Core::LDBCMA() { memory->write(registers->getBC(), registers->getA()); }
 	void Core::LDDEMA() { memory->write(registers->getDE(), registers->getA()); }
 	//(nn) = A
-	void Core::LDnnA() { uint16_t nn = memory->readW(registers->pc); memory->write(nn, registers->getA()); registers->pc += 2; }
+	void Core::LDnnA() { uint16_t nn = operandW(); memory->write(nn, registers->getA()); registers->pc += 2; }
 
 	//(HL) = register, --HL
 	void Core::LDDHLA() { memory->write(registers->getHL(), registers->getA()); registers->setHL(registers->getHL() - 1); }
@@ -113,27 +132,27 @@ namespace gameboy {
 	void Core::LDIAHL() { registers->setA(memory->read(registers->getHL())); registers->setHL(registers->getHL() + 1); }
 
 	//(0xFF00+n) = A
-	void Core::LDIOnA() { uint8_t n = memory->read(registers->pc++); memory->write(0xFF00 + n, registers->getA()); }
+	void Core::LDIOnA() { uint8_t n = nextOperand(); memory->write(0xFF00 + n, registers->getA()); }
 	//A = (0xFF00+n)
-	void Core::LDAIOn() { uint8_t n = memory->read(registers->pc++); registers->setA(memory->read(0xFF00 + n)); }
+	void Core::LDAIOn() { uint8_t n = nextOperand(); registers->setA(memory->read(0xFF00 + n)); }
 	//(0xFF00+C) = A
 	void Core::LDIOCA() { memory->write(0xFF00 + registers->getC(), registers->getA()); }
 	//A = (0xFF00+C)
 	void Core::LDAIOC() { registers->setA(memory->read(0xFF00 + registers->getC())); }
 
 	//----------16-BIT LOADS----------//
-	void Core::LDBCnn() { registers->setBC(memory->readW(registers->pc)); registers->pc += 2; }
-	void Core::LDDEnn() { registers->setDE(memory->readW(registers->pc)); registers->pc += 2; }
-	void Core::LDHLnn() { registers->setHL(memory->readW(registers->pc)); registers->pc += 2; }
-	void Core::LDSPnn() { registers->setSP(memory->readW(registers->pc)); registers->pc += 2; }
+	void Core::LDBCnn() { registers->setBC(operandW()); registers->pc += 2; }
+	void Core::LDDEnn() { registers->setDE(operandW()); registers->pc += 2; }
+	void Core::LDHLnn() { registers->setHL(operandW()); registers->pc += 2; }
+	void Core::LDSPnn() { registers->setSP(operandW()); registers->pc += 2; }
 
 	//(nn) = SP
-	void Core::LDnnSP() { memory->writeW(memory->readW(registers->pc), registers->getSP()); registers->pc += 2; }
+	void Core::LDnnSP() { memory->writeW(operandW(), registers->getSP()); registers->pc += 2; }
 
 	//HL = SP+n
 	void Core::LDHLSPn()
 	{
-		int8_t n = memory->read(registers->pc++);
+		int8_t n = nextOperand();
 		uint16_t sp = registers->getSP();
 		uint16_t res = sp + n;
 		registers->setHL(res);
@@ -155,7 +174,7 @@ namespace gameboy {
 	void Core::ADDrH() { uint8_t n = registers->getH(); uint8_t a = registers->getA(); registers->setA(a + n); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag((((a & 0xF) + (n & 0xF)) & 0x10) != 0); registers->setCarryFlag((a + n) > 255); }
 	void Core::ADDrL() { uint8_t n = registers->getL(); uint8_t a = registers->getA(); registers->setA(a + n); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag((((a & 0xF) + (n & 0xF)) & 0x10) != 0); registers->setCarryFlag((a + n) > 255); }
 	void Core::ADDHLM() { uint8_t n = memory->read(registers->getHL()); uint8_t a = registers->getA(); registers->setA(a + n); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag((((a & 0xF) + (n & 0xF)) & 0x10) != 0); registers->setCarryFlag((a + n) > 255); }
-	void Core::ADDn() { uint8_t n = memory->read(registers->pc); ++registers->pc; uint8_t a = registers->getA(); registers->setA(a + n); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag((((a & 0xF) + (n & 0xF)) & 0x10) != 0); registers->setCarryFlag((a + n) > 255); }
+	void Core::ADDn() { uint8_t n = operand(); ++registers->pc; uint8_t a = registers->getA(); registers->setA(a + n); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag((((a & 0xF) + (n & 0xF)) & 0x10) != 0); registers->setCarryFlag((a + n) > 255); }
 
 	void Core::ADCrA() { uint8_t n = registers->getA(); int carry = registers->getCarryFlag() ? 1 : 0; int res = registers->getA() + n + carry; registers->setZeroFlag(((uint8_t)res) == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(((registers->getA() & 0x0F) + (n & 0x0F) + carry) > 0x0F); registers->setCarryFlag(res > 0xFF); registers->setA(res); }
 	void Core::ADCrB() { uint8_t n = registers->getB(); int carry = registers->getCarryFlag() ? 1 : 0; int res = registers->getA() + n + carry; registers->setZeroFlag(((uint8_t)res) == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(((registers->getA() & 0x0F) + (n & 0x0F) + carry) > 0x0F); registers->setCarryFlag(res > 0xFF); registers->setA(res); }
@@ -165,7 +184,7 @@ namespace gameboy {
 	void Core::ADCrH() { uint8_t n = registers->getH(); int carry = registers->getCarryFlag() ? 1 : 0; int res = registers->getA() + n + carry; registers->setZeroFlag(((uint8_t)res) == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(((registers->getA() & 0x0F) + (n & 0x0F) + carry) > 0x0F); registers->setCarryFlag(res > 0xFF); registers->setA(res); }
 	void Core::ADCrL() { uint8_t n = registers->getL(); int carry = registers->getCarryFlag() ? 1 : 0; int res = registers->getA() + n + carry; registers->setZeroFlag(((uint8_t)res) == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(((registers->getA() & 0x0F) + (n & 0x0F) + carry) > 0x0F); registers->setCarryFlag(res > 0xFF); registers->setA(res); }
 	void Core::ADCHLM() { uint8_t n = memory->read(registers->getHL()); int carry = registers->getCarryFlag() ? 1 : 0; int res = registers->getA() + n + carry; registers->setZeroFlag(((uint8_t)res) == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(((registers->getA() & 0x0F) + (n & 0x0F) + carry) > 0x0F); registers->setCarryFlag(res > 0xFF); registers->setA(res); }
-	void Core::ADCn() { uint8_t n = memory->read(registers->pc++); int carry = registers->getCarryFlag() ? 1 : 0; int res = registers->getA() + n + carry; registers->setZeroFlag(((uint8_t)res) == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(((registers->getA() & 0x0F) + (n & 0x0F) + carry) > 0x0F); registers->setCarryFlag(res > 0xFF); registers->setA(res); }
+	void Core::ADCn() { uint8_t n = nextOperand(); int carry = registers->getCarryFlag() ? 1 : 0; int res = registers->getA() + n + carry; registers->setZeroFlag(((uint8_t)res) == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(((registers->getA() & 0x0F) + (n & 0x0F) + carry) > 0x0F); registers->setCarryFlag(res > 0xFF); registers->setA(res); }
 
 	void Core::SUBrA() { uint8_t n = registers->getA(); uint8_t a = registers->getA(); registers->setA(a - n); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(true); registers->setHalfCarryFlag((registers->getA() ^ n^a) & 0x10); registers->setCarryFlag((a - n) < 0); }
 	void Core::SUBrB() { uint8_t n = registers->getB(); uint8_t a = registers->getA(); registers->setA(a - n); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(true); registers->setHalfCarryFlag((registers->getA() ^ n^a) & 0x10); registers->setCarryFlag((a - n) < 0); }
@@ -175,7 +194,7 @@ namespace gameboy {
 	void Core::SUBrH() { uint8_t n = registers->getH(); uint8_t a = registers->getA(); registers->setA(a - n); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(true); registers->setHalfCarryFlag((registers->getA() ^ n^a) & 0x10); registers->setCarryFlag((a - n) < 0); }
 	void Core::SUBrL() { uint8_t n = registers->getL(); uint8_t a = registers->getA(); registers->setA(a - n); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(true); registers->setHalfCarryFlag((registers->getA() ^ n^a) & 0x10); registers->setCarryFlag((a - n) < 0); }
 	void Core::SUBHLM() { uint8_t n = memory->read(registers->getHL()); uint8_t a = registers->getA(); registers->setA(a - n); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(true); registers->setHalfCarryFlag((registers->getA() ^ n^a) & 0x10); registers->setCarryFlag((a - n) < 0); }
-	void Core::SUBn() { uint8_t n = memory->read(registers->pc++); uint8_t a = registers->getA(); registers->setA(a - n); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(true); registers->setHalfCarryFlag((registers->getA() ^ n^a) & 0x10); registers->setCarryFlag((a - n) < 0); }
+	void Core::SUBn() { uint8_t n = nextOperand(); uint8_t a = registers->getA(); registers->setA(a - n); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(true); registers->setHalfCarryFlag((registers->getA() ^ n^a) & 0x10); registers->setCarryFlag((a - n) < 0); }
 
 	void Core::SBCrA() { uint8_t n = registers->getA(); int carry = registers->getCarryFlag() ? 1 : 0; int res = registers->getA() - n - carry; registers->setZeroFlag(((uint8_t)res) == 0); registers->setSubFlag(true); registers->setHalfCarryFlag(((registers->getA() & 0x0F) - (n & 0x0F) - carry) < 0x0); registers->setCarryFlag(res < 0x0); registers->setA(res); }
 	void Core::SBCrB() { uint8_t n = registers->getB(); int carry = registers->getCarryFlag() ? 1 : 0; int res = registers->getA() - n - carry; registers->setZeroFlag(((uint8_t)res) == 0); registers->setSubFlag(true); registers->setHalfCarryFlag(((registers->getA() & 0x0F) - (n & 0x0F) - carry) < 0x0); registers->setCarryFlag(res < 0x0); registers->setA(res); }
@@ -185,7 +204,7 @@ namespace gameboy {
 	void Core::SBCrH() { uint8_t n = registers->getH(); int carry = registers->getCarryFlag() ? 1 : 0; int res = registers->getA() - n - carry; registers->setZeroFlag(((uint8_t)res) == 0); registers->setSubFlag(true); registers->setHalfCarryFlag(((registers->getA() & 0x0F) - (n & 0x0F) - carry) < 0x0); registers->setCarryFlag(res < 0x0); registers->setA(res); }
 	void Core::SBCrL() { uint8_t n = registers->getL(); int carry = registers->getCarryFlag() ? 1 : 0; int res = registers->getA() - n - carry; registers->setZeroFlag(((uint8_t)res) == 0); registers->setSubFlag(true); registers->setHalfCarryFlag(((registers->getA() & 0x0F) - (n & 0x0F) - carry) < 0x0); registers->setCarryFlag(res < 0x0); registers->setA(res); }
 	void Core::SBCHLM() { uint8_t n = memory->read(registers->getHL()); int carry = registers->getCarryFlag() ? 1 : 0; int res = registers->getA() - n - carry; registers->setZeroFlag(((uint8_t)res) == 0); registers->setSubFlag(true); registers->setHalfCarryFlag(((registers->getA() & 0x0F) - (n & 0x0F) - carry) < 0x0); registers->setCarryFlag(res < 0x0); registers->setA(res); }
-	void Core::SBCn() { uint8_t n = memory->read(registers->pc++); int carry = registers->getCarryFlag() ? 1 : 0; int res = registers->getA() - n - carry; registers->setZeroFlag(((uint8_t)res) == 0); registers->setSubFlag(true); registers->setHalfCarryFlag(((registers->getA() & 0x0F) - (n & 0x0F) - carry) < 0x0); registers->setCarryFlag(res < 0x0); registers->setA(res); }
+	void Core::SBCn() { uint8_t n = nextOperand(); int carry = registers->getCarryFlag() ? 1 : 0; int res = registers->getA() - n - carry; registers->setZeroFlag(((uint8_t)res) == 0); registers->setSubFlag(true); registers->setHalfCarryFlag(((registers->getA() & 0x0F) - (n & 0x0F) - carry) < 0x0); registers->setCarryFlag(res < 0x0); registers->setA(res); }
 
 	void Core::ANDrA() { uint8_t n = registers->getA(); registers->setA(n & registers->getA()); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(true); registers->setCarryFlag(false); }
 	void Core::ANDrB() { uint8_t n = registers->getB(); registers->setA(n & registers->getA()); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(true); registers->setCarryFlag(false); }
@@ -195,7 +214,7 @@ namespace gameboy {
 	void Core::ANDrH() { uint8_t n = registers->getH(); registers->setA(n & registers->getA()); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(true); registers->setCarryFlag(false); }
 	void Core::ANDrL() { uint8_t n = registers->getL(); registers->setA(n & registers->getA()); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(true); registers->setCarryFlag(false); }
 	void Core::ANDHLM() { uint8_t n = memory->read(registers->getHL()); registers->setA(n & registers->getA()); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(true); registers->setCarryFlag(false); }
-	void Core::ANDn() { uint8_t n = memory->read(registers->pc++); registers->setA(n & registers->getA()); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(true); registers->setCarryFlag(false); }
+	void Core::ANDn() { uint8_t n = nextOperand(); registers->setA(n & registers->getA()); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(true); registers->setCarryFlag(false); }
 
 	void Core::ORrA() { uint8_t n = registers->getA(); registers->setA(n | registers->getA()); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(false); registers->setCarryFlag(false); }
 	void Core::ORrB() { uint8_t n = registers->getB(); registers->setA(n | registers->getA()); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(false); registers->setCarryFlag(false); }
@@ -205,7 +224,7 @@ namespace gameboy {
 	void Core::ORrH() { uint8_t n = registers->getH(); registers->setA(n | registers->getA()); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(false); registers->setCarryFlag(false); }
 	void Core::ORrL() { uint8_t n = registers->getL(); registers->setA(n | registers->getA()); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(false); registers->setCarryFlag(false); }
 	void Core::ORHLM() { uint8_t n = memory->read(registers->getHL()); registers->setA(n | registers->getA()); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(false); registers->setCarryFlag(false); }
-	void Core::ORn() { uint8_t n = memory->read(registers->pc); ++registers->pc; registers->setA(n | registers->getA()); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(false); registers->setCarryFlag(false); }
+	void Core::ORn() { uint8_t n = operand(); ++registers->pc; registers->setA(n | registers->getA()); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(false); registers->setCarryFlag(false); }
 
 	void Core::XORrA() { uint8_t n = registers->getA(); registers->setA(n ^ registers->getA()); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(false); registers->setCarryFlag(false); }
 	void Core::XORrB() { uint8_t n = registers->getB(); registers->setA(n ^ registers->getA()); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(false); registers->setCarryFlag(false); }
@@ -215,7 +234,7 @@ namespace gameboy {
 	void Core::XORrH() { uint8_t n = registers->getH(); registers->setA(n ^ registers->getA()); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(false); registers->setCarryFlag(false); }
 	void Core::XORrL() { uint8_t n = registers->getL(); registers->setA(n ^ registers->getA()); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(false); registers->setCarryFlag(false); }
 	void Core::XORHLM() { uint8_t n = memory->read(registers->getHL()); registers->setA(n ^ registers->getA()); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(false); registers->setCarryFlag(false); }
-	void Core::XORn() { uint8_t n = memory->read(registers->pc); ++registers->pc; registers->setA(n ^ registers->getA()); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(false); registers->setCarryFlag(false); }
+	void Core::XORn() { uint8_t n = operand(); ++registers->pc; registers->setA(n ^ registers->getA()); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag(false); registers->setCarryFlag(false); }
 
 	void Core::CPrA() { uint8_t n = registers->getA(); uint8_t res = registers->getA() - n; registers->setZeroFlag(registers->getA() == n); registers->setSubFlag(true); registers->setHalfCarryFlag((res^n^registers->getA()) & 0x10); registers->setCarryFlag(registers->getA() < n); }
 	void Core::CPrB() { uint8_t n = registers->getB(); uint8_t res = registers->getA() - n; registers->setZeroFlag(registers->getA() == n); registers->setSubFlag(true); registers->setHalfCarryFlag((res^n^registers->getA()) & 0x10); registers->setCarryFlag(registers->getA() < n); }
@@ -225,7 +244,7 @@ namespace gameboy {
 	void Core::CPrH() { uint8_t n = registers->getH(); uint8_t res = registers->getA() - n; registers->setZeroFlag(registers->getA() == n); registers->setSubFlag(true); registers->setHalfCarryFlag((res^n^registers->getA()) & 0x10); registers->setCarryFlag(registers->getA() < n); }
 	void Core::CPrL() { uint8_t n = registers->getL(); uint8_t res = registers->getA() - n; registers->setZeroFlag(registers->getA() == n); registers->setSubFlag(true); registers->setHalfCarryFlag((res^n^registers->getA()) & 0x10); registers->setCarryFlag(registers->getA() < n); }
 	void Core::CPHLM() { uint8_t n = memory->read(registers->getHL()); uint8_t res = registers->getA() - n; registers->setZeroFlag(registers->getA() == n); registers->setSubFlag(true); registers->setHalfCarryFlag((res^n^registers->getA()) & 0x10); registers->setCarryFlag(registers->getA() < n); }
-	void Core::CPn() { uint8_t n = memory->read(registers->pc); ++registers->pc; uint8_t res = registers->getA() - n; registers->setZeroFlag(registers->getA() == n); registers->setSubFlag(true); registers->setHalfCarryFlag((res^n^registers->getA()) & 0x10); registers->setCarryFlag(registers->getA() < n); }
+	void Core::CPn() { uint8_t n = operand(); ++registers->pc; uint8_t res = registers->getA() - n; registers->setZeroFlag(registers->getA() == n); registers->setSubFlag(true); registers->setHalfCarryFlag((res^n^registers->getA()) & 0x10); registers->setCarryFlag(registers->getA() < n); }
 
 	void Core::INCrA() { uint8_t n = registers->getA(); registers->setA(n + 1); registers->setZeroFlag(registers->getA() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag((((n & 0xF) + 1) & 0x10) != 0); }
 	void Core::INCrB() { uint8_t n = registers->getB(); registers->setB(n + 1); registers->setZeroFlag(registers->getB() == 0); registers->setSubFlag(false); registers->setHalfCarryFlag((((n & 0xF) + 1) & 0x10) != 0); }
@@ -271,7 +290,7 @@ namespace gameboy {
 
 	void Core::ADDSPn()
 	{
-		int8_t n = (int8_t)memory->read(registers->pc);
+		int8_t n = (int8_t)operand();
 		uint16_t sp = registers->getSP();
 		int res = sp + n;
 		registers->setSP(res);
@@ -283,33 +302,33 @@ namespace gameboy {
 	}
 
 	//----------JUMPS----------//
-	void Core::JPnn() { registers->pc = memory->readW(registers->pc); }
+	void Core::JPnn() { registers->pc = operandW(); }
 
 	void Core::JPHL() { registers->pc = registers->getHL(); }
 
 	//jump on condition
-	void Core::JPNZnn() { if (!registers->getZeroFlag()) { conditional = true; registers->pc = memory->readW(registers->pc); } else { registers->pc += 2; } }
-	void Core::JPZnn() { if (registers->getZeroFlag()) { conditional = true; registers->pc = memory->readW(registers->pc); } else { registers->pc += 2; } }
-	void Core::JPNCnn() { if (!registers->getCarryFlag()) { conditional = true; registers->pc = memory->readW(registers->pc); } else { registers->pc += 2; } }
-	void Core::JPCnn() { if (registers->getCarryFlag()) { conditional = true; registers->pc = memory->readW(registers->pc); } else { registers->pc += 2; } }
+	void Core::JPNZnn() { if (!registers->getZeroFlag()) { conditional = true; registers->pc = operandW(); } else { registers->pc += 2; } }
+	void Core::JPZnn() { if (registers->getZeroFlag()) { conditional = true; registers->pc = operandW(); } else { registers->pc += 2; } }
+	void Core::JPNCnn() { if (!registers->getCarryFlag()) { conditional = true; registers->pc = operandW(); } else { registers->pc += 2; } }
+	void Core::JPCnn() { if (registers->getCarryFlag()) { conditional = true; registers->pc = operandW(); } else { registers->pc += 2; } }
 
 	//jump to pc+n on condition
-	void Core::JRn() { int8_t val = (int8_t)memory->read(registers->pc++); registers->pc += val; }
-	void Core::JRNZn() { int8_t val = (int8_t)memory->read(registers->pc++); if (!registers->getZeroFlag()) { registers->pc += val; conditional = true; } }
-	void Core::JRZn() { int8_t val = (int8_t)memory->read(registers->pc++); if (registers->getZeroFlag()) { registers->pc += val; conditional = true; } }
-	void Core::JRNCn() { int8_t val = (int8_t)memory->read(registers->pc++); if (!registers->getCarryFlag()) { registers->pc += val; conditional = true; } }
-	void Core::JRCn() { int8_t val = (int8_t)memory->read(registers->pc++); if (registers->getCarryFlag()) { registers->pc += val; conditional = true; } }
+	void Core::JRn() { int8_t val = (int8_t)nextOperand(); registers->pc += val; }
+	void Core::JRNZn() { int8_t val = (int8_t)nextOperand(); if (!registers->getZeroFlag()) { registers->pc += val; conditional = true; } }
+	void Core::JRZn() { int8_t val = (int8_t)nextOperand(); if (registers->getZeroFlag()) { registers->pc += val; conditional = true; } }
+	void Core::JRNCn() { int8_t val = (int8_t)nextOperand(); if (!registers->getCarryFlag()) { registers->pc += val; conditional = true; } }
+	void Core::JRCn() { int8_t val = (int8_t)nextOperand(); if (registers->getCarryFlag()) { registers->pc += val; conditional = true; } }
 
 	//----------CALLS----------//
-	void Core::CALLnn() { registers->setSP(registers->getSP() - 2); memory->writeW(registers->getSP(), registers->pc + 2); registers->pc = memory->readW(registers->pc); }
-	void Core::CALLNZnn() { if (!registers->getZeroFlag()) { registers->setSP(registers->getSP() - 2); memory->writeW(registers->getSP(), registers->pc + 2); registers->pc = memory->readW(registers->pc); conditional = true; } else { registers->pc += 2; } }
-	void Core::CALLZnn() { if (registers->getZeroFlag()) { registers->setSP(registers->getSP() - 2); memory->writeW(registers->getSP(), registers->pc + 2); registers->pc = memory->readW(registers->pc); conditional = true; } else { registers->pc += 2; } }
-	void Core::CALLNCnn() { if (!registers->getCarryFlag()) { registers->setSP(registers->getSP() - 2); memory->writeW(registers->getSP(), registers->pc + 2); registers->pc = memory->readW(registers->pc); conditional = true; } else { registers->pc += 2; } }
-	void Core::CALLCnn() { if (registers->getCarryFlag()) { registers->setSP(registers->getSP() - 2); memory->writeW(registers->getSP(), registers->pc + 2); registers->pc = memory->readW(registers->pc); conditional = true; } else { registers->pc += 2; } }
+	void Core::CALLnn() { registers->setSP(registers->getSP() - 2); memory->writeW(registers->getSP(), registers->pc + 2); registers->pc = callTarget(); }
+	void Core::CALLNZnn() { if (!registers->getZeroFlag()) { registers->setSP(registers->getSP() - 2); memory->writeW(registers->getSP(), registers->pc + 2); registers->pc = callTarget(); conditional = true; } else { registers->pc += 2; } }
+	void Core::CALLZnn() { if (registers->getZeroFlag()) { registers->setSP(registers->getSP() - 2); memory->writeW(registers->getSP(), registers->pc + 2); registers->pc = callTarget(); conditional = true; } else { registers->pc += 2; } }
+	void Core::CALLNCnn() { if (!registers->getCarryFlag()) { registers->setSP(registers->getSP() - 2); memory->writeW(registers->getSP(), registers->pc + 2); registers->pc = callTarget(); conditional = true; } else { registers->pc += 2; } }
+	void Core::CALLCnn() { if (registers->getCarryFlag()) { registers->setSP(registers->getSP() - 2); memory->writeW(registers->getSP(), registers->pc + 2); registers->pc = callTarget(); conditional = true; } else { registers->pc += 2; } }
 
 	//----------RETURNS----------//
 	void Core::RET() { registers->pc = memory->readW(registers->getSP()); registers->setSP(registers->getSP() + 2); }
-	void Core::RETI() { registers->pc = memory->readW(registers->getSP()); registers->setSP(registers->getSP() + 2); registers->setIME(true); }
+	void Core::RETI() { registers->pc = memory->readW(registers->getSP()); registers->setSP(registers->getSP() + 2); registers->setIME(true); memory->schedule(0); }
 
 	void Core::RETNZ() { if (!registers->getZeroFlag()) { registers->pc = memory->readW(registers->getSP()); registers->setSP(registers->getSP() + 2); conditional = true; } }
 	void Core::RETZ() { if (registers->getZeroFlag()) { registers->pc = memory->readW(registers->getSP()); registers->setSP(registers->getSP() + 2); conditional = true; } }
@@ -354,9 +373,9 @@ namespace gameboy {
 	void Core::NOP() { }
 
 	void Core::DI() { registers->setIME(false); }
-	void Core::EI() { registers->setIME(true); }
+	void Core::EI() { registers->setIME(true); memory->schedule(0); }
 
-	void Core::HALT() { --registers->pc; }
+	void Core::HALT() { halted = true; --registers->pc; }
 
 	void Core::STOP() {
 		// TODO
@@ -0,0 +1,377 @@
+#include "corpus.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace gameboy {
+	// Returns null if the file can't be mapped or isn't a corpus
+	Corpus *Corpus::open(const std::string &path) {
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return nullptr;
+		}
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)sizeof(CorpusHeader)) {
+			CloseHandle(file);
+			return nullptr;
+		}
+
+		HANDLE view = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (view == nullptr) {
+			return nullptr;
+		}
+
+		void *mapping = MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(view);
+		if (mapping == nullptr) {
+			return nullptr;
+		}
+		size_t length = (size_t)size.QuadPart;
+#else
+		int file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0) {
+			return nullptr;
+		}
+
+		struct stat info;
+		if (fstat(file, &info) != 0 || info.st_size < (off_t)sizeof(CorpusHeader)) {
+			close(file);
+			return nullptr;
+		}
+
+		size_t length = (size_t)info.st_size;
+		void *mapping = mmap(nullptr, length, PROT_READ, MAP_SHARED, file, 0);
+		close(file);
+		if (mapping == MAP_FAILED) {
+			return nullptr;
+		}
+		madvise(mapping, length, MADV_SEQUENTIAL);
+#endif
+		Corpus *corpus = new Corpus(static_cast<const uint8_t *>(mapping), length);
+		const CorpusHeader *header = corpus->header;
+		uint64_t indexSize = (CorpusOpCodes + 1 + header->count) * sizeof(uint64_t);
+		if (header->magic != CorpusMagic || header->version != CorpusVersion
+			|| header->memoryOffset + header->memoryCount * sizeof(CorpusMemory) > length
+			|| header->recordsOffset % 8 != 0 || header->recordsOffset + header->count * sizeof(CorpusRecord) > length
+			|| header->indexOffset % 8 != 0 || header->indexOffset + indexSize > length) {
+			delete corpus;
+			return nullptr;
+		}
+		return corpus;
+	}
+
+	Corpus::Corpus(const uint8_t *data, size_t length) :
+		data(data),
+		length(length) {
+		header = reinterpret_cast<const CorpusHeader *>(data);
+		records = reinterpret_cast<const CorpusRecord *>(data + header->recordsOffset);
+		memory = reinterpret_cast<const CorpusMemory *>(data + header->memoryOffset);
+		opCodeFirst = reinterpret_cast<const uint64_t *>(data + header->indexOffset);
+		opCodeRecords = opCodeFirst + CorpusOpCodes + 1;
+	}
+
+	Corpus::~Corpus() {
+#ifdef _WIN32
+		UnmapViewOfFile(data);
+#else
+		munmap(const_cast<uint8_t *>(data), length);
+#endif
+	}
+
+	uint64_t Corpus::size() const {
+		return header->count;
+	}
+
+	const CorpusRecord &Corpus::getRecord(uint64_t index) const {
+		return records[index];
+	}
+
+	// Input memory followed by the output delta, null if the record points
+	// outside the side table
+	const CorpusMemory *Corpus::getMemory(const CorpusRecord &record) const {
+		if (record.memory + record.inputCount + record.deltaCount > header->memoryCount) {
+			return nullptr;
+		}
+		return memory + record.memory;
+	}
+
+	uint64_t Corpus::getOpCodeCount(uint16_t opCode) const {
+		return opCode < CorpusOpCodes ? opCodeFirst[opCode + 1] - opCodeFirst[opCode] : 0;
+	}
+
+	// Record number of the nth vector for opCode
+	uint64_t Corpus::getOpCodeRecord(uint16_t opCode, uint64_t n) const {
+		return opCodeRecords[opCodeFirst[opCode] + n];
+	}
+
+	bool Corpus::getInput(uint64_t index, OracleState &state) const {
+		const CorpusRecord &record = records[index];
+		const CorpusMemory *entries = getMemory(record);
+		if (entries == nullptr) {
+			return false;
+		}
+
+		unpack(record.input, state);
+		state.memory.resize(record.inputCount);
+		for (unsigned int i = 0; i < record.inputCount; i++) {
+			state.memory[i] = MemoryRecord{ entries[i].address, entries[i].value };
+		}
+		return true;
+	}
+
+	// Merges the delta into the input memory, both in address order
+	bool Corpus::getOutput(uint64_t index, OracleState &state) const {
+		const CorpusRecord &record = records[index];
+		const CorpusMemory *entries = getMemory(record);
+		if (entries == nullptr) {
+			return false;
+		}
+
+		unpack(record.output, state);
+		state.memory.clear();
+		const CorpusMemory *input = entries, *inputEnd = entries + record.inputCount;
+		const CorpusMemory *delta = inputEnd, *deltaEnd = inputEnd + record.deltaCount;
+		while (input != inputEnd || delta != deltaEnd) {
+			if (delta == deltaEnd || (input != inputEnd && input->address < delta->address)) {
+				state.memory.push_back(MemoryRecord{ input->address, input->value });
+				++input;
+			}
+			else {
+				if (input != inputEnd && input->address == delta->address) {
+					++input;
+				}
+				state.memory.push_back(MemoryRecord{ delta->address, delta->value });
+				++delta;
+			}
+		}
+		return true;
+	}
+
+	// Runs one vector on the reference Core. input and actual are scratch
+	// space the caller can reuse across calls; actual holds the result.
+	bool Corpus::verify(uint64_t index, OracleState &input, OracleState &actual) const {
+		if (!getInput(index, input)) {
+			return false;
+		}
+
+		const CorpusRecord &record = records[index];
+		uint8_t cycles = Oracle::execute(input, actual);
+		CorpusRegisters registers;
+		pack(actual, registers);
+		if (cycles != record.cycles || memcmp(&registers, &record.output, sizeof(registers)) != 0) {
+			return false;
+		}
+
+		// Same walk as getOutput, compared against actual instead of stored
+		const CorpusMemory *stored = getMemory(record), *storedEnd = stored + record.inputCount;
+		const CorpusMemory *delta = storedEnd, *deltaEnd = storedEnd + record.deltaCount;
+		for (auto it = actual.memory.begin(); it != actual.memory.end(); ++it) {
+			const CorpusMemory *expected;
+			if (delta == deltaEnd || (stored != storedEnd && stored->address < delta->address)) {
+				if (stored == storedEnd) {
+					return false;
+				}
+				expected = stored++;
+			}
+			else {
+				if (stored != storedEnd && stored->address == delta->address) {
+					++stored;
+				}
+				expected = delta++;
+			}
+
+			if (it->address != expected->address || it->value != expected->value) {
+				return false;
+			}
+		}
+		return stored == storedEnd && delta == deltaEnd;
+	}
+
+	void Corpus::pack(const OracleState &state, CorpusRegisters &registers) {
+		registers.a = state.a;
+		registers.b = state.b;
+		registers.c = state.c;
+		registers.d = state.d;
+		registers.e = state.e;
+		registers.h = state.h;
+		registers.l = state.l;
+		registers.flags = (state.zero ? 0x80 : 0) | (state.subtract ? 0x40 : 0) | (state.halfCarry ? 0x20 : 0)
+			| (state.carry ? 0x10 : 0) | (state.ime ? 0x01 : 0);
+		registers.sp = state.sp;
+		registers.pc = state.pc;
+	}
+
+	void Corpus::unpack(const CorpusRegisters &registers, OracleState &state) {
+		state.a = registers.a;
+		state.b = registers.b;
+		state.c = registers.c;
+		state.d = registers.d;
+		state.e = registers.e;
+		state.h = registers.h;
+		state.l = registers.l;
+		state.zero = (registers.flags & 0x80) != 0;
+		state.subtract = (registers.flags & 0x40) != 0;
+		state.halfCarry = (registers.flags & 0x20) != 0;
+		state.carry = (registers.flags & 0x10) != 0;
+		state.ime = (registers.flags & 0x01) != 0;
+		state.sp = registers.sp;
+		state.pc = registers.pc;
+	}
+
+	// Returns null if the file can't be created
+	CorpusWriter *CorpusWriter::create(const std::string &path) {
+		CorpusWriter *writer = new CorpusWriter(path);
+		if (!writer->file) {
+			delete writer;
+			return nullptr;
+		}
+		return writer;
+	}
+
+	CorpusWriter::CorpusWriter(const std::string &path) :
+		file(path, std::ios::binary | std::ios::trunc),
+		memoryCount(0),
+		closed(false) {
+		// Placeholder, close rewrites it once the sizes are known
+		CorpusHeader header = {};
+		file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	}
+
+	CorpusWriter::~CorpusWriter() {
+		close();
+	}
+
+	// Returns false for states the format can't hold: more than 65535 input
+	// addresses, or output memory that isn't in address order or drops an
+	// input address
+	bool CorpusWriter::add(const OracleState &input, const OracleState &output, uint8_t cycles) {
+		if (closed) {
+			return false;
+		}
+
+		// Later records for the same address win, as they do when a Core loads them
+		sorted = input.memory;
+		std::stable_sort(sorted.begin(), sorted.end(), [](const MemoryRecord &a, const MemoryRecord &b) { return a.address < b.address; });
+		size_t count = 0;
+		for (size_t i = 0; i < sorted.size(); i++) {
+			if (count > 0 && sorted[count - 1].address == sorted[i].address) {
+				sorted[count - 1] = sorted[i];
+			}
+			else {
+				sorted[count++] = sorted[i];
+			}
+		}
+		sorted.resize(count);
+		if (count > 0xFFFF) {
+			return false;
+		}
+
+		scratch.clear();
+		for (auto it = sorted.begin(); it != sorted.end(); ++it) {
+			scratch.push_back(CorpusMemory{ it->address, it->value, 0 });
+		}
+
+		auto next = sorted.begin();
+		for (size_t i = 0; i < output.memory.size(); i++) {
+			const MemoryRecord &written = output.memory[i];
+			if ((i > 0 && output.memory[i - 1].address >= written.address)
+				|| (next != sorted.end() && next->address < written.address)) {
+				return false;
+			}
+
+			if (next != sorted.end() && next->address == written.address) {
+				if (next->value != written.value) {
+					scratch.push_back(CorpusMemory{ written.address, written.value, 0 });
+				}
+				++next;
+			}
+			else {
+				scratch.push_back(CorpusMemory{ written.address, written.value, 0 });
+			}
+		}
+		if (next != sorted.end() || scratch.size() - count > 0xFFFF) {
+			return false;
+		}
+
+		CorpusRecord record = {};
+		Corpus::pack(input, record.input);
+		Corpus::pack(output, record.output);
+		record.memory = memoryCount;
+		record.inputCount = (uint16_t)count;
+		record.deltaCount = (uint16_t)(scratch.size() - count);
+		record.cycles = cycles;
+
+		auto at = [this](uint16_t address) {
+			auto it = std::lower_bound(sorted.begin(), sorted.end(), address, [](const MemoryRecord &a, uint16_t b) { return a.address < b; });
+			return it != sorted.end() && it->address == address ? it->value : (uint8_t)0;
+		};
+		record.opCode = at(input.pc);
+		if (record.opCode == 0xCB) {
+			record.opCode = 0x100 | at((uint16_t)(input.pc + 1));
+		}
+
+		file.write(reinterpret_cast<const char *>(scratch.data()), scratch.size() * sizeof(CorpusMemory));
+		memoryCount += scratch.size();
+		records.push_back(record);
+		return (bool)file;
+	}
+
+	// Writes the records, the opcode index and the final header
+	bool CorpusWriter::close() {
+		if (closed) {
+			return (bool)file;
+		}
+		closed = true;
+
+		CorpusHeader header = {};
+		header.magic = CorpusMagic;
+		header.version = CorpusVersion;
+		header.count = records.size();
+		header.memoryCount = memoryCount;
+		header.memoryOffset = sizeof(CorpusHeader);
+		header.recordsOffset = (header.memoryOffset + memoryCount * sizeof(CorpusMemory) + 7) & ~(uint64_t)7;
+		header.indexOffset = header.recordsOffset + records.size() * sizeof(CorpusRecord);
+
+		const char padding[8] = {};
+		file.write(padding, header.recordsOffset - header.memoryOffset - memoryCount * sizeof(CorpusMemory));
+		file.write(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(CorpusRecord));
+
+		// Counting sort of record numbers by opcode
+		std::vector<uint64_t> first(CorpusOpCodes + 1, 0);
+		for (auto it = records.begin(); it != records.end(); ++it) {
+			first[it->opCode + 1]++;
+		}
+		for (unsigned int i = 0; i < CorpusOpCodes; i++) {
+			first[i + 1] += first[i];
+		}
+		std::vector<uint64_t> order(records.size());
+		std::vector<uint64_t> slot(first.begin(), first.end() - 1);
+		for (uint64_t i = 0; i < records.size(); i++) {
+			order[slot[records[i].opCode]++] = i;
+		}
+		file.write(reinterpret_cast<const char *>(first.data()), first.size() * sizeof(uint64_t));
+		file.write(reinterpret_cast<const char *>(order.data()), order.size() * sizeof(uint64_t));
+
+		file.seekp(0);
+		file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		file.close();
+		return !file.fail();
+	}
+
+	uint64_t CorpusWriter::size() const {
+		return records.size();
+	}
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "oracle.h"
+
+namespace gameboy {
+	const uint32_t CorpusMagic = 0x434F4247; // "GBOC"
+	const uint32_t CorpusVersion = 1;
+	const unsigned int CorpusOpCodes = 0x200; // 0x100-0x1FF are CB instructions
+
+	// Binary corpus of oracle test vectors, little-endian, laid out to be
+	// mapped and read in place:
+	//   CorpusHeader
+	//   CorpusMemory[memoryCount]   side table, per record the input memory
+	//                               in address order then the output delta
+	//   CorpusRecord[count]
+	//   uint64_t[CorpusOpCodes + 1] index, first slot of each opcode in order
+	//   uint64_t[count]             index, record numbers grouped by opcode
+	struct CorpusHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t count;
+		uint64_t memoryCount;
+		uint64_t recordsOffset;
+		uint64_t memoryOffset;
+		uint64_t indexOffset;
+	};
+
+	struct CorpusRegisters {
+		uint8_t a;
+		uint8_t b;
+		uint8_t c;
+		uint8_t d;
+		uint8_t e;
+		uint8_t h;
+		uint8_t l;
+		uint8_t flags; // Z N H C in the high nibble like F, IME in bit 0
+		uint16_t sp;
+		uint16_t pc;
+	};
+
+	struct CorpusRecord {
+		CorpusRegisters input;
+		CorpusRegisters output;
+		uint64_t memory; // First side table entry
+		uint16_t inputCount;
+		uint16_t deltaCount; // Output addresses that are new or changed
+		uint16_t opCode;
+		uint8_t cycles;
+		uint8_t reserved;
+	};
+
+	struct CorpusMemory {
+		uint16_t address;
+		uint8_t value;
+		uint8_t reserved;
+	};
+
+	static_assert(sizeof(CorpusHeader) == 48, "CorpusHeader must not contain padding");
+	static_assert(sizeof(CorpusRegisters) == 12, "CorpusRegisters must not contain padding");
+	static_assert(sizeof(CorpusRecord) == 40, "CorpusRecord must not contain padding");
+	static_assert(sizeof(CorpusMemory) == 4, "CorpusMemory must not contain padding");
+
+	// Read only view of a corpus file, mapped into memory
+	class GAMEBOY_API Corpus {
+	public:
+		static Corpus *open(const std::string &path);
+		virtual ~Corpus();
+
+		uint64_t size() const;
+		const CorpusRecord &getRecord(uint64_t index) const;
+		const CorpusMemory *getMemory(const CorpusRecord &record) const;
+		uint64_t getOpCodeCount(uint16_t opCode) const;
+		uint64_t getOpCodeRecord(uint16_t opCode, uint64_t n) const;
+
+		bool getInput(uint64_t index, OracleState &state) const;
+		bool getOutput(uint64_t index, OracleState &state) const;
+		bool verify(uint64_t index, OracleState &input, OracleState &actual) const;
+
+		static void pack(const OracleState &state, CorpusRegisters &registers);
+		static void unpack(const CorpusRegisters &registers, OracleState &state);
+
+	private:
+		explicit Corpus(const uint8_t *data, size_t length);
+		Corpus(const Corpus &);
+		Corpus &operator=(const Corpus &);
+
+		const uint8_t *data;
+		size_t length;
+		const CorpusHeader *header;
+		const CorpusRecord *records;
+		const CorpusMemory *memory;
+		const uint64_t *opCodeFirst;
+		const uint64_t *opCodeRecords;
+	};
+
+	// Appends vectors to a new corpus file. The side table streams to disk as
+	// records are added; records and the index are written by close.
+	class GAMEBOY_API CorpusWriter {
+	public:
+		static CorpusWriter *create(const std::string &path);
+		virtual ~CorpusWriter();
+
+		bool add(const OracleState &input, const OracleState &output, uint8_t cycles);
+		bool close();
+		uint64_t size() const;
+
+	private:
+		explicit CorpusWriter(const std::string &path);
+		CorpusWriter(const CorpusWriter &);
+		CorpusWriter &operator=(const CorpusWriter &);
+
+		std::ofstream file;
+		std::vector<CorpusRecord> records;
+		std::vector<CorpusMemory> scratch;
+		std::vector<MemoryRecord> sorted;
+		uint64_t memoryCount;
+		bool closed;
+	};
+}
\ No newline at end of file
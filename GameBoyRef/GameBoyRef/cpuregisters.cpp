@@ -1,5 +1,8 @@
 #include "cpuregisters.h"
 
+#include <cstring>
+#include "savestate.h"
+
 namespace gameboy {
 	CPURegisters::CPURegisters() {
 		registers = new uint8_t[8];
@@ -12,10 +15,23 @@ namespace gameboy {
 		pc = 0x0000;
 	}
 
+	CPURegisters::CPURegisters(const CPURegisters &other) {
+		registers = new uint8_t[8];
+		*this = other;
+	}
+
 	CPURegisters::~CPURegisters() {
 		delete[] registers;
 	}
 
+	CPURegisters &CPURegisters::operator=(const CPURegisters &other) {
+		memcpy(registers, other.registers, 8);
+		interruptMasterEnable = other.interruptMasterEnable;
+		stackPointer = other.stackPointer;
+		pc = other.pc;
+		return *this;
+	}
+
 	void CPURegisters::setA(uint8_t value) {
 		registers[0] = value;
 	}
@@ -165,6 +181,20 @@ namespace gameboy {
 		return interruptMasterEnable;
 	}
 
+	void CPURegisters::saveState(SaveState &state) const {
+		memcpy(state.registers, registers, sizeof(state.registers));
+		state.sp = stackPointer;
+		state.pc = pc;
+		state.ime = interruptMasterEnable ? 1 : 0;
+	}
+
+	void CPURegisters::loadState(const SaveState &state) {
+		memcpy(registers, state.registers, sizeof(state.registers));
+		stackPointer = state.sp;
+		pc = state.pc;
+		interruptMasterEnable = state.ime != 0;
+	}
+
 	void CPURegisters::setFlag(unsigned int bitpos, bool flag) {
 		if (flag) {
 			registers[5] = registers[5] | (0x1 << bitpos);
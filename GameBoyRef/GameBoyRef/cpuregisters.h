@@ -3,10 +3,14 @@
 #include <cinttypes>
 
 namespace gameboy {
+	struct SaveState;
+
 	class CPURegisters {
 	public:
 		CPURegisters();
+		CPURegisters(const CPURegisters &other);
 		virtual ~CPURegisters();
+		CPURegisters &operator=(const CPURegisters &other);
 
 		void setA(uint8_t value);
 		void setB(uint8_t value);
@@ -49,6 +53,9 @@ namespace gameboy {
 		void setIME(bool flag);
 		bool getIME();
 
+		void saveState(SaveState &state) const;
+		void loadState(const SaveState &state);
+
 		uint16_t pc;
 
 	private:
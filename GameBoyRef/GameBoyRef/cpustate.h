@@ -1,6 +1,8 @@
 #pragma once
 
-#ifdef GAMEBOYREF_EXPORTS
+#if !defined(_WIN32)
+#define GAMEBOY_API
+#elif defined(GAMEBOYREF_EXPORTS)
 #define GAMEBOY_API __declspec(dllexport) 
 #else
 #define GAMEBOY_API __declspec(dllimport) 
@@ -26,6 +28,6 @@ namespace gameboy {
 		bool FH;
 		bool FC;
 		bool IME;
-		MemoryRecord *MemoryRecord;
+		gameboy::MemoryRecord *MemoryRecord;
 	};
 }
\ No newline at end of file
@@ -1,101 +1,137 @@
 #include "functions.h"
 
+#include <cstring>
+#include <memory>
 #include <string>
-#include <sstream>
-#include <iterator>
-#include <vector>
-#include <iostream>
-#include "core.h"
-#include "memory.h"
-
-std::vector<std::string> &split(const std::string &s, char delim, std::vector<std::string> &elems) {
-	std::stringstream ss(s);
-	std::string item;
-	while (std::getline(ss, item, delim)) {
-		elems.push_back(item);
+#include "oracle.h"
+#include "oraclecache.h"
+#include "rom.h"
+#include "vectorenv.h"
+
+static std::unique_ptr<gameboy::OracleCache> resultCache;
+
+static uint8_t execute(const gameboy::OracleState &input, gameboy::OracleState &output) {
+	gameboy::OracleCache *cache = resultCache.get();
+	return cache != nullptr ? cache->execute(input, output) : gameboy::Oracle::execute(input, output);
+}
+
+const int Run(char *input, char *output) {
+	gameboy::OracleState state;
+	if (!gameboy::Oracle::parse(input, state)) {
+		output[0] = '\0';
+		return 0;
 	}
-	return elems;
+
+	gameboy::OracleState result;
+	execute(state, result);
+
+	std::string str;
+	gameboy::Oracle::format(result, str);
+	memcpy(output, str.c_str(), str.length() + 1);
+
+	return 1;
 }
 
+// One state per line in, one result per line out, an empty line for input
+// that doesn't parse. Stops early if output can't hold the next result;
+// returns the number of lines done.
+int RunBatch(char *input, char *output, int outputSize) {
+	gameboy::OracleState state, result;
+	std::string str;
+	int count = 0;
+	size_t used = 0;
+
+	for (const char *line = input; *line != '\0'; ) {
+		const char *end = strchr(line, '\n');
+		if (end == nullptr) {
+			end = line + strlen(line);
+		}
 
-std::vector<std::string> split(const std::string &s, char delim) {
-	std::vector<std::string> elems;
-	split(s, delim, elems);
-	return elems;
+		str.clear();
+		if (gameboy::Oracle::parse(line, state)) {
+			execute(state, result);
+			gameboy::Oracle::format(result, str);
+		}
+		if (used + str.length() + 2 > (size_t)outputSize) {
+			break;
+		}
+
+		memcpy(output + used, str.c_str(), str.length());
+		used += str.length();
+		output[used++] = '\n';
+		count++;
+		line = *end != '\0' ? end + 1 : end;
+	}
+
+	if (outputSize > 0) {
+		output[used] = '\0';
+	}
+	return count;
 }
 
-bool to_bool(std::string const& s) {
-	return s != "0";
+// Entries to keep, 0 turns the cache off. Not safe while Run or RunBatch
+// calls are in flight.
+void SetResultCache(int capacity) {
+	resultCache.reset(capacity > 0 ? new gameboy::OracleCache((size_t)capacity) : nullptr);
 }
 
-const int Run(char *input, char *output) {
-	auto inputStr = std::string(input);
-	auto split1 = split(input, ',');
-	auto registers = split(split1[0], '|');
-	auto inMem = split(split1[1], '|');
-	
-	auto *initMem = new std::vector<gameboy::MemoryRecord>();
-	for (int i = 0; i < inMem.size(); i++) {
-		auto kvp = split(inMem[i], ':');
-		initMem->push_back(gameboy::MemoryRecord{
-			(uint16_t)std::stoi(kvp[0].c_str()),
-			(uint8_t)std::stoi(kvp[1].c_str())
-		});
+void GetResultCacheStats(long long *hits, long long *misses) {
+	gameboy::OracleCache *cache = resultCache.get();
+	*hits = cache != nullptr ? (long long)cache->getHits() : 0;
+	*misses = cache != nullptr ? (long long)cache->getMisses() : 0;
+}
+
+// count environments on the ROM at path, see gameboy::VectorEnv. Each
+// observation is 160 / scale by 144 / scale grayscale bytes followed by
+// the byte at each of the ramCount addresses. threads 0 means one per
+// core. Returns null if the ROM can't be loaded or the arguments are out
+// of range.
+void *CreateEnvironments(const char *path, int count, int scale, const int *ramAddresses, int ramCount, int threads) {
+	if (count <= 0 || scale <= 0 || ramCount < 0 || threads < 0) {
+		return nullptr;
 	}
 
-	auto core = gameboy::Core();
-	core.memory->setMemoryRecord(initMem);
-	core.registers->setA(std::stoi(registers[0].c_str()));
-	core.registers->setB(std::stoi(registers[1].c_str()));
-	core.registers->setC(std::stoi(registers[2].c_str()));
-	core.registers->setD(std::stoi(registers[3].c_str()));
-	core.registers->setE(std::stoi(registers[4].c_str()));
-	//core.registers->setF(std::stoi(registers[5].c_str())); // Set flags individually
-	core.registers->setH(std::stoi(registers[5].c_str()));
-	core.registers->setL(std::stoi(registers[6].c_str()));
-	core.registers->setSP(std::stoi(registers[7].c_str()));
-	core.registers->pc = std::stoi(registers[8].c_str());
-	core.registers->setZeroFlag(to_bool(registers[9]));
-	core.registers->setSubFlag(to_bool(registers[10]));
-	core.registers->setHalfCarryFlag(to_bool(registers[11]));
-	core.registers->setCarryFlag(to_bool(registers[12]));
-	core.registers->setIME(to_bool(registers[13]));
-
-	core.emulateCycle();
-
-	std::ostringstream cpuState;
-	cpuState
-		<< (int)core.registers->getA() << "|"
-		<< (int)core.registers->getB() << "|"
-		<< (int)core.registers->getC() << "|"
-		<< (int)core.registers->getD() << "|"
-		<< (int)core.registers->getE() << "|"
-		//<< (int)core.registers->getF() << "|" // Get flags individually
-		<< (int)core.registers->getH() << "|"
-		<< (int)core.registers->getL() << "|"
-		<< std::to_string(core.registers->getSP()) << "|"
-		<< std::to_string(core.registers->pc) << "|"
-		<< (bool)core.registers->getZeroFlag() << "|"
-		<< (bool)core.registers->getSubFlag() << "|"
-		<< (bool)core.registers->getHalfCarryFlag() << "|"
-		<< (bool)core.registers->getCarryFlag() << "|"
-		<< (bool)core.registers->getIME() << ",";
-
-	auto outMem = core.memory->getMemoryRecord();
-	for (int i = 0; i < outMem->size(); i++) {
-		gameboy::MemoryRecord rec = outMem->at(i);
-		cpuState
-			<< std::to_string(rec.address) << ":"
-			<< std::to_string(rec.value);
-
-		if (i + 1 < outMem->size())
-			cpuState << "|";
+	std::vector<uint16_t> addresses;
+	for (int i = 0; i < ramCount; i++) {
+		if (ramAddresses[i] < 0 || ramAddresses[i] > 0xFFFF) {
+			return nullptr;
+		}
+		addresses.push_back((uint16_t)ramAddresses[i]);
 	}
 
-	auto str = cpuState.str();
-	auto i = stdext::checked_array_iterator<char*>(output, str.length());
-	std::copy(str.begin(), str.end(), i);
-	output[str.length()] = '\0';
+	auto rom = gameboy::Rom::open(path);
+	return rom ? gameboy::VectorEnv::open(rom, count, scale, addresses, threads) : nullptr;
+}
+
+void DestroyEnvironments(void *environments) {
+	delete (gameboy::VectorEnv *)environments;
+}
+
+// Bytes per environment in the observation buffers
+int GetObservationSize(void *environments) {
+	return (int)((gameboy::VectorEnv *)environments)->getObservationSize();
+}
+
+// mask holds one byte per environment, non-zero to reset it, or is null
+// to reset them all. observations holds count * GetObservationSize bytes,
+// only the environments reset are written.
+void ResetEnvironments(void *environments, const unsigned char *mask, unsigned char *observations) {
+	((gameboy::VectorEnv *)environments)->reset(mask, observations);
+}
+
+// actions holds the buttons for each environment, in the bit order of
+// gameboy::Joypad::Button. Every environment's observation is written.
+void StepEnvironments(void *environments, const unsigned char *actions, int frameskip, unsigned char *observations) {
+	((gameboy::VectorEnv *)environments)->step(actions, frameskip > 0 ? frameskip : 1, observations);
+}
 
+// Returns 0 if index is out of range
+int SaveResetState(void *environments, int index) {
+	gameboy::VectorEnv *env = (gameboy::VectorEnv *)environments;
+	if (index < 0 || (unsigned int)index >= env->getCount()) {
+		return 0;
+	}
+
+	env->setResetState(index);
 	return 1;
-}
\ No newline at end of file
+}
@@ -3,6 +3,23 @@
 
 #include "cpustate.h"
 
-extern "C" { __declspec(dllexport) const int Run(char *input, char *output); }
+#ifdef _WIN32
+#define GAMEBOY_EXPORT __declspec(dllexport)
+#else
+#define GAMEBOY_EXPORT
+#endif
+
+extern "C" {
+	GAMEBOY_EXPORT const int Run(char *input, char *output);
+	GAMEBOY_EXPORT int RunBatch(char *input, char *output, int outputSize);
+	GAMEBOY_EXPORT void SetResultCache(int capacity);
+	GAMEBOY_EXPORT void GetResultCacheStats(long long *hits, long long *misses);
+	GAMEBOY_EXPORT void *CreateEnvironments(const char *path, int count, int scale, const int *ramAddresses, int ramCount, int threads);
+	GAMEBOY_EXPORT void DestroyEnvironments(void *environments);
+	GAMEBOY_EXPORT int GetObservationSize(void *environments);
+	GAMEBOY_EXPORT void ResetEnvironments(void *environments, const unsigned char *mask, unsigned char *observations);
+	GAMEBOY_EXPORT void StepEnvironments(void *environments, const unsigned char *actions, int frameskip, unsigned char *observations);
+	GAMEBOY_EXPORT int SaveResetState(void *environments, int index);
+}
 
 #endif
\ No newline at end of file
@@ -0,0 +1,383 @@
+#include "gpu.h"
+
+#include <cstring>
+#include "memory.h"
+#include "savestate.h"
+
+namespace gameboy {
+	static const uint16_t BgpAddress = 0xFF47;
+	static const uint16_t Obp0Address = 0xFF48;
+	static const uint16_t Obp1Address = 0xFF49;
+	static const uint16_t ScyAddress = 0xFF42;
+	static const uint16_t ScxAddress = 0xFF43;
+	static const uint16_t WyAddress = 0xFF4A;
+	static const uint16_t WxAddress = 0xFF4B;
+	static const uint16_t OamAddress = 0xFE00;
+	static const unsigned int Sprites = 40;
+
+	// STAT enable bit for the interrupt on entering each mode
+	static const uint8_t modeInterrupts[] = { 0x08, 0x10, 0x20, 0x00 };
+
+	Gpu::Gpu() :
+		memory(nullptr),
+		nextEvent(NoEvent),
+		frames(0),
+		lcdc(0),
+		stat(0),
+		ly(0),
+		lyc(0),
+		mode(HBlank),
+		coincidence(true),
+		drawing(true) {
+		memset(frameBuffer, 0, sizeof(frameBuffer));
+	}
+
+	// Copies have to be attached to a Memory of their own
+	Gpu::Gpu(const Gpu &other) :
+		memory(nullptr),
+		nextEvent(other.nextEvent),
+		frames(other.frames),
+		lcdc(other.lcdc),
+		stat(other.stat),
+		ly(other.ly),
+		lyc(other.lyc),
+		mode(other.mode),
+		coincidence(other.coincidence),
+		drawing(other.drawing) {
+		memcpy(frameBuffer, other.frameBuffer, sizeof(frameBuffer));
+	}
+
+	Gpu::~Gpu() {
+	}
+
+	void Gpu::attach(Memory *memory) {
+		this->memory = memory;
+		memory->mapIo(LcdcAddress, this);
+		memory->mapIo(StatAddress, this);
+		memory->mapIo(LyAddress, this);
+		memory->mapIo(LycAddress, this);
+		memory->addClocked(this);
+	}
+
+	uint8_t Gpu::readIo(uint16_t address) {
+		switch (address) {
+		case LcdcAddress:
+			return lcdc;
+		case StatAddress:
+			return 0x80 | stat | (coincidence ? 0x04 : 0x00) | mode;
+		case LyAddress:
+			return ly;
+		default:
+			return lyc;
+		}
+	}
+
+	// LY is read only. Turning the LCD off resets it to line 0, turning it
+	// back on starts a frame from the top.
+	void Gpu::writeIo(uint16_t address, uint8_t value) {
+		switch (address) {
+		case LcdcAddress: {
+			bool enabled = isEnabled();
+			lcdc = value;
+			if (enabled && !isEnabled()) {
+				ly = 0;
+				mode = HBlank;
+				nextEvent = NoEvent;
+				compareLine();
+			}
+			else if (!enabled && isEnabled()) {
+				ly = 0;
+				compareLine();
+				setMode(Oam, memory->getClock() + OamCycles);
+				memory->schedule(nextEvent);
+			}
+			break;
+		}
+		case StatAddress:
+			stat = value & 0x78;
+			break;
+		case LycAddress:
+			lyc = value;
+			compareLine();
+			break;
+		}
+	}
+
+	uint64_t Gpu::update(uint64_t clock) {
+		while (clock >= nextEvent) {
+			switch (mode) {
+			case Oam:
+				setMode(Vram, nextEvent + VramCycles);
+				if (drawing) {
+					drawLine();
+				}
+				break;
+			case Vram:
+				setMode(HBlank, nextEvent + HBlankCycles);
+				break;
+			case HBlank:
+				++ly;
+				compareLine();
+				if (ly == ScreenHeight) {
+					++frames;
+					memory->requestInterrupt(VBlankInterrupt);
+					setMode(VBlank, nextEvent + LineCycles);
+				}
+				else {
+					setMode(Oam, nextEvent + OamCycles);
+				}
+				break;
+			case VBlank:
+				if (++ly == Lines) {
+					ly = 0;
+					compareLine();
+					setMode(Oam, nextEvent + OamCycles);
+				}
+				else {
+					compareLine();
+					nextEvent += LineCycles;
+				}
+				break;
+			}
+		}
+
+		return nextEvent;
+	}
+
+	void Gpu::saveState(SaveState &state) const {
+		state.io.gpuEvent = nextEvent;
+		state.io.frames = frames;
+		state.io.lcdc = lcdc;
+		state.io.stat = stat;
+		state.io.ly = ly;
+		state.io.lyc = lyc;
+		state.io.gpuMode = mode;
+		state.io.coincidence = coincidence ? 1 : 0;
+	}
+
+	// The frame buffer isn't saved, it's complete again a frame later
+	void Gpu::loadState(const SaveState &state) {
+		nextEvent = state.io.gpuEvent;
+		frames = state.io.frames;
+		lcdc = state.io.lcdc;
+		stat = state.io.stat & 0x78;
+		ly = state.io.ly;
+		lyc = state.io.lyc;
+		mode = (Mode)(state.io.gpuMode & 0x03);
+		coincidence = state.io.coincidence != 0;
+	}
+
+	const uint8_t *Gpu::getFrameBuffer() const {
+		return frameBuffer;
+	}
+
+	// Frames completed, counted on entering VBlank
+	uint64_t Gpu::getFrameCount() const {
+		return frames;
+	}
+
+	// Clock the next VBlank starts at if the LCD stays on until then,
+	// NoEvent while it's off
+	uint64_t Gpu::getNextVBlank() const {
+		if (!isEnabled()) {
+			return NoEvent;
+		}
+
+		uint64_t lineEnd = nextEvent;
+		if (mode == Oam) {
+			lineEnd += VramCycles + HBlankCycles;
+		}
+		else if (mode == Vram) {
+			lineEnd += HBlankCycles;
+		}
+		unsigned int lines = mode == VBlank ? Lines - 1 - ly + ScreenHeight : ScreenHeight - 1 - ly;
+		return lineEnd + lines * LineCycles;
+	}
+
+	// With drawing off lines aren't drawn and the frame buffer keeps what it
+	// had, timing and interrupts are unchanged. For frames nobody looks at.
+	void Gpu::setDrawing(bool drawing) {
+		this->drawing = drawing;
+	}
+
+	uint64_t Gpu::getFrameHash() const {
+		return hash(frameBuffer, sizeof(frameBuffer));
+	}
+
+	static inline uint64_t rotate(uint64_t value, unsigned int bits) {
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	// Random 64-bit keys, one per hash lane
+	static const unsigned int HashLanes = 32;
+	static const uint64_t hashKeys[HashLanes] = {
+		0x6AEDCF4A4599A084ULL, 0x41F60BE07CEF6AA3ULL, 0x4D9DFF9714F60B7AULL, 0x0587212A56B73CFEULL,
+		0x7BF8322A12847494ULL, 0x1D6608F702D34789ULL, 0xCEC2D5EF48AA69A3ULL, 0xF4D26F481E22010BULL,
+		0xDAFCCD9F4FA0336CULL, 0xA638CAA5BE541A11ULL, 0xE62D3F4C09274947ULL, 0x110EDC179FFBE863ULL,
+		0x45869E992290176EULL, 0xE565DA21CB89C9F7ULL, 0x27749D9FBCA9E904ULL, 0xFE19DBB53604C542ULL,
+		0xC2BF468AD91B8BE9ULL, 0x6DAACF24B7A115EFULL, 0x9CE82C7013300288ULL, 0x248EE65A687B4C7AULL,
+		0x0EA43D37B350C341ULL, 0x083C2879EC46FDE3ULL, 0x521739EA2C160877ULL, 0x5B461BC0407A17C2ULL,
+		0xB9A63C39C66C7E86ULL, 0x51ECAE94F671B124ULL, 0x695140EB18004D45ULL, 0x056F89F816FEFC7AULL,
+		0x5418F039C04D4ADEULL, 0xC8ACB3B05126362CULL, 0xB2FDA54C6303C86DULL, 0xEF516257E0574C68ULL
+	};
+
+	// 64-bit hash in the style of XXH3. 32 lanes take 256 bytes per round,
+	// each adding its word and the product of the word's keyed low and high
+	// halves. That 32x32->64 multiply is one SSE2 has for 64-bit lanes
+	// (pmuludq), so the round vectorizes at the baseline target where a full
+	// 64-bit lane multiply would need AVX-512. Every 4 rounds the lanes are
+	// scrambled so high bits feed back into the low halves. Words are read in
+	// host order, which the rest of the core already assumes is little endian.
+	uint64_t Gpu::hash(const uint8_t *data, size_t size) {
+		const uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+		const uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+		const uint64_t prime3 = 0x165667B19E3779F9ULL;
+		const uint64_t prime32 = 0x9E3779B1;
+		const unsigned int ScrambleRounds = 4;
+
+		uint64_t lanes[HashLanes];
+		memcpy(lanes, hashKeys, sizeof(lanes));
+		size_t i = 0;
+		unsigned int rounds = 0;
+		for (; i + sizeof(lanes) <= size; i += sizeof(lanes)) {
+			for (unsigned int j = 0; j < HashLanes; j++) {
+				uint64_t word;
+				memcpy(&word, &data[i + j * sizeof(word)], sizeof(word));
+				uint64_t keyed = word ^ hashKeys[j];
+				lanes[j] += word + (uint64_t)(uint32_t)keyed * (uint32_t)(keyed >> 32);
+			}
+
+			if (++rounds == ScrambleRounds) {
+				rounds = 0;
+				for (unsigned int j = 0; j < HashLanes; j++) {
+					lanes[j] = (lanes[j] ^ (lanes[j] >> 47) ^ hashKeys[j]) * prime32;
+				}
+			}
+		}
+
+		uint64_t result = size * prime1;
+		for (unsigned int j = 0; j < HashLanes; j++) {
+			result = rotate(result ^ (lanes[j] * prime2), 31) * prime1;
+		}
+		for (; i < size; i++) {
+			result = rotate(result ^ (data[i] * prime3), 11) * prime1;
+		}
+
+		result ^= result >> 33;
+		result *= prime2;
+		result ^= result >> 29;
+		result *= prime3;
+		result ^= result >> 32;
+		return result;
+	}
+
+	bool Gpu::isEnabled() const {
+		return (lcdc & 0x80) != 0;
+	}
+
+	void Gpu::setMode(Mode mode, uint64_t clock) {
+		this->mode = mode;
+		nextEvent = clock;
+		if (stat & modeInterrupts[mode]) {
+			memory->requestInterrupt(LcdInterrupt);
+		}
+	}
+
+	// Updates the LY == LYC flag, interrupting when it becomes set
+	void Gpu::compareLine() {
+		bool was = coincidence;
+		coincidence = ly == lyc;
+		if (coincidence && !was && (stat & 0x40)) {
+			memory->requestInterrupt(LcdInterrupt);
+		}
+	}
+
+	void Gpu::drawLine() {
+		uint8_t colors[ScreenWidth]; // Background and window color numbers before the palette
+		if (lcdc & 0x01) {
+			drawTiles(colors, (lcdc & 0x08) ? 0x9C00 : 0x9800, memory->read(ScyAddress) + ly, 0, memory->read(ScxAddress));
+		}
+		else {
+			memset(colors, 0, sizeof(colors));
+		}
+
+		if (lcdc & 0x20) {
+			uint8_t wy = memory->read(WyAddress);
+			int left = (int)memory->read(WxAddress) - 7;
+			if (wy <= ly && left < (int)ScreenWidth) {
+				drawTiles(colors, (lcdc & 0x40) ? 0x9C00 : 0x9800, ly - wy, left < 0 ? 0 : left, (uint8_t)-left);
+			}
+		}
+
+		uint8_t *line = &frameBuffer[ly * ScreenWidth];
+		uint8_t palette = memory->read(BgpAddress);
+		for (unsigned int x = 0; x < ScreenWidth; x++) {
+			line[x] = (palette >> (colors[x] * 2)) & 0x03;
+		}
+
+		if (lcdc & 0x02) {
+			drawSprites(line, colors);
+		}
+	}
+
+	// Fills line from x on with tiles from map row y, x + offset is the
+	// column in the 256 pixel wide map. Tiles fetch once per 8 pixels.
+	void Gpu::drawTiles(uint8_t *line, uint16_t map, uint8_t y, unsigned int x, uint8_t offset) {
+		uint16_t row = map + (y >> 3) * 32;
+		while (x < ScreenWidth) {
+			uint8_t column = (uint8_t)(x + offset);
+			uint8_t tile = memory->read(row + (column >> 3));
+			uint16_t address = (lcdc & 0x10) ? 0x8000 + tile * 16 : 0x9000 + (int8_t)tile * 16;
+			address += (y & 0x07) * 2;
+
+			uint8_t lo = memory->read(address);
+			uint8_t hi = memory->read(address + 1);
+			for (unsigned int pixel = column & 0x07; pixel < 8 && x < ScreenWidth; pixel++, x++) {
+				unsigned int bit = 7 - pixel;
+				line[x] = (((hi >> bit) & 0x01) << 1) | ((lo >> bit) & 0x01);
+			}
+		}
+	}
+
+	// Sprites are drawn last to first so lower OAM entries end up on top.
+	// Like the original there's no 10 sprites per line limit.
+	void Gpu::drawSprites(uint8_t *line, const uint8_t *colors) {
+		int height = (lcdc & 0x04) ? 16 : 8;
+		for (int i = Sprites - 1; i >= 0; i--) {
+			uint16_t entry = OamAddress + i * 4;
+			int y = (int)memory->read(entry) - 16;
+			int x = (int)memory->read(entry + 1) - 8;
+			if (ly < y || ly >= y + height || x <= -8 || x >= (int)ScreenWidth) {
+				continue;
+			}
+
+			uint8_t tile = memory->read(entry + 2);
+			uint8_t flags = memory->read(entry + 3);
+			int row = ly - y;
+			if (flags & 0x40) {
+				row = height - 1 - row;
+			}
+			if (height == 16) {
+				tile &= 0xFE;
+			}
+
+			uint16_t address = 0x8000 + tile * 16 + row * 2;
+			uint8_t lo = memory->read(address);
+			uint8_t hi = memory->read(address + 1);
+			uint8_t palette = memory->read((flags & 0x10) ? Obp1Address : Obp0Address);
+			for (int pixel = 0; pixel < 8; pixel++) {
+				int screenX = x + pixel;
+				if (screenX < 0 || screenX >= (int)ScreenWidth) {
+					continue;
+				}
+
+				unsigned int bit = (flags & 0x20) ? pixel : 7 - pixel;
+				uint8_t color = (((hi >> bit) & 0x01) << 1) | ((lo >> bit) & 0x01);
+				if (color == 0 || ((flags & 0x80) && colors[screenX] != 0)) {
+					continue; // Transparent, or behind a non-zero background color
+				}
+				line[screenX] = (palette >> (color * 2)) & 0x03;
+			}
+		}
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+#include "core.h"
+#include "iodevice.h"
+
+namespace gameboy {
+	class Memory;
+	struct SaveState;
+
+	// LCD controller, ported from GameBoyEm's Gpu. Owns LCDC, STAT, LY and
+	// LYC; scroll, palette and window registers stay latched in Memory and
+	// are read when a line is drawn. Each line is drawn whole at the start of
+	// mode 3 into a buffer of shades, 0 (lightest) to 3.
+	class GAMEBOY_API Gpu : public IoDevice, public ClockedDevice {
+	public:
+		static const unsigned int ScreenWidth = 160;
+		static const unsigned int ScreenHeight = 144;
+		static const unsigned int Lines = 154;
+		static const unsigned int OamCycles = 20;
+		static const unsigned int VramCycles = 43;
+		static const unsigned int HBlankCycles = 51;
+		static const unsigned int LineCycles = 114;
+		static const unsigned int FrameCycles = LineCycles * Lines;
+		static const uint16_t LcdcAddress = 0xFF40;
+		static const uint16_t StatAddress = 0xFF41;
+		static const uint16_t LyAddress = 0xFF44;
+		static const uint16_t LycAddress = 0xFF45;
+
+		enum Mode : uint8_t {
+			HBlank = 0,
+			VBlank = 1,
+			Oam = 2,
+			Vram = 3
+		};
+
+		explicit Gpu();
+		Gpu(const Gpu &other);
+		virtual ~Gpu();
+
+		void attach(Memory *memory);
+		uint8_t readIo(uint16_t address);
+		void writeIo(uint16_t address, uint8_t value);
+		uint64_t update(uint64_t clock);
+		void saveState(SaveState &state) const;
+		void loadState(const SaveState &state);
+		const uint8_t *getFrameBuffer() const;
+		uint64_t getFrameCount() const;
+		uint64_t getNextVBlank() const;
+		void setDrawing(bool drawing);
+		uint64_t getFrameHash() const;
+		static uint64_t hash(const uint8_t *data, size_t size);
+
+	private:
+		Gpu &operator=(const Gpu &other);
+		bool isEnabled() const;
+		void setMode(Mode mode, uint64_t clock);
+		void compareLine();
+		void drawLine();
+		void drawTiles(uint8_t *line, uint16_t map, uint8_t y, unsigned int x, uint8_t offset);
+		void drawSprites(uint8_t *line, const uint8_t *colors);
+
+		Memory *memory;
+		uint64_t nextEvent;
+		uint64_t frames;
+		uint8_t lcdc;
+		uint8_t stat; // Interrupt enables only, mode and coincidence are worked out on read
+		uint8_t ly;
+		uint8_t lyc;
+		Mode mode;
+		bool coincidence;
+		bool drawing;
+		uint8_t frameBuffer[ScreenWidth * ScreenHeight];
+	};
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cinttypes>
+#include <limits>
+
+namespace gameboy {
+	const uint64_t NoEvent = std::numeric_limits<uint64_t>::max();
+
+	// Bits of IF (0xFF0F) and IE (0xFFFF), highest priority first
+	const uint8_t VBlankInterrupt = 0x01;
+	const uint8_t LcdInterrupt = 0x02;
+	const uint8_t TimerInterrupt = 0x04;
+	const uint8_t SerialInterrupt = 0x08;
+	const uint8_t JoypadInterrupt = 0x10;
+
+	// Peripheral behind one or more I/O registers in 0xFF00-0xFF7F. Devices
+	// register themselves with Memory::mapIo for each address they handle.
+	class IoDevice {
+	public:
+		virtual ~IoDevice() {}
+
+		virtual uint8_t readIo(uint16_t address) = 0;
+		virtual void writeIo(uint16_t address, uint8_t value) = 0;
+	};
+
+	// Device with work scheduled on the clock. Memory::update calls update
+	// whenever any bus event is due, the device runs whatever is due by clock
+	// and returns the clock it next needs to run at, or NoEvent.
+	class ClockedDevice {
+	public:
+		virtual ~ClockedDevice() {}
+
+		virtual uint64_t update(uint64_t clock) = 0;
+	};
+}
\ No newline at end of file
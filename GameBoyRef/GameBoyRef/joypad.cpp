@@ -0,0 +1,65 @@
+#include "joypad.h"
+
+#include "memory.h"
+#include "savestate.h"
+
+namespace gameboy {
+	Joypad::Joypad() :
+		memory(nullptr),
+		select(0x30),
+		buttons(0) {
+	}
+
+	// Copies have to be attached to a Memory of their own
+	Joypad::Joypad(const Joypad &other) :
+		memory(nullptr),
+		select(other.select),
+		buttons(other.buttons) {
+	}
+
+	Joypad::~Joypad() {
+	}
+
+	void Joypad::attach(Memory *memory) {
+		this->memory = memory;
+		memory->mapIo(Address, this);
+	}
+
+	uint8_t Joypad::readIo(uint16_t /*address*/) {
+		uint8_t value = 0xC0 | select | 0x0F;
+		if ((select & 0x10) == 0) {
+			value &= ~(buttons & 0x0F);
+		}
+		if ((select & 0x20) == 0) {
+			value &= ~(buttons >> 4);
+		}
+		return value;
+	}
+
+	void Joypad::writeIo(uint16_t /*address*/, uint8_t value) {
+		select = value & 0x30;
+	}
+
+	void Joypad::saveState(SaveState &state) const {
+		state.io.joypadSelect = select;
+		state.io.joypadButtons = buttons;
+	}
+
+	void Joypad::loadState(const SaveState &state) {
+		select = state.io.joypadSelect & 0x30;
+		buttons = state.io.joypadButtons;
+	}
+
+	// Pressing any button that wasn't held requests the joypad interrupt
+	void Joypad::setButtons(uint8_t buttons) {
+		uint8_t pressed = buttons & ~this->buttons;
+		this->buttons = buttons;
+		if (pressed != 0 && memory != nullptr) {
+			memory->requestInterrupt(JoypadInterrupt);
+		}
+	}
+
+	uint8_t Joypad::getButtons() const {
+		return buttons;
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cinttypes>
+#include "iodevice.h"
+
+namespace gameboy {
+	class Memory;
+	struct SaveState;
+
+	// P1 (0xFF00). The host sets which buttons are held, the guest selects the
+	// direction or button row with bits 4 and 5 and reads it back active low.
+	class Joypad : public IoDevice {
+	public:
+		static const uint16_t Address = 0xFF00;
+
+		enum Button : uint8_t {
+			Right = 0x01,
+			Left = 0x02,
+			Up = 0x04,
+			Down = 0x08,
+			A = 0x10,
+			B = 0x20,
+			Select = 0x40,
+			Start = 0x80
+		};
+
+		explicit Joypad();
+		Joypad(const Joypad &other);
+		virtual ~Joypad();
+
+		void attach(Memory *memory);
+		uint8_t readIo(uint16_t address);
+		void writeIo(uint16_t address, uint8_t value);
+		void saveState(SaveState &state) const;
+		void loadState(const SaveState &state);
+		void setButtons(uint8_t buttons);
+		uint8_t getButtons() const;
+
+	private:
+		Joypad &operator=(const Joypad &other);
+
+		Memory *memory;
+		uint8_t select;
+		uint8_t buttons; // Button bits, set while held
+	};
+}
\ No newline at end of file
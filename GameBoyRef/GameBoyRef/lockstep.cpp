@@ -0,0 +1,399 @@
+#include "lockstep.h"
+
+#include <algorithm>
+#include <cstring>
+#include "core.h"
+
+namespace gameboy {
+	static const uint8_t ZeroFlag = 0x80;
+	static const uint8_t SubFlag = 0x40;
+	static const uint8_t HalfCarryFlag = 0x20;
+	static const uint8_t CarryFlag = 0x10;
+	static const unsigned int Immediate = 6;
+	static const unsigned int A = 7;
+
+	static inline uint8_t zero(uint8_t value) {
+		return value == 0 ? ZeroFlag : 0;
+	}
+
+	static_assert(sizeof(MemoryRecord) == 4, "isOrdered reads MemoryRecords as 32-bit words");
+
+	// Takes each record as a word with the address in the low half, which
+	// with no early exit lets the loop vectorize. Assumes a little endian
+	// host. Input is nearly always ordered, so nothing is lost by always
+	// reading to the end.
+	static bool isOrdered(const std::vector<MemoryRecord> &memory) {
+		const uint8_t *records = (const uint8_t *)memory.data();
+		uint32_t unordered = 0;
+		for (size_t i = 1; i < memory.size(); i++) {
+			uint32_t previous, current;
+			memcpy(&previous, &records[(i - 1) * sizeof(MemoryRecord)], sizeof(previous));
+			memcpy(&current, &records[i * sizeof(MemoryRecord)], sizeof(current));
+			unordered |= ((current & 0xFFFF) - (previous & 0xFFFF) - 1) & 0x10000;
+		}
+		return unordered == 0;
+	}
+
+	// Memory in ascending address order, absent addresses read 0 as they do on a fresh Core
+	static uint8_t find(const std::vector<MemoryRecord> &memory, uint16_t address) {
+		auto it = std::lower_bound(memory.begin(), memory.end(), address, [](const MemoryRecord &a, uint16_t b) { return a.address < b; });
+		return it != memory.end() && it->address == address ? it->value : 0;
+	}
+
+	Lockstep::Lockstep() :
+		lanes(0),
+		opCode(0) {
+		memset(registers, 0, sizeof(registers));
+		memset(flags, 0, sizeof(flags));
+	}
+
+	Lockstep::~Lockstep() {
+	}
+
+	// opCode 0x100-0x1FF is a CB instruction
+	bool Lockstep::isVectorized(uint16_t opCode) {
+		unsigned int source = opCode & 0x07;
+		unsigned int destination = (opCode >> 3) & 0x07;
+		if (opCode >= 0x100) {
+			return source != 6; // (HL)
+		}
+		if (opCode >= 0xC0) {
+			return source == 6; // ALU with an immediate operand
+		}
+		if (opCode >= 0x80) {
+			return source != 6;
+		}
+		if (opCode >= 0x40) {
+			return source != 6 && destination != 6; // Also rules out HALT
+		}
+
+		switch (source) {
+		case 0:
+			return opCode == 0x00;
+		case 4: // INC r
+		case 5: // DEC r
+		case 6: // LD r,n
+			return destination != 6;
+		case 7: // Rotates on A, DAA, CPL, SCF, CCF
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// outputs must not overlap inputs. cycles may be null.
+	void Lockstep::execute(const OracleState *inputs, OracleState *outputs, uint8_t *cycles, size_t count) {
+		lanes = 0;
+		for (size_t i = 0; i < count; i++) {
+			const OracleState &input = inputs[i];
+			uint16_t instruction = 0x76;
+			uint8_t operand = 0;
+			if (isOrdered(input.memory)) {
+				uint8_t first = find(input.memory, input.pc);
+				operand = find(input.memory, (uint16_t)(input.pc + 1));
+				instruction = first == 0xCB ? 0x100 | operand : first;
+			}
+
+			if (!isVectorized(instruction)) {
+				uint8_t taken = Oracle::execute(input, outputs[i]);
+				if (cycles != nullptr) {
+					cycles[i] = taken;
+				}
+				continue;
+			}
+
+			if (lanes == Lanes || (lanes > 0 && instruction != opCode)) {
+				flush(inputs, outputs, cycles);
+			}
+
+			unsigned int lane = lanes++;
+			opCode = instruction;
+			indices[lane] = i;
+			registers[0][lane] = input.b;
+			registers[1][lane] = input.c;
+			registers[2][lane] = input.d;
+			registers[3][lane] = input.e;
+			registers[4][lane] = input.h;
+			registers[5][lane] = input.l;
+			registers[Immediate][lane] = operand;
+			registers[A][lane] = input.a;
+			flags[lane] = (input.zero ? ZeroFlag : 0) | (input.subtract ? SubFlag : 0)
+				| (input.halfCarry ? HalfCarryFlag : 0) | (input.carry ? CarryFlag : 0);
+		}
+
+		if (lanes > 0) {
+			flush(inputs, outputs, cycles);
+		}
+	}
+
+	// Runs the batch and writes each lane back to its output
+	void Lockstep::flush(const OracleState *inputs, OracleState *outputs, uint8_t *cycles) {
+		run(opCode);
+
+		bool cb = opCode >= 0x100;
+		uint8_t taken = cb ? Core::opCodeCBCycles[opCode & 0xFF] : Core::opCodeCycles[opCode];
+		uint16_t length = cb || (opCode & 0x07) == 6 ? 2 : 1;
+		for (unsigned int lane = 0; lane < lanes; lane++) {
+			const OracleState &input = inputs[indices[lane]];
+			OracleState &output = outputs[indices[lane]];
+			output.a = registers[A][lane];
+			output.b = registers[0][lane];
+			output.c = registers[1][lane];
+			output.d = registers[2][lane];
+			output.e = registers[3][lane];
+			output.h = registers[4][lane];
+			output.l = registers[5][lane];
+			output.sp = input.sp;
+			output.pc = input.pc + length;
+			output.zero = (flags[lane] & ZeroFlag) != 0;
+			output.subtract = (flags[lane] & SubFlag) != 0;
+			output.halfCarry = (flags[lane] & HalfCarryFlag) != 0;
+			output.carry = (flags[lane] & CarryFlag) != 0;
+			output.ime = input.ime;
+			output.memory = input.memory;
+			if (cycles != nullptr) {
+				cycles[indices[lane]] = taken;
+			}
+		}
+		lanes = 0;
+	}
+
+	// Every loop covers all Lanes, lanes past the batch hold stale values
+	// that are never written back. A fixed trip count leaves the compiler
+	// nothing to peel.
+	void Lockstep::run(uint16_t opCode) {
+		unsigned int source = opCode & 0x07;
+		unsigned int destination = (opCode >> 3) & 0x07;
+		if (opCode >= 0x100) {
+			runCB(opCode & 0xFF);
+		}
+		else if (opCode >= 0x80) {
+			runAlu(destination, registers[opCode >= 0xC0 ? Immediate : source]);
+		}
+		else if (opCode >= 0x40) {
+			if (source != destination) {
+				memcpy(registers[destination], registers[source], Lanes);
+			}
+		}
+		else if (source == 4) {
+			uint8_t *r = registers[destination];
+			for (unsigned int i = 0; i < Lanes; i++) {
+				uint8_t n = r[i];
+				r[i] = n + 1;
+				flags[i] = (flags[i] & CarryFlag) | zero(r[i]) | ((n & 0x0F) == 0x0F ? HalfCarryFlag : 0);
+			}
+		}
+		else if (source == 5) {
+			uint8_t *r = registers[destination];
+			for (unsigned int i = 0; i < Lanes; i++) {
+				uint8_t n = r[i];
+				r[i] = n - 1;
+				flags[i] = (flags[i] & CarryFlag) | zero(r[i]) | SubFlag | ((n & 0x0F) == 0 ? HalfCarryFlag : 0);
+			}
+		}
+		else if (source == 6) {
+			memcpy(registers[destination], registers[Immediate], Lanes);
+		}
+		else if (source == 7) {
+			runAccumulator(destination);
+		}
+	}
+
+	// ADD ADC SUB SBC AND XOR OR CP, in encoding order. Half carry and
+	// carry are bits 4 and 8 of a ^ n ^ result and result, which holds for
+	// borrows as well since result wraps.
+	void Lockstep::runAlu(unsigned int operation, const uint8_t *n) {
+		uint8_t *a = registers[A];
+		switch (operation) {
+		case 0:
+			for (unsigned int i = 0; i < Lanes; i++) {
+				unsigned int result = a[i] + n[i];
+				flags[i] = zero((uint8_t)result) | (((a[i] ^ n[i] ^ result) & 0x10) << 1) | ((result >> 4) & CarryFlag);
+				a[i] = result;
+			}
+			break;
+		case 1:
+			for (unsigned int i = 0; i < Lanes; i++) {
+				unsigned int result = a[i] + n[i] + ((flags[i] >> 4) & 0x01);
+				flags[i] = zero((uint8_t)result) | (((a[i] ^ n[i] ^ result) & 0x10) << 1) | ((result >> 4) & CarryFlag);
+				a[i] = result;
+			}
+			break;
+		case 2:
+			for (unsigned int i = 0; i < Lanes; i++) {
+				unsigned int result = a[i] - n[i];
+				flags[i] = zero((uint8_t)result) | SubFlag | (((a[i] ^ n[i] ^ result) & 0x10) << 1) | ((result >> 4) & CarryFlag);
+				a[i] = result;
+			}
+			break;
+		case 3:
+			for (unsigned int i = 0; i < Lanes; i++) {
+				unsigned int result = a[i] - n[i] - ((flags[i] >> 4) & 0x01);
+				flags[i] = zero((uint8_t)result) | SubFlag | (((a[i] ^ n[i] ^ result) & 0x10) << 1) | ((result >> 4) & CarryFlag);
+				a[i] = result;
+			}
+			break;
+		case 4:
+			for (unsigned int i = 0; i < Lanes; i++) {
+				a[i] &= n[i];
+				flags[i] = zero(a[i]) | HalfCarryFlag;
+			}
+			break;
+		case 5:
+			for (unsigned int i = 0; i < Lanes; i++) {
+				a[i] ^= n[i];
+				flags[i] = zero(a[i]);
+			}
+			break;
+		case 6:
+			for (unsigned int i = 0; i < Lanes; i++) {
+				a[i] |= n[i];
+				flags[i] = zero(a[i]);
+			}
+			break;
+		default:
+			for (unsigned int i = 0; i < Lanes; i++) {
+				unsigned int result = a[i] - n[i];
+				flags[i] = zero((uint8_t)result) | SubFlag | (((a[i] ^ n[i] ^ result) & 0x10) << 1) | ((result >> 4) & CarryFlag);
+			}
+			break;
+		}
+	}
+
+	// RLCA RRCA RLA RRA DAA CPL SCF CCF, in encoding order
+	void Lockstep::runAccumulator(unsigned int operation) {
+		uint8_t *a = registers[A];
+		switch (operation) {
+		case 0:
+		case 1:
+		case 2:
+		case 3:
+			// As their CB forms, except that zero is always cleared
+			runRotate(operation, a);
+			for (unsigned int i = 0; i < Lanes; i++) {
+				flags[i] &= ~ZeroFlag;
+			}
+			break;
+		case 4:
+			for (unsigned int i = 0; i < Lanes; i++) {
+				int value = a[i];
+				uint8_t f = flags[i];
+				if (!(f & SubFlag)) {
+					value += (f & HalfCarryFlag) || (value & 0x0F) > 9 ? 0x06 : 0;
+					value += (f & CarryFlag) || value > 0x9F ? 0x60 : 0;
+				}
+				else {
+					value = (f & HalfCarryFlag) ? (value - 0x06) & 0xFF : value;
+					value -= (f & CarryFlag) ? 0x60 : 0;
+				}
+				// Carry is only ever set, never cleared
+				flags[i] = (f & (SubFlag | CarryFlag)) | ((value & 0x100) ? CarryFlag : 0) | zero((uint8_t)value);
+				a[i] = value;
+			}
+			break;
+		case 5:
+			for (unsigned int i = 0; i < Lanes; i++) {
+				a[i] ^= 0xFF;
+				flags[i] |= SubFlag | HalfCarryFlag;
+			}
+			break;
+		case 6:
+			for (unsigned int i = 0; i < Lanes; i++) {
+				flags[i] = (flags[i] & ZeroFlag) | CarryFlag;
+			}
+			break;
+		default:
+			for (unsigned int i = 0; i < Lanes; i++) {
+				flags[i] = (flags[i] & (ZeroFlag | CarryFlag)) ^ CarryFlag;
+			}
+			break;
+		}
+	}
+
+	void Lockstep::runCB(uint8_t opCode) {
+		unsigned int bit = (opCode >> 3) & 0x07;
+		uint8_t *r = registers[opCode & 0x07];
+		uint8_t mask = 0x01 << bit;
+		switch (opCode >> 6) {
+		case 0:
+			runRotate(bit, r);
+			break;
+		case 1:
+			for (unsigned int i = 0; i < Lanes; i++) {
+				flags[i] = (flags[i] & CarryFlag) | HalfCarryFlag | zero(r[i] & mask);
+			}
+			break;
+		case 2:
+			for (unsigned int i = 0; i < Lanes; i++) {
+				r[i] &= ~mask;
+			}
+			break;
+		default:
+			for (unsigned int i = 0; i < Lanes; i++) {
+				r[i] |= mask;
+			}
+			break;
+		}
+	}
+
+	// RLC RRC RL RR SLA SRA SWAP SRL, in encoding order
+	void Lockstep::runRotate(unsigned int operation, uint8_t *r) {
+		switch (operation) {
+		case 0:
+			for (unsigned int i = 0; i < Lanes; i++) {
+				uint8_t n = r[i];
+				r[i] = (n << 1) | (n >> 7);
+				flags[i] = zero(r[i]) | ((n >> 3) & CarryFlag);
+			}
+			break;
+		case 1:
+			for (unsigned int i = 0; i < Lanes; i++) {
+				uint8_t n = r[i];
+				r[i] = (n >> 1) | (n << 7);
+				flags[i] = zero(r[i]) | ((n & 0x01) << 4);
+			}
+			break;
+		case 2:
+			for (unsigned int i = 0; i < Lanes; i++) {
+				uint8_t n = r[i];
+				r[i] = (n << 1) | ((flags[i] >> 4) & 0x01);
+				flags[i] = zero(r[i]) | ((n >> 3) & CarryFlag);
+			}
+			break;
+		case 3:
+			for (unsigned int i = 0; i < Lanes; i++) {
+				uint8_t n = r[i];
+				r[i] = (n >> 1) | ((flags[i] & CarryFlag) << 3);
+				flags[i] = zero(r[i]) | ((n & 0x01) << 4);
+			}
+			break;
+		case 4:
+			for (unsigned int i = 0; i < Lanes; i++) {
+				uint8_t n = r[i];
+				r[i] = n << 1;
+				flags[i] = zero(r[i]) | ((n >> 3) & CarryFlag);
+			}
+			break;
+		case 5:
+			for (unsigned int i = 0; i < Lanes; i++) {
+				uint8_t n = r[i];
+				r[i] = (n & 0x80) | (n >> 1);
+				flags[i] = zero(r[i]) | ((n & 0x01) << 4);
+			}
+			break;
+		case 6:
+			for (unsigned int i = 0; i < Lanes; i++) {
+				r[i] = (r[i] << 4) | (r[i] >> 4);
+				flags[i] = zero(r[i]);
+			}
+			break;
+		default:
+			for (unsigned int i = 0; i < Lanes; i++) {
+				uint8_t n = r[i];
+				r[i] = n >> 1;
+				flags[i] = zero(r[i]) | ((n & 0x01) << 4);
+			}
+			break;
+		}
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+#include "oracle.h"
+
+namespace gameboy {
+	// Runs single oracle instructions for many states at once. Registers and
+	// flags for up to Lanes states are kept in structure of arrays form and
+	// one instruction runs across every lane with plain loops over the
+	// arrays, which the compiler turns into vector code, flag math included.
+	//
+	// Only instructions that touch nothing but registers and their immediate
+	// operand are vectorized (isVectorized). Anything that reads or writes
+	// memory through a register, moves pc or sp by more than its length, or
+	// comes with memory records out of address order runs through
+	// Oracle::execute instead. Results match Oracle::execute either way.
+	//
+	// Consecutive inputs with the same instruction share a batch, so sweeps
+	// of one opcode over many states run Lanes at a time.
+	class GAMEBOY_API Lockstep {
+	public:
+		static const unsigned int Lanes = 32;
+
+		explicit Lockstep();
+		virtual ~Lockstep();
+
+		void execute(const OracleState *inputs, OracleState *outputs, uint8_t *cycles, size_t count);
+		static bool isVectorized(uint16_t opCode);
+
+	private:
+		Lockstep(const Lockstep &other);
+		Lockstep &operator=(const Lockstep &other);
+
+		void flush(const OracleState *inputs, OracleState *outputs, uint8_t *cycles);
+		void run(uint16_t opCode);
+		void runAlu(unsigned int operation, const uint8_t *n);
+		void runAccumulator(unsigned int operation);
+		void runCB(uint8_t opCode);
+		void runRotate(unsigned int operation, uint8_t *r);
+
+		uint8_t registers[8][Lanes]; // In instruction encoding order, B C D E H L - A. Row 6 holds the immediate operand.
+		uint8_t flags[Lanes]; // Laid out as in F
+		size_t indices[Lanes]; // Input each lane came from
+		unsigned int lanes;
+		uint16_t opCode; // 0x100-0x1FF is a CB instruction
+	};
+}
\ No newline at end of file
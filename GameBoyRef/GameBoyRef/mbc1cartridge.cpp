@@ -0,0 +1,64 @@
+#include "mbc1cartridge.h"
+
+#include "memory.h"
+#include "savestate.h"
+
+namespace gameboy {
+	Mbc1Cartridge::Mbc1Cartridge(std::shared_ptr<const Rom> rom, unsigned int ramSize) :
+		Cartridge(rom, ramSize) {
+		ramEnabled = false;
+		bankLow = 1;
+		bankHigh = 0;
+		mode = 0;
+	}
+
+	Cartridge *Mbc1Cartridge::clone() const {
+		return new Mbc1Cartridge(*this);
+	}
+
+	void Mbc1Cartridge::write(uint16_t address, uint8_t value) {
+		if (address <= 0x1FFF) {
+			enableRam((value & 0x0F) == 0x0A);
+			mapRam(ramBank);
+		}
+		else if (address <= 0x3FFF) {
+			bankLow = value & 0x1F;
+			mapRomBanks();
+		}
+		else if (address <= 0x5FFF) {
+			bankHigh = value & 0x03;
+			map();
+		}
+		else {
+			mode = value & 0x01;
+			map();
+		}
+	}
+
+	void Mbc1Cartridge::saveState(SaveState &state) const {
+		Cartridge::saveState(state);
+		state.cartridge.romBank = (bankHigh << 5) | bankLow;
+		state.cartridge.mode = mode;
+	}
+
+	void Mbc1Cartridge::loadState(const SaveState &state) {
+		bankLow = state.cartridge.romBank & 0x1F;
+		bankHigh = (state.cartridge.romBank >> 5) & 0x03;
+		mode = state.cartridge.mode;
+		Cartridge::loadState(state);
+	}
+
+	void Mbc1Cartridge::map() {
+		mapRomBanks();
+		ramBank = mode ? bankHigh : 0;
+		mapRam(ramBank);
+	}
+
+	// Bank 0x00, 0x20, 0x40 and 0x60 can't be selected in the switchable
+	// window, writing 0 to the low bits selects the next bank instead
+	void Mbc1Cartridge::mapRomBanks() {
+		romBank = (bankHigh << 5) | (bankLow == 0 ? 1 : bankLow);
+		memory->mapRomBank(0x0000, mode ? bankHigh << 5 : 0);
+		memory->mapRomBank(0x4000, romBank);
+	}
+}
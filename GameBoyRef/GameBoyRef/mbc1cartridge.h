@@ -0,0 +1,25 @@
+#pragma once
+
+#include "cartridge.h"
+
+namespace gameboy {
+	class Mbc1Cartridge : public Cartridge {
+	public:
+		explicit Mbc1Cartridge(std::shared_ptr<const Rom> rom, unsigned int ramSize);
+
+		Cartridge *clone() const override;
+		void write(uint16_t address, uint8_t value) override;
+		void saveState(SaveState &state) const override;
+		void loadState(const SaveState &state) override;
+
+	protected:
+		void map() override;
+
+	private:
+		void mapRomBanks();
+
+		uint8_t bankLow;
+		uint8_t bankHigh;
+		uint8_t mode;
+	};
+}
\ No newline at end of file
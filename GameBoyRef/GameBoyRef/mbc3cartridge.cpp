@@ -0,0 +1,166 @@
+#include "mbc3cartridge.h"
+
+#include <cstring>
+#include "memory.h"
+#include "savestate.h"
+
+namespace gameboy {
+	static const uint64_t SecondsPerDay = 86400;
+
+	Mbc3Cartridge::Mbc3Cartridge(std::shared_ptr<const Rom> rom, unsigned int ramSize, bool hasRtc) :
+		Cartridge(rom, ramSize),
+		hasRtc(hasRtc) {
+		ramEnabled = false;
+		rtcSelect = 0;
+		rtcLatch = 0xFF;
+		rtcFlags = 0;
+		rtcSeconds = 0;
+		rtcClock = 0;
+		memset(rtcLatched, 0, sizeof(rtcLatched));
+		memset(rtcPage, 0, sizeof(rtcPage));
+	}
+
+	Cartridge *Mbc3Cartridge::clone() const {
+		return new Mbc3Cartridge(*this);
+	}
+
+	void Mbc3Cartridge::write(uint16_t address, uint8_t value) {
+		if (address <= 0x1FFF) {
+			enableRam((value & 0x0F) == 0x0A);
+			map();
+		}
+		else if (address <= 0x3FFF) {
+			romBank = value & 0x7F;
+			if (romBank == 0) {
+				romBank = 1;
+			}
+			memory->mapRomBank(0x4000, romBank);
+		}
+		else if (address <= 0x5FFF) {
+			if (value <= 0x03) {
+				ramBank = value;
+				rtcSelect = 0;
+			}
+			else if (hasRtc && value >= 0x08 && value <= 0x0C) {
+				rtcSelect = value;
+			}
+			map();
+		}
+		else {
+			// Writing 0 then 1 copies the running clock into the readable registers
+			if (hasRtc && rtcLatch == 0x00 && value == 0x01) {
+				latch();
+				if (rtcSelect != 0) {
+					mapRtc();
+				}
+			}
+			rtcLatch = value;
+		}
+	}
+
+	void Mbc3Cartridge::writeRam(uint16_t address, uint8_t value) {
+		if (rtcSelect == 0) {
+			Cartridge::writeRam(address, value);
+			return;
+		}
+
+		if (!ramEnabled) {
+			return;
+		}
+
+		uint64_t seconds = getSeconds();
+		uint64_t days = seconds / SecondsPerDay;
+		uint64_t s = seconds % 60;
+		uint64_t m = (seconds / 60) % 60;
+		uint64_t h = (seconds / 3600) % 24;
+
+		switch (rtcSelect) {
+		case 0x08: s = value % 60; break;
+		case 0x09: m = value % 60; break;
+		case 0x0A: h = value % 24; break;
+		case 0x0B: days = (days & 0x100) | value; break;
+		case 0x0C:
+			// The time was read above, so setSeconds below freezes it when halting
+			// and restarts counting from now when resuming
+			days = (days & 0xFF) | ((value & 0x01) << 8);
+			rtcFlags = value & 0xC0;
+			break;
+		}
+
+		setSeconds(((days * 24 + h) * 60 + m) * 60 + s);
+		rtcLatched[rtcSelect - 0x08] = value;
+		mapRtc();
+	}
+
+	void Mbc3Cartridge::saveState(SaveState &state) const {
+		Cartridge::saveState(state);
+		CartridgeState &cartridge = state.cartridge;
+		cartridge.mode = rtcSelect;
+		cartridge.rtcLatch = rtcLatch;
+		cartridge.rtcFlags = rtcFlags;
+		memcpy(cartridge.rtcLatched, rtcLatched, sizeof(rtcLatched));
+		cartridge.rtcSeconds = rtcSeconds;
+		cartridge.rtcClock = rtcClock;
+	}
+
+	void Mbc3Cartridge::loadState(const SaveState &state) {
+		const CartridgeState &cartridge = state.cartridge;
+		rtcSelect = cartridge.mode;
+		rtcLatch = cartridge.rtcLatch;
+		rtcFlags = cartridge.rtcFlags;
+		memcpy(rtcLatched, cartridge.rtcLatched, sizeof(rtcLatched));
+		rtcSeconds = cartridge.rtcSeconds;
+		rtcClock = cartridge.rtcClock;
+		Cartridge::loadState(state);
+	}
+
+	void Mbc3Cartridge::map() {
+		memory->mapRomBank(0x0000, 0);
+		memory->mapRomBank(0x4000, romBank);
+		if (rtcSelect != 0 && ramEnabled) {
+			mapRtc();
+		}
+		else {
+			mapRam(ramBank);
+		}
+	}
+
+	uint64_t Mbc3Cartridge::getSeconds() const {
+		if ((rtcFlags & 0x40) != 0 || clock == nullptr) {
+			return rtcSeconds;
+		}
+
+		return rtcSeconds + (*clock - rtcClock) / CyclesPerSecond;
+	}
+
+	void Mbc3Cartridge::setSeconds(uint64_t seconds) {
+		rtcSeconds = seconds;
+		rtcClock = clock != nullptr ? *clock : 0;
+	}
+
+	void Mbc3Cartridge::latch() {
+		uint64_t seconds = getSeconds();
+		uint64_t days = seconds / SecondsPerDay;
+		if (days > 0x1FF) {
+			// The day counter is 9 bits, overflowing sets the carry until cleared
+			rtcFlags |= 0x80;
+			days &= 0x1FF;
+			seconds = days * SecondsPerDay + seconds % SecondsPerDay;
+			setSeconds(seconds);
+		}
+
+		rtcLatched[0] = seconds % 60;
+		rtcLatched[1] = (seconds / 60) % 60;
+		rtcLatched[2] = (seconds / 3600) % 24;
+		rtcLatched[3] = days & 0xFF;
+		rtcLatched[4] = ((days >> 8) & 0x01) | rtcFlags;
+	}
+
+	// Every byte of 0xA000-0xBFFF reads as the selected clock register
+	void Mbc3Cartridge::mapRtc() {
+		memset(rtcPage, rtcLatched[rtcSelect - 0x08], sizeof(rtcPage));
+		for (uint16_t address = 0xA000; address < 0xC000; address += sizeof(rtcPage)) {
+			memory->mapExternal(address, rtcPage, sizeof(rtcPage));
+		}
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "cartridge.h"
+
+namespace gameboy {
+	// MBC3 with the optional real time clock. The clock runs on emulated time
+	// (the Core's cycle counter) so runs and save states stay deterministic.
+	class Mbc3Cartridge : public Cartridge {
+	public:
+		static const uint64_t CyclesPerSecond = 1048576;
+
+		explicit Mbc3Cartridge(std::shared_ptr<const Rom> rom, unsigned int ramSize, bool hasRtc);
+
+		Cartridge *clone() const override;
+		void write(uint16_t address, uint8_t value) override;
+		void writeRam(uint16_t address, uint8_t value) override;
+		void saveState(SaveState &state) const override;
+		void loadState(const SaveState &state) override;
+
+	protected:
+		void map() override;
+
+	private:
+		uint64_t getSeconds() const;
+		void setSeconds(uint64_t seconds);
+		void latch();
+		void mapRtc();
+
+		bool hasRtc;
+		uint8_t rtcSelect; // 0x08-0x0C while a clock register is mapped at 0xA000, 0 for RAM
+		uint8_t rtcLatch;
+		uint8_t rtcFlags; // Halt (bit 6) and day counter carry (bit 7), as in the DH register
+		uint8_t rtcLatched[5];
+		uint64_t rtcSeconds;
+		uint64_t rtcClock;
+		uint8_t rtcPage[0x100];
+	};
+}
\ No newline at end of file
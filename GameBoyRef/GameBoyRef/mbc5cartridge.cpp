@@ -0,0 +1,34 @@
+#include "mbc5cartridge.h"
+
+#include "memory.h"
+
+namespace gameboy {
+	Mbc5Cartridge::Mbc5Cartridge(std::shared_ptr<const Rom> rom, unsigned int ramSize) :
+		Cartridge(rom, ramSize) {
+		ramEnabled = false;
+	}
+
+	Cartridge *Mbc5Cartridge::clone() const {
+		return new Mbc5Cartridge(*this);
+	}
+
+	// Unlike MBC1, the 9 bit ROM bank number is used as is, bank 0 included
+	void Mbc5Cartridge::write(uint16_t address, uint8_t value) {
+		if (address <= 0x1FFF) {
+			enableRam((value & 0x0F) == 0x0A);
+			mapRam(ramBank);
+		}
+		else if (address <= 0x2FFF) {
+			romBank = (romBank & 0x100) | value;
+			memory->mapRomBank(0x4000, romBank);
+		}
+		else if (address <= 0x3FFF) {
+			romBank = (romBank & 0xFF) | ((value & 0x01) << 8);
+			memory->mapRomBank(0x4000, romBank);
+		}
+		else if (address <= 0x5FFF) {
+			ramBank = value & 0x0F;
+			mapRam(ramBank);
+		}
+	}
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "cartridge.h"
+
+namespace gameboy {
+	class Mbc5Cartridge : public Cartridge {
+	public:
+		explicit Mbc5Cartridge(std::shared_ptr<const Rom> rom, unsigned int ramSize);
+
+		Cartridge *clone() const override;
+		void write(uint16_t address, uint8_t value) override;
+	};
+}
\ No newline at end of file
@@ -2,24 +2,122 @@
 
 #include <cmath>
 #include <cstdlib>
+#include <limits>
 #include <cstring>
 #include <vector>
+#include "cartridge.h"
 #include "memoryrecord.h"
+#include "rom.h"
+#include "savestate.h"
 
 namespace gameboy {
-	Memory::Memory()
+	// Shared by every page that has never been written. Neither static page
+	// is reference counted: the count stays at 2 so writes never see them as
+	// owned, and building or freeing a Memory touches no shared atomics.
+	static Page zeroPage(2);
+	// Stands in for pages backed by the cartridge, writes always take the
+	// slow path
+	static Page externalPage(2);
+
+	static bool isStatic(const Page *page) {
+		return page == &zeroPage || page == &externalPage;
+	}
+
+	// What the bus reads where nothing drives it, e.g. disabled cartridge RAM
+	static const struct OpenBus {
+		OpenBus() { memset(data, 0xFF, sizeof(data)); }
+		uint8_t data[0x100];
+	} openBus;
+
+	static const uint16_t NoIo = 0x0001;
+
+	// Registers the DMG doesn't have, reads see open bus and writes go nowhere
+	static class UnusedIo : public IoDevice {
+	public:
+		uint8_t readIo(uint16_t /*address*/) { return 0xFF; }
+		void writeIo(uint16_t /*address*/, uint8_t /*value*/) {}
+	} unusedIo;
+
+	static bool isUnusedIo(uint16_t address) {
+		return address == 0xFF03
+			|| (address >= 0xFF08 && address <= 0xFF0E)
+			|| address == 0xFF15
+			|| address == 0xFF1F
+			|| (address >= 0xFF27 && address <= 0xFF2F)
+			|| address == 0xFF4C
+			|| address == 0xFF4E
+			|| address == 0xFF50
+			|| (address >= 0xFF56 && address <= 0xFF67)
+			|| (address >= 0xFF6C && address <= 0xFF6F)
+			|| address >= 0xFF71;
+	}
+
+	Memory::Memory() :
+		nextEvent(NoEvent),
+		cartridge(nullptr),
+		littleEndian(false),
+		clock(nullptr),
+		dmaEnd(0),
+		ioMask(NoIo)
 	{
-		mem = std::map<uint16_t, uint8_t>();
+		resetIo();
+		for (unsigned int i = 0; i < 0x100; i++) {
+			pages[i] = &zeroPage;
+			readPages[i] = zeroPage.data;
+		}
+	}
+
+	// Copies share every page, the first write to a shared page copies it
+	Memory::Memory(const Memory &other) :
+		nextEvent(other.nextEvent),
+		initMem(other.initMem),
+		rom(other.rom),
+		cartridge(other.cartridge),
+		littleEndian(other.littleEndian),
+		clock(other.clock),
+		dmaEnd(other.dmaEnd),
+		ioMask(other.ioMask) {
+		resetIo(); // Devices belong to the other Memory's owner, they have to map and add themselves again
+		for (unsigned int i = 0; i < 0x100; i++) {
+			if (!isStatic(other.pages[i])) {
+				other.pages[i]->references.fetch_add(1, std::memory_order_relaxed);
+			}
+			pages[i] = other.pages[i];
+			readPages[i] = other.readPages[i];
+		}
+
+		memcpy(high, other.high, sizeof(high));
+		if (readPages[0xFF] == other.high) {
+			readPages[0xFF] = high;
+		}
 	}
 
 	Memory::~Memory() {
+		for (unsigned int i = 0; i < 0x100; i++) {
+			release(pages[i]);
+		}
 	}
 
 	std::vector<MemoryRecord>* Memory::getMemoryRecord() {
 		auto record = new std::vector<MemoryRecord>();
-		for (auto it = mem.begin(); it != mem.end(); ++it)
-		{
-			record->push_back(MemoryRecord{ it->first, it->second });
+		for (unsigned int i = 0; i < 0x100; i++) {
+			Page *page = pages[i];
+			if (page == &zeroPage || page == &externalPage) {
+				continue;
+			}
+
+			for (unsigned int j = 0; j < sizeof(page->allocated); j++) {
+				if (page->allocated[j] == 0) {
+					continue;
+				}
+
+				for (unsigned int bit = 0; bit < 8; bit++) {
+					if (page->allocated[j] & (0x1 << bit)) {
+						uint8_t offset = (j << 3) | bit;
+						record->push_back(MemoryRecord{ (uint16_t)((i << 8) | offset), page->data[offset] });
+					}
+				}
+			}
 		}
 
 		return record;
@@ -29,30 +127,355 @@ namespace gameboy {
 		initMem = *record;
 
 		for (auto it = record->begin(); it != record->end(); ++it) {
-			mem[it->address] = it->value;
+			write(it->address, it->value);
+		}
+	}
+
+	void Memory::saveState(SaveState &state) const {
+		for (unsigned int i = 0; i < 0x100; i++) {
+			// OAM reads are blocked during DMA, save what's really there
+			const uint8_t *data = pages[i] == &externalPage ? readPages[i] : pages[i]->data;
+			memcpy(&state.memory[i << 8], data, sizeof(pages[i]->data));
+			memcpy(&state.allocated[i * sizeof(pages[i]->allocated)], pages[i]->allocated, sizeof(pages[i]->allocated));
+		}
+	}
+
+	void Memory::loadState(const SaveState &state) {
+		for (unsigned int i = 0; i < 0x100; i++) {
+			if (pages[i] == &externalPage) {
+				continue;
+			}
+
+			Page *page = own(i, false);
+			memcpy(page->data, &state.memory[i << 8], sizeof(page->data));
+			memcpy(page->allocated, &state.allocated[i * sizeof(page->allocated)], sizeof(page->allocated));
+			readPages[i] = page->data;
+		}
+
+		if (readPages[0xFF] == high) {
+			memcpy(high, &state.memory[0xFF00], sizeof(high));
+		}
+
+		dmaEnd = 0;
+		nextEvent = 0; // Clocked devices report their next event again
+	}
+
+	unsigned int Memory::getOwnedPageCount() const {
+		unsigned int count = 0;
+		for (unsigned int i = 0; i < 0x100; i++) {
+			if (pages[i]->references.load(std::memory_order_relaxed) == 1) {
+				++count;
+			}
+		}
+
+		return count;
+	}
+
+	// Maps bank 0 at 0x0000 and bank 1 at 0x4000, replacing whatever RAM was
+	// there. The image is shared, not copied.
+	void Memory::mapRom(std::shared_ptr<const Rom> image) {
+		rom = image;
+		for (unsigned int i = 0x00; i < 0x80; i++) {
+			release(pages[i]);
+			pages[i] = &externalPage;
+		}
+
+		mapRomBank(0x0000, 0);
+		mapRomBank(0x4000, 1);
+	}
+
+	void Memory::mapRomBank(uint16_t address, unsigned int bank) {
+		const uint8_t *data = rom->getBank(bank);
+		unsigned int first = address >> 8;
+		for (unsigned int i = 0; i < Rom::BankSize >> 8; i++) {
+			readPages[first + i] = &data[i << 8];
+		}
+	}
+
+	// Hands 0x0000-0x7FFF and 0xA000-0xBFFF to the cartridge. The cartridge
+	// maps its banks once attached, writes to those ranges go to it. Cartridge
+	// code is little endian, unlike the byte order the oracle tests use.
+	// 0xFF00-0xFFFF moves to the slow write path so I/O registers like DMA
+	// work, the oracle tests treat that range as plain RAM.
+	void Memory::mapCartridge(Cartridge *cartridge, const uint64_t *clock) {
+		this->cartridge = cartridge;
+		this->clock = clock;
+		littleEndian = true;
+		mapRom(cartridge->getRom());
+
+		for (unsigned int i = 0xA0; i < 0xC0; i++) {
+			if (pages[i] != &externalPage) {
+				release(pages[i]);
+				pages[i] = &externalPage;
+			}
+		}
+		mapExternal(0xA000, nullptr, Cartridge::RamBankSize);
+
+		ioMask = IoAddress;
+		if (pages[0xFF] != &externalPage) {
+			memcpy(high, pages[0xFF]->data, sizeof(high));
+			release(pages[0xFF]);
+			pages[0xFF] = &externalPage;
+			readPages[0xFF] = high;
+		}
+	}
+
+	// Points reads of size bytes at address to data, or to open bus if data is null
+	void Memory::mapExternal(uint16_t address, const uint8_t *data, unsigned int size) {
+		unsigned int first = address >> 8;
+		for (unsigned int i = 0; i < size >> 8; i++) {
+			readPages[first + i] = data != nullptr ? &data[i << 8] : openBus.data;
+		}
+	}
+
+	// Copies length bytes through the page table, a page at a time. Sources
+	// can be ROM banks, cartridge RAM or plain memory; destinations must be
+	// plain memory. Used by OAM DMA and meant for CGB HDMA as well.
+	void Memory::transfer(uint16_t destination, uint16_t source, unsigned int length) {
+		while (length > 0) {
+			unsigned int sourceOffset = source & 0xFF;
+			unsigned int destinationOffset = destination & 0xFF;
+			unsigned int chunk = 0x100 - (sourceOffset > destinationOffset ? sourceOffset : destinationOffset);
+			if (chunk > length) {
+				chunk = length;
+			}
+
+			Page *page = own(destination >> 8, true);
+			if (page != nullptr) {
+				memcpy(&page->data[destinationOffset], &readPages[source >> 8][sourceOffset], chunk);
+				for (unsigned int i = destinationOffset; i < destinationOffset + chunk; i++) {
+					page->allocated[i >> 3] |= 0x1 << (i & 0x7);
+				}
+			}
+
+			source += chunk;
+			destination += chunk;
+			length -= chunk;
+		}
+	}
+
+	// Runs bus events that are due, called by the core once clock reaches nextEvent
+	void Memory::update(uint64_t clock) {
+		if (dmaEnd != 0 && clock >= dmaEnd) {
+			dmaEnd = 0;
+			readPages[0xFE] = pages[0xFE]->data;
+		}
+
+		nextEvent = dmaEnd != 0 ? dmaEnd : NoEvent;
+		for (auto it = clocked.begin(); it != clocked.end(); ++it) {
+			uint64_t next = (*it)->update(clock);
+			if (next < nextEvent) {
+				nextEvent = next;
+			}
+		}
+	}
+
+	bool Memory::isDmaActive() const {
+		return dmaEnd != 0;
+	}
+
+	bool Memory::isLittleEndian() const {
+		return littleEndian;
+	}
+
+	void Memory::mapIo(uint16_t address, IoDevice *device) {
+		ioDevices[address - IoAddress] = device;
+	}
+
+	void Memory::unmapIo(uint16_t address) {
+		ioDevices[address - IoAddress] = isUnusedIo(address) ? static_cast<IoDevice *>(&unusedIo) : this;
+	}
+
+	// The device's update runs at the next bus event. Not owned, and copies
+	// of this Memory don't inherit it.
+	void Memory::addClocked(ClockedDevice *device) {
+		clocked.push_back(device);
+		nextEvent = 0;
+	}
+
+	// Brings the next update forward to clock, devices call this when a
+	// register write changes when they next need to run. Anything up to the
+	// current clock means after the current instruction.
+	void Memory::schedule(uint64_t clock) {
+		if (clock < nextEvent) {
+			nextEvent = clock;
+		}
+	}
+
+	uint64_t Memory::getClock() const {
+		return clock != nullptr ? *clock : 0;
+	}
+
+	// Sets the bits in IF. The core looks for interrupts to dispatch after
+	// each bus event, so this also makes one due.
+	void Memory::requestInterrupt(uint8_t interrupt) {
+		high[InterruptFlagAddress & 0xFF] |= interrupt;
+		nextEvent = 0;
+	}
+
+	void Memory::acknowledgeInterrupt(uint8_t interrupt) {
+		high[InterruptFlagAddress & 0xFF] &= ~interrupt;
+	}
+
+	// Interrupts both requested and enabled, whether or not IME is set
+	uint8_t Memory::getPendingInterrupts() const {
+		return high[InterruptFlagAddress & 0xFF] & high[InterruptEnableAddress & 0xFF] & 0x1F;
+	}
+
+	// Registers without a device latch whatever was written
+	uint8_t Memory::readIo(uint16_t address) {
+		if (address == InterruptFlagAddress) {
+			return high[address & 0xFF] | 0xE0;
+		}
+		return high[address & 0xFF];
+	}
+
+	void Memory::writeIo(uint16_t address, uint8_t value) {
+		high[address & 0xFF] = value;
+
+		if (address == DmaAddress) {
+			startDma(value);
+		}
+		else if (address == InterruptFlagAddress) {
+			nextEvent = 0;
 		}
 	}
 
 	uint8_t Memory::read(uint16_t address) {
-		if (mem.count(address) == 0) {
-			return 0; // Only writes allocate memory
+		if ((address & 0xFF80) == ioMask) {
+			return ioDevices[address & 0x7F]->readIo(address);
 		}
+		return readPages[address >> 8][address & 0xFF]; // Only writes allocate memory, unallocated addresses read as 0
+	}
 
-		return mem[address];
+	// Reads the 4 bytes at address in one go, the first byte in the low bits.
+	// Within a page that's one unaligned load, crossing a page or touching
+	// 0xFF00-0xFFFF falls back to reading byte by byte. Assumes a little
+	// endian host.
+	uint32_t Memory::fetch(uint16_t address) {
+		if ((address & 0xFF) <= 0xFC && address < 0xFF00) {
+			uint32_t value;
+			memcpy(&value, &readPages[address >> 8][address & 0xFF], sizeof(value));
+			return value;
+		}
+
+		return read(address) | (read(address + 1) << 8) | (read(address + 2) << 16) | ((uint32_t)read(address + 3) << 24);
 	}
 
 	void Memory::write(uint16_t address, uint8_t value) {
-		mem[address] = value;
+		Page *page = pages[address >> 8];
+		if (page->references.load(std::memory_order_acquire) != 1) {
+			page = own(address >> 8, true);
+			if (page == nullptr) {
+				writeExternal(address, value);
+				return;
+			}
+		}
+
+		uint8_t offset = address & 0xFF;
+		page->data[offset] = value;
+		page->allocated[offset >> 3] |= 0x1 << (offset & 0x7);
 	}
 
 	uint16_t Memory::readW(uint16_t address) {
+		if (littleEndian) {
+			uint8_t lo = read(address);
+			uint8_t hi = read(address + 1);
+			return (hi << 8) | lo;
+		}
+
 		uint8_t hi = read(address);
 		uint8_t lo = read(address + 1);
 		return (hi << 8) | lo;
 	}
 
 	void Memory::writeW(uint16_t address, uint16_t value) {
-		mem[address] = (value & 0xFF00) >> 8;
-		mem[address + 1] = value & 0xFF;
+		if (littleEndian) {
+			write(address, value & 0xFF);
+			write(address + 1, (value & 0xFF00) >> 8);
+			return;
+		}
+
+		write(address, (value & 0xFF00) >> 8);
+		write(address + 1, value & 0xFF);
+	}
+
+	void Memory::writeExternal(uint16_t address, uint8_t value) {
+		if (address >= 0xFF00) {
+			writeHigh(address, value);
+			return;
+		}
+
+		if (cartridge == nullptr) {
+			return; // Bare ROM image, writes are dropped
+		}
+
+		if (address <= 0x7FFF) {
+			cartridge->write(address, value);
+		}
+		else {
+			cartridge->writeRam(address, value);
+		}
+	}
+
+	void Memory::writeHigh(uint16_t address, uint8_t value) {
+		if (address < IoAddress + IoSize) {
+			ioDevices[address & 0x7F]->writeIo(address, value);
+		}
+		else {
+			high[address & 0xFF] = value;
+			if (address == InterruptEnableAddress) {
+				nextEvent = 0;
+			}
+		}
+	}
+
+	// OAM DMA copies the whole 160 bytes up front, then blocks OAM reads until
+	// the transfer would have finished. Sources past 0xDFFF read echo RAM.
+	void Memory::startDma(uint8_t source) {
+		if (source >= 0xE0) {
+			source -= 0x20;
+		}
+
+		transfer(0xFE00, source << 8, DmaLength);
+		readPages[0xFE] = openBus.data;
+
+		dmaEnd = getClock() + DmaCycles;
+		schedule(dmaEnd);
+	}
+
+	void Memory::resetIo() {
+		for (unsigned int i = 0; i < IoSize; i++) {
+			unmapIo(IoAddress + i);
+		}
+	}
+
+	// Makes the page at index private to this Memory, copying the shared
+	// contents if requested. Returns null for pages backed by the cartridge.
+	Page *Memory::own(unsigned int index, bool copy) {
+		Page *shared = pages[index];
+		if (shared->references.load(std::memory_order_acquire) == 1) {
+			return shared;
+		}
+		if (shared == &externalPage) {
+			return nullptr;
+		}
+
+		Page *page = new Page();
+		if (copy) {
+			memcpy(page->data, shared->data, sizeof(page->data));
+			memcpy(page->allocated, shared->allocated, sizeof(page->allocated));
+		}
+
+		pages[index] = page;
+		readPages[index] = page->data;
+		release(shared);
+		return page;
+	}
+
+	void Memory::release(Page *page) {
+		if (!isStatic(page) && page->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			delete page;
+		}
 	}
 }
@@ -1,25 +1,96 @@
 #pragma once
 
+#include <atomic>
 #include <cinttypes>
+#include <memory>
 #include <vector>
-#include <map>
+#include "iodevice.h"
 #include "memoryrecord.h"
 
 namespace gameboy {
-	class Memory {
+	struct SaveState;
+	class Rom;
+	class Cartridge;
+
+	// 256 byte block of the address space. Pages are reference counted so a
+	// copied Memory can share them until one side writes.
+	struct Page {
+		Page() : references(1) {}
+		explicit Page(unsigned int references) : references(references) {}
+
+		std::atomic<unsigned int> references;
+		uint8_t data[0x100];
+		uint8_t allocated[0x100 / 8]; // One bit per address, set once the address has been written
+	};
+
+	// Once a cartridge is mapped, 0xFF00-0xFF7F is dispatched through a table
+	// of I/O devices. Registers nobody claimed latch the last value written,
+	// holes in the DMG register map read 0xFF.
+	class Memory : public IoDevice {
 	public:
+		static const uint16_t DmaAddress = 0xFF46;
+		static const unsigned int DmaLength = 0xA0;
+		static const unsigned int DmaCycles = 160;
+		static const uint16_t IoAddress = 0xFF00;
+		static const unsigned int IoSize = 0x80;
+		static const uint16_t InterruptFlagAddress = 0xFF0F;
+		static const uint16_t InterruptEnableAddress = 0xFFFF;
+
 		explicit Memory();
+		Memory(const Memory &other);
 		virtual ~Memory();
 
 		uint8_t read(uint16_t address);
+		uint32_t fetch(uint16_t address);
 		void write(uint16_t address, uint8_t value);
 		uint16_t readW(uint16_t address);
 		void writeW(uint16_t address, uint16_t value);
 		std::vector<MemoryRecord> *getMemoryRecord();
 		void setMemoryRecord(std::vector<MemoryRecord> *record);
+		void saveState(SaveState &state) const;
+		void loadState(const SaveState &state);
+		unsigned int getOwnedPageCount() const;
+		void mapRom(std::shared_ptr<const Rom> image);
+		void mapRomBank(uint16_t address, unsigned int bank);
+		void mapCartridge(Cartridge *cartridge, const uint64_t *clock);
+		void mapExternal(uint16_t address, const uint8_t *data, unsigned int size);
+		void transfer(uint16_t destination, uint16_t source, unsigned int length);
+		void update(uint64_t clock);
+		bool isDmaActive() const;
+		bool isLittleEndian() const;
+		void mapIo(uint16_t address, IoDevice *device);
+		void unmapIo(uint16_t address);
+		void addClocked(ClockedDevice *device);
+		void schedule(uint64_t clock);
+		uint64_t getClock() const;
+		void requestInterrupt(uint8_t interrupt);
+		void acknowledgeInterrupt(uint8_t interrupt);
+		uint8_t getPendingInterrupts() const;
+		uint8_t readIo(uint16_t address);
+		void writeIo(uint16_t address, uint8_t value);
+
+		uint64_t nextEvent; // Clock of the next scheduled bus event, the core calls update once it's reached
 
 	private:
+		Memory &operator=(const Memory &other);
+		void writeExternal(uint16_t address, uint8_t value);
+		void writeHigh(uint16_t address, uint8_t value);
+		void startDma(uint8_t source);
+		void resetIo();
+		Page *own(unsigned int index, bool copy);
+		static void release(Page *page);
+
 		std::vector<MemoryRecord> initMem;
-		std::map<uint16_t, uint8_t> mem;
+		std::shared_ptr<const Rom> rom;
+		Cartridge *cartridge;
+		bool littleEndian;
+		const uint64_t *clock;
+		uint64_t dmaEnd;
+		uint8_t high[0x100]; // 0xFF00-0xFFFF once a cartridge is mapped, writes there go through writeHigh
+		uint16_t ioMask; // IoAddress once I/O dispatch is on, otherwise a value address & 0xFF80 never equals
+		IoDevice *ioDevices[IoSize];
+		std::vector<ClockedDevice *> clocked;
+		const uint8_t *readPages[0x100]; // Where reads for each page come from, RAM page data or a ROM bank
+		Page *pages[0x100];
 	};
 }
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include "oracle.h"
+
+#include <memory>
+#include "core.h"
+#include "cpuregisters.h"
+#include "memory.h"
+
+namespace gameboy {
+	static bool parseNumber(const char *&text, unsigned long limit, unsigned long &value) {
+		const char *start = text;
+		value = 0;
+		while ((unsigned char)(*text - '0') < 10) {
+			value = value * 10 + (*text++ - '0');
+			if (value > limit) {
+				return false;
+			}
+		}
+		return text != start;
+	}
+
+	// Returns false on malformed input, state is left partly filled
+	bool Oracle::parse(const char *text, OracleState &state) {
+		unsigned long values[14];
+		for (unsigned int i = 0; i < 14; i++) {
+			unsigned long limit = i == 7 || i == 8 ? 0xFFFF : i >= 9 ? 1 : 0xFF;
+			if (!parseNumber(text, limit, values[i]) || *text++ != (i < 13 ? '|' : ',')) {
+				return false;
+			}
+		}
+
+		state.a = (uint8_t)values[0];
+		state.b = (uint8_t)values[1];
+		state.c = (uint8_t)values[2];
+		state.d = (uint8_t)values[3];
+		state.e = (uint8_t)values[4];
+		state.h = (uint8_t)values[5];
+		state.l = (uint8_t)values[6];
+		state.sp = (uint16_t)values[7];
+		state.pc = (uint16_t)values[8];
+		state.zero = values[9] != 0;
+		state.subtract = values[10] != 0;
+		state.halfCarry = values[11] != 0;
+		state.carry = values[12] != 0;
+		state.ime = values[13] != 0;
+
+		state.memory.clear();
+		while (*text != '\0' && *text != '\n' && *text != '\r') {
+			unsigned long address, value;
+			if (!parseNumber(text, 0xFFFF, address) || *text++ != ':' || !parseNumber(text, 0xFF, value)) {
+				return false;
+			}
+			state.memory.push_back(MemoryRecord{ (uint16_t)address, (uint8_t)value });
+
+			if (*text == '|') {
+				++text;
+			}
+		}
+		return true;
+	}
+
+	static char *append(char *text, unsigned int value) {
+		char digits[8];
+		char *end = digits + sizeof(digits);
+		char *start = end;
+		do {
+			*--start = '0' + value % 10;
+			value /= 10;
+		} while (value != 0);
+		while (start != end) {
+			*text++ = *start++;
+		}
+		return text;
+	}
+
+	void Oracle::format(const OracleState &state, std::string &text) {
+		const unsigned int values[14] = {
+			state.a, state.b, state.c, state.d, state.e, state.h, state.l, state.sp, state.pc,
+			state.zero, state.subtract, state.halfCarry, state.carry, state.ime
+		};
+
+		// At most 5 + 1 + 3 + 1 characters per memory record
+		text.resize(14 * 6 + state.memory.size() * 10);
+		char *out = &text[0];
+		for (unsigned int i = 0; i < 14; i++) {
+			out = append(out, values[i]);
+			*out++ = i < 13 ? '|' : ',';
+		}
+
+		for (size_t i = 0; i < state.memory.size(); i++) {
+			if (i > 0) {
+				*out++ = '|';
+			}
+			out = append(out, state.memory[i].address);
+			*out++ = ':';
+			out = append(out, state.memory[i].value);
+		}
+		text.resize(out - &text[0]);
+	}
+
+	void Oracle::load(Core &core, const OracleState &state) {
+		std::vector<MemoryRecord> memory(state.memory);
+		core.memory->setMemoryRecord(&memory);
+
+		CPURegisters *registers = core.registers;
+		registers->setA(state.a);
+		registers->setB(state.b);
+		registers->setC(state.c);
+		registers->setD(state.d);
+		registers->setE(state.e);
+		registers->setH(state.h);
+		registers->setL(state.l);
+		registers->setSP(state.sp);
+		registers->pc = state.pc;
+		registers->setZeroFlag(state.zero);
+		registers->setSubFlag(state.subtract);
+		registers->setHalfCarryFlag(state.halfCarry);
+		registers->setCarryFlag(state.carry);
+		registers->setIME(state.ime);
+	}
+
+	void Oracle::store(Core &core, OracleState &state) {
+		CPURegisters *registers = core.registers;
+		state.a = registers->getA();
+		state.b = registers->getB();
+		state.c = registers->getC();
+		state.d = registers->getD();
+		state.e = registers->getE();
+		state.h = registers->getH();
+		state.l = registers->getL();
+		state.sp = registers->getSP();
+		state.pc = registers->pc;
+		state.zero = registers->getZeroFlag();
+		state.subtract = registers->getSubFlag();
+		state.halfCarry = registers->getHalfCarryFlag();
+		state.carry = registers->getCarryFlag();
+		state.ime = registers->getIME();
+
+		std::unique_ptr<std::vector<MemoryRecord>> memory(core.memory->getMemoryRecord());
+		state.memory.swap(*memory);
+	}
+
+	// Runs one instruction on a fresh Core, returns the M-cycles it took
+	uint8_t Oracle::execute(const OracleState &input, OracleState &output) {
+		Core core;
+		load(core, input);
+		core.emulateCycle();
+		store(core, output);
+		return (uint8_t)core.getClock();
+	}
+
+	bool Oracle::equals(const OracleState &a, const OracleState &b) {
+		if (a.a != b.a || a.b != b.b || a.c != b.c || a.d != b.d || a.e != b.e || a.h != b.h || a.l != b.l
+			|| a.sp != b.sp || a.pc != b.pc || a.zero != b.zero || a.subtract != b.subtract
+			|| a.halfCarry != b.halfCarry || a.carry != b.carry || a.ime != b.ime
+			|| a.memory.size() != b.memory.size()) {
+			return false;
+		}
+
+		for (size_t i = 0; i < a.memory.size(); i++) {
+			if (a.memory[i].address != b.memory[i].address || a.memory[i].value != b.memory[i].value) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
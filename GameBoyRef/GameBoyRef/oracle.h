@@ -0,0 +1,50 @@
+#pragma once
+
+#if !defined(_WIN32)
+#define GAMEBOY_API
+#elif defined(GAMEBOYREF_EXPORTS)
+#define GAMEBOY_API __declspec(dllexport) 
+#else
+#define GAMEBOY_API __declspec(dllimport) 
+#endif
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include "memoryrecord.h"
+
+namespace gameboy {
+	class Core;
+
+	// CPU state in the shape the oracle tests use: registers, flags and every
+	// address that has been written, in ascending address order
+	struct OracleState {
+		uint8_t a;
+		uint8_t b;
+		uint8_t c;
+		uint8_t d;
+		uint8_t e;
+		uint8_t h;
+		uint8_t l;
+		uint16_t sp;
+		uint16_t pc;
+		bool zero;
+		bool subtract;
+		bool halfCarry;
+		bool carry;
+		bool ime;
+		std::vector<MemoryRecord> memory;
+	};
+
+	// Conversions between OracleState, the text format Run speaks
+	// ("A|B|C|D|E|H|L|SP|PC|FZ|FN|FH|FC|IME,addr:value|...") and a Core
+	class GAMEBOY_API Oracle {
+	public:
+		static bool parse(const char *text, OracleState &state);
+		static void format(const OracleState &state, std::string &text);
+		static void load(Core &core, const OracleState &state);
+		static void store(Core &core, OracleState &state);
+		static uint8_t execute(const OracleState &input, OracleState &output);
+		static bool equals(const OracleState &a, const OracleState &b);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,277 @@
+#include "oraclecache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+namespace gameboy {
+	// Input memory as a flat image, for input that isn't in address order.
+	// Bytes not in the input read 0 as they do on a fresh Core.
+	struct OracleCacheScratch {
+		uint8_t values[0x10000];
+		uint64_t present[0x10000 / 64];
+	};
+
+	static OracleCacheScratch &scratch() {
+		thread_local std::unique_ptr<OracleCacheScratch> instance(new OracleCacheScratch());
+		return *instance;
+	}
+
+	// Lookups into an input's memory. Input in strictly ascending address
+	// order, which is what Run and the corpus produce, is searched in place;
+	// anything else is spread over the thread's image and cleared again when
+	// the view goes away.
+	class OracleCache::View {
+	public:
+		explicit View(const std::vector<MemoryRecord> &memory) :
+			memory(memory),
+			image(nullptr) {
+			for (size_t i = 1; i < memory.size(); i++) {
+				if (memory[i - 1].address >= memory[i].address) {
+					image = &scratch();
+					break;
+				}
+			}
+
+			if (image != nullptr) {
+				for (auto it = memory.begin(); it != memory.end(); ++it) {
+					image->values[it->address] = it->value;
+					image->present[it->address >> 6] |= (uint64_t)1 << (it->address & 63);
+				}
+			}
+		}
+
+		~View() {
+			if (image != nullptr) {
+				for (auto it = memory.begin(); it != memory.end(); ++it) {
+					image->values[it->address] = 0;
+					image->present[it->address >> 6] = 0;
+				}
+			}
+		}
+
+		bool find(uint16_t address, uint8_t &value) const {
+			if (image != nullptr) {
+				value = image->values[address];
+				return (image->present[address >> 6] >> (address & 63)) & 1;
+			}
+
+			auto it = std::lower_bound(memory.begin(), memory.end(), address, [](const MemoryRecord &a, uint16_t b) { return a.address < b; });
+			bool found = it != memory.end() && it->address == address;
+			value = found ? it->value : 0;
+			return found;
+		}
+
+		// For addresses asked for in ascending order, cursor starts at 0
+		bool findNext(uint16_t address, uint8_t &value, size_t &cursor) const {
+			if (image != nullptr) {
+				return find(address, value);
+			}
+
+			while (cursor < memory.size() && memory[cursor].address < address) {
+				cursor++;
+			}
+			bool found = cursor < memory.size() && memory[cursor].address == address;
+			value = found ? memory[cursor].value : 0;
+			return found;
+		}
+
+		// Input memory with writes laid over it, in address order
+		void overlay(const MemoryRecord *writes, unsigned int count, std::vector<MemoryRecord> &out) const {
+			out.clear();
+			if (image == nullptr) {
+				out.reserve(memory.size() + count);
+				auto it = memory.begin();
+				for (unsigned int i = 0; i < count; i++) {
+					while (it != memory.end() && it->address < writes[i].address) {
+						out.push_back(*it++);
+					}
+					if (it != memory.end() && it->address == writes[i].address) {
+						++it;
+					}
+					out.push_back(writes[i]);
+				}
+				out.insert(out.end(), it, memory.end());
+				return;
+			}
+
+			for (unsigned int i = 0; i < count; i++) {
+				image->values[writes[i].address] = writes[i].value;
+				image->present[writes[i].address >> 6] |= (uint64_t)1 << (writes[i].address & 63);
+			}
+
+			// Collecting clears the image, including the written addresses
+			for (unsigned int i = 0; i < sizeof(image->present) / sizeof(image->present[0]); i++) {
+				uint64_t bits = image->present[i];
+				for (unsigned int bit = 0; bits != 0; bit++, bits >>= 1) {
+					if (bits & 1) {
+						uint16_t address = (uint16_t)(i * 64 + bit);
+						out.push_back(MemoryRecord{ address, image->values[address] });
+						image->values[address] = 0;
+					}
+				}
+				image->present[i] = 0;
+			}
+		}
+
+	private:
+		const std::vector<MemoryRecord> &memory;
+		OracleCacheScratch *image;
+	};
+
+	OracleCache::OracleCache(size_t capacity, unsigned int stripes) :
+		stripeCapacity(capacity / (stripes != 0 ? stripes : 1) + 1),
+		stripes(stripes != 0 ? stripes : 1),
+		hits(0),
+		misses(0) {
+		for (auto it = this->stripes.begin(); it != this->stripes.end(); ++it) {
+			it->index.reserve(stripeCapacity);
+			it->next = 0;
+		}
+	}
+
+	OracleCache::~OracleCache() {
+	}
+
+	// Runs one instruction like Oracle::execute, from the cache when it can
+	uint8_t OracleCache::execute(const OracleState &input, OracleState &output) {
+		View view(input.memory);
+		Key key;
+		makeKey(view, input, key);
+		uint64_t keyHash = hash(key);
+		Stripe &stripe = getStripe(keyHash);
+
+		Entry entry;
+		bool found = false;
+		{
+			std::lock_guard<std::mutex> guard(stripe.mutex);
+			auto it = stripe.index.find(keyHash);
+			if (it != stripe.index.end() && memcmp(&stripe.entries[it->second].key, &key, sizeof(key)) == 0) {
+				entry = stripe.entries[it->second];
+				found = true;
+			}
+		}
+
+		if (found) {
+			hits.fetch_add(1, std::memory_order_relaxed);
+			Corpus::unpack(entry.registers, output);
+			view.overlay(entry.writes, entry.writeCount, output.memory);
+			return entry.cycles;
+		}
+
+		misses.fetch_add(1, std::memory_order_relaxed);
+		entry.cycles = Oracle::execute(input, output);
+		entry.key = key;
+		entry.hash = keyHash;
+		Corpus::pack(output, entry.registers);
+		entry.writeCount = 0;
+
+		// Anything new or changed was written. Output is in address order.
+		size_t cursor = 0;
+		for (auto it = output.memory.begin(); it != output.memory.end(); ++it) {
+			uint8_t value;
+			if (view.findNext(it->address, value, cursor) && value == it->value) {
+				continue;
+			}
+			if (entry.writeCount == MaxWrites) {
+				return entry.cycles;
+			}
+			entry.writes[entry.writeCount++] = *it;
+		}
+
+		std::lock_guard<std::mutex> guard(stripe.mutex);
+		auto it = stripe.index.find(keyHash);
+		size_t slot;
+		if (it != stripe.index.end()) {
+			slot = it->second;
+		}
+		else if (stripe.entries.size() < stripeCapacity) {
+			slot = stripe.entries.size();
+			stripe.entries.push_back(entry);
+			stripe.index[keyHash] = slot;
+		}
+		else {
+			slot = stripe.next;
+			stripe.next = (stripe.next + 1) % stripeCapacity;
+			stripe.index.erase(stripe.entries[slot].hash);
+			stripe.index[keyHash] = slot;
+		}
+		stripe.entries[slot] = entry;
+		return entry.cycles;
+	}
+
+	void OracleCache::clear() {
+		for (auto it = stripes.begin(); it != stripes.end(); ++it) {
+			std::lock_guard<std::mutex> guard(it->mutex);
+			it->index.clear();
+			it->entries.clear();
+			it->next = 0;
+		}
+	}
+
+	uint64_t OracleCache::getHits() const {
+		return hits.load();
+	}
+
+	uint64_t OracleCache::getMisses() const {
+		return misses.load();
+	}
+
+	void OracleCache::getAddresses(const OracleState &input, uint16_t *addresses) {
+		View view(input.memory);
+		getAddresses(view, input, addresses);
+	}
+
+	// Every address a single instruction reads or writes in oracle mode: the
+	// opcode and operands, (BC), (DE), (HL), the stack either side of SP,
+	// (FF00+C), (FF00+n) and (nn) and (nn+1) in either byte order
+	void OracleCache::getAddresses(const View &view, const OracleState &input, uint16_t *addresses) {
+		uint16_t pc = input.pc;
+		uint8_t n, n2;
+		view.find((uint16_t)(pc + 1), n);
+		view.find((uint16_t)(pc + 2), n2);
+		const uint16_t all[KeyAddresses] = {
+			pc, (uint16_t)(pc + 1), (uint16_t)(pc + 2),
+			(uint16_t)(input.b << 8 | input.c), (uint16_t)(input.d << 8 | input.e), (uint16_t)(input.h << 8 | input.l),
+			(uint16_t)(input.sp - 2), (uint16_t)(input.sp - 1), input.sp, (uint16_t)(input.sp + 1),
+			(uint16_t)(0xFF00 | input.c), (uint16_t)(0xFF00 | n),
+			(uint16_t)(n << 8 | n2), (uint16_t)((n << 8 | n2) + 1), (uint16_t)(n2 << 8 | n), (uint16_t)((n2 << 8 | n) + 1)
+		};
+		memcpy(addresses, all, sizeof(all));
+	}
+
+	// Registers, the values at getAddresses and a mask of which of them the
+	// input has
+	void OracleCache::makeKey(const View &view, const OracleState &input, Key &key) {
+		uint8_t bytes[sizeof(Key)] = {};
+		CorpusRegisters registers;
+		Corpus::pack(input, registers);
+		memcpy(bytes, &registers, sizeof(registers));
+
+		uint16_t addresses[KeyAddresses];
+		getAddresses(view, input, addresses);
+		uint16_t mask = 0;
+		for (unsigned int i = 0; i < KeyAddresses; i++) {
+			if (view.find(addresses[i], bytes[sizeof(registers) + i])) {
+				mask |= 1 << i;
+			}
+		}
+		memcpy(bytes + sizeof(registers) + KeyAddresses, &mask, sizeof(mask));
+		static_assert(sizeof(CorpusRegisters) + KeyAddresses + sizeof(uint16_t) <= sizeof(Key), "Key is too small for its contents");
+		memcpy(&key, bytes, sizeof(key));
+	}
+
+	uint64_t OracleCache::hash(const Key &key) {
+		uint64_t h = 0x9E3779B97F4A7C15ULL;
+		for (unsigned int i = 0; i < sizeof(key.words) / sizeof(key.words[0]); i++) {
+			h ^= key.words[i];
+			h *= 0xFF51AFD7ED558CCDULL;
+			h ^= h >> 32;
+		}
+		return h;
+	}
+
+	OracleCache::Stripe &OracleCache::getStripe(uint64_t hash) {
+		return stripes[(hash >> 32) % stripes.size()];
+	}
+}
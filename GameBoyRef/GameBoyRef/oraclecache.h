@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cinttypes>
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "corpus.h"
+#include "oracle.h"
+
+namespace gameboy {
+	// Bounded cache of single instruction results for the oracle. The key is
+	// the input registers plus the value and presence of every address the
+	// instruction at pc could read or write, so states that differ only in
+	// memory the instruction can't reach share an entry. An entry holds the
+	// output registers, the cycles and the bytes written; a hit lays the
+	// writes over the caller's input memory. Entries are spread over
+	// lock-striped maps and evicted oldest first per stripe.
+	class GAMEBOY_API OracleCache {
+	public:
+		static const unsigned int MaxWrites = 4; // Instructions that write more aren't cached
+		static const unsigned int KeyAddresses = 16;
+
+		explicit OracleCache(size_t capacity, unsigned int stripes = 64);
+		virtual ~OracleCache();
+
+		uint8_t execute(const OracleState &input, OracleState &output);
+		void clear();
+		uint64_t getHits() const;
+		uint64_t getMisses() const;
+
+		static void getAddresses(const OracleState &input, uint16_t *addresses);
+
+	private:
+		class View;
+
+		struct Key {
+			uint64_t words[4];
+		};
+
+		struct Entry {
+			Key key;
+			uint64_t hash;
+			CorpusRegisters registers;
+			MemoryRecord writes[MaxWrites];
+			uint8_t writeCount;
+			uint8_t cycles;
+		};
+
+		struct Stripe {
+			std::mutex mutex;
+			std::unordered_map<uint64_t, size_t> index;
+			std::vector<Entry> entries;
+			size_t next; // Slot the next insert takes once the stripe is full
+		};
+
+		OracleCache(const OracleCache &);
+		OracleCache &operator=(const OracleCache &);
+
+		static void getAddresses(const View &view, const OracleState &input, uint16_t *addresses);
+		static void makeKey(const View &view, const OracleState &input, Key &key);
+		static uint64_t hash(const Key &key);
+		Stripe &getStripe(uint64_t hash);
+
+		size_t stripeCapacity;
+		std::vector<Stripe> stripes;
+		std::atomic<uint64_t> hits;
+		std::atomic<uint64_t> misses;
+	};
+}
\ No newline at end of file
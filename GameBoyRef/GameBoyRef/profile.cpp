@@ -0,0 +1,157 @@
+#include "profile.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+namespace gameboy {
+	// Merges every thread's counts, the destructor writes the output file
+	struct OpcodeProfile::Global {
+		~Global() {
+			const char *path = getenv("GAMEBOY_PROFILE_OUTPUT");
+			if (path == nullptr || *path == '\0') {
+				return;
+			}
+
+			std::string name(path);
+			std::ofstream out(name);
+			if (name.size() >= 5 && name.compare(name.size() - 5, 5, ".json") == 0) {
+				profile.writeJson(out);
+			}
+			else {
+				profile.writeCsv(out);
+			}
+		}
+
+		std::mutex mutex;
+		OpcodeProfile profile;
+	};
+
+	// Flushes a thread's counts into the global profile when the thread exits
+	struct OpcodeProfile::Local {
+		~Local();
+		OpcodeProfile profile;
+	};
+
+	OpcodeProfile::Local::~Local() {
+		Global &global = OpcodeProfile::global();
+		std::lock_guard<std::mutex> guard(global.mutex);
+		global.profile.merge(profile);
+	}
+
+	static std::string opCodeName(unsigned int index) {
+		char name[8];
+		snprintf(name, sizeof(name), index >= 0x100 ? "0xCB%02X" : "0x%02X", index & 0xFF);
+		return name;
+	}
+
+	OpcodeProfile::OpcodeProfile() {
+		clear();
+	}
+
+	OpcodeProfile::~OpcodeProfile() {
+	}
+
+	OpcodeProfile::Global &OpcodeProfile::global() {
+		static Global instance;
+		return instance;
+	}
+
+	OpcodeProfile &OpcodeProfile::local() {
+		global(); // Constructed first so it outlives every thread's profile
+		thread_local Local instance;
+		return instance.profile;
+	}
+
+	// Counts merged so far from exited threads plus the calling thread's own
+	OpcodeProfile OpcodeProfile::snapshot() {
+		OpcodeProfile result;
+		{
+			Global &instance = global();
+			std::lock_guard<std::mutex> guard(instance.mutex);
+			result.merge(instance.profile);
+		}
+		result.merge(local());
+		return result;
+	}
+
+	// JR cc, RET cc, JP cc and CALL cc
+	bool OpcodeProfile::isBranch(uint8_t opCode) {
+		switch (opCode) {
+		case 0x20: case 0x28: case 0x30: case 0x38:
+		case 0xC0: case 0xC8: case 0xD0: case 0xD8:
+		case 0xC2: case 0xCA: case 0xD2: case 0xDA:
+		case 0xC4: case 0xCC: case 0xD4: case 0xDC:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	void OpcodeProfile::record(uint8_t opCode, uint8_t cb, uint8_t cycles, bool taken) {
+		unsigned int index = opCode == 0xCB ? 0x100 | cb : opCode;
+		++counts[index];
+		this->cycles[index] += cycles;
+
+		if (isBranch(opCode)) {
+			++(taken ? this->taken : notTaken)[opCode];
+		}
+	}
+
+	void OpcodeProfile::merge(const OpcodeProfile &other) {
+		for (unsigned int i = 0; i < OpcodeCount; i++) {
+			counts[i] += other.counts[i];
+			cycles[i] += other.cycles[i];
+		}
+		for (unsigned int i = 0; i < 0x100; i++) {
+			taken[i] += other.taken[i];
+			notTaken[i] += other.notTaken[i];
+		}
+	}
+
+	void OpcodeProfile::clear() {
+		memset(counts, 0, sizeof(counts));
+		memset(cycles, 0, sizeof(cycles));
+		memset(taken, 0, sizeof(taken));
+		memset(notTaken, 0, sizeof(notTaken));
+	}
+
+	// One row per opcode that ran, branch columns are empty for non-branches
+	void OpcodeProfile::writeCsv(std::ostream &out) const {
+		out << "opcode,count,cycles,taken,not_taken\n";
+		for (unsigned int i = 0; i < OpcodeCount; i++) {
+			if (counts[i] == 0) {
+				continue;
+			}
+
+			out << opCodeName(i) << "," << counts[i] << "," << cycles[i] << ",";
+			if (i < 0x100 && isBranch(i)) {
+				out << taken[i] << "," << notTaken[i];
+			}
+			else {
+				out << ",";
+			}
+			out << "\n";
+		}
+	}
+
+	void OpcodeProfile::writeJson(std::ostream &out) const {
+		out << "{\"opcodes\":[";
+		bool first = true;
+		for (unsigned int i = 0; i < OpcodeCount; i++) {
+			if (counts[i] == 0) {
+				continue;
+			}
+
+			out << (first ? "" : ",") << "{\"opcode\":\"" << opCodeName(i) << "\",\"count\":" << counts[i] << ",\"cycles\":" << cycles[i];
+			if (i < 0x100 && isBranch(i)) {
+				out << ",\"taken\":" << taken[i] << ",\"not_taken\":" << notTaken[i];
+			}
+			out << "}";
+			first = false;
+		}
+		out << "]}\n";
+	}
+}
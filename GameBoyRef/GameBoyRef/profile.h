@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cinttypes>
+#include <mutex>
+#include <ostream>
+
+namespace gameboy {
+	// Execution counts and M-cycles per opcode, CB opcodes at 0x100-0x1FF,
+	// plus taken/not taken counts for conditional branches. Core only records
+	// into it when built with GAMEBOY_PROFILE defined, otherwise none of this
+	// is touched.
+	//
+	// Each thread records into its own profile, merged into the global one when
+	// the thread exits. If GAMEBOY_PROFILE_OUTPUT names a file, the global
+	// profile is written there at shutdown, as JSON if it ends in .json and
+	// CSV otherwise.
+	class OpcodeProfile {
+	public:
+		static const unsigned int OpcodeCount = 0x200;
+
+		explicit OpcodeProfile();
+		virtual ~OpcodeProfile();
+
+		static OpcodeProfile &local();
+		static OpcodeProfile snapshot();
+		static bool isBranch(uint8_t opCode);
+
+		void record(uint8_t opCode, uint8_t cb, uint8_t cycles, bool taken);
+		void merge(const OpcodeProfile &other);
+		void clear();
+		void writeCsv(std::ostream &out) const;
+		void writeJson(std::ostream &out) const;
+
+		uint64_t counts[OpcodeCount];
+		uint64_t cycles[OpcodeCount];
+		uint64_t taken[0x100];
+		uint64_t notTaken[0x100];
+
+	private:
+		struct Global;
+		struct Local;
+		static Global &global();
+	};
+}
\ No newline at end of file
@@ -0,0 +1,284 @@
+#include "rewind.h"
+
+#include <cstring>
+#include "core.h"
+#include "savestate.h"
+
+namespace gameboy {
+	static const unsigned int PendingBuffers = 4;
+
+	Rewind::Rewind(unsigned int interval, unsigned int capacity, unsigned int keyframeInterval) :
+		interval(interval > 0 ? interval : 1),
+		capacity(capacity > 1 ? capacity : 2),
+		keyframeInterval(keyframeInterval) {
+		// A group (keyframe plus its deltas) has to fit in the ring, or inserting
+		// a delta could evict the keyframe it depends on
+		if (this->keyframeInterval == 0 || this->keyframeInterval > this->capacity / 2) {
+			this->keyframeInterval = this->capacity / 2;
+		}
+
+		frames = 0;
+		droppedCount = 0;
+		nextSerial = 0;
+		ringBytes = 0;
+		keyframe = new SaveState;
+		keyframeSerial = 0;
+		sinceKeyframe = 0;
+		needKeyframe = true;
+		busy = false;
+		stopping = false;
+
+		for (unsigned int i = 0; i < PendingBuffers; i++) {
+			freeBuffers.push_back(new SaveState);
+		}
+
+		thread = std::thread(&Rewind::worker, this);
+	}
+
+	Rewind::~Rewind() {
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			stopping = true;
+		}
+		wake.notify_one();
+		thread.join();
+
+		for (auto it = freeBuffers.begin(); it != freeBuffers.end(); ++it) {
+			delete *it;
+		}
+		for (auto it = pending.begin(); it != pending.end(); ++it) {
+			delete *it;
+		}
+		delete keyframe;
+	}
+
+	void Rewind::frame(const Core &core) {
+		if (++frames >= interval) {
+			frames = 0;
+			capture(core);
+		}
+	}
+
+	void Rewind::capture(const Core &core) {
+		SaveState *state;
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			if (freeBuffers.empty()) {
+				++droppedCount; // Never wait on the worker
+				return;
+			}
+
+			state = freeBuffers.back();
+			freeBuffers.pop_back();
+		}
+
+		core.saveState(*state);
+
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			pending.push_back(state);
+		}
+		wake.notify_one();
+	}
+
+	bool Rewind::stepBack(Core &core) {
+		std::unique_lock<std::mutex> guard(mutex);
+		flush(guard);
+
+		if (ring.empty()) {
+			return false;
+		}
+
+		const Snapshot &newest = ring.back();
+		const Snapshot *base = find(newest.keyframe);
+		SaveState *state = freeBuffers.back();
+
+		memset(state, 0, sizeof(SaveState));
+		decompress(base->data, reinterpret_cast<uint8_t *>(state), sizeof(SaveState));
+		if (base != &newest) {
+			decompress(newest.data, reinterpret_cast<uint8_t *>(state), sizeof(SaveState));
+		}
+
+		bool loaded = core.loadState(*state);
+
+		if (newest.serial == keyframeSerial) {
+			needKeyframe = true;
+		}
+		ringBytes -= newest.data.size();
+		ring.pop_back();
+
+		return loaded;
+	}
+
+	void Rewind::clear() {
+		std::unique_lock<std::mutex> guard(mutex);
+		flush(guard);
+
+		ring.clear();
+		ringBytes = 0;
+		needKeyframe = true;
+	}
+
+	// Snapshots stepBack can go through, waiting for captures still being
+	// compressed so the count doesn't depend on how far behind the worker is
+	unsigned int Rewind::size() {
+		std::unique_lock<std::mutex> guard(mutex);
+		flush(guard);
+		return (unsigned int)ring.size();
+	}
+
+	size_t Rewind::memoryUsage() {
+		std::lock_guard<std::mutex> guard(mutex);
+		return ringBytes + (PendingBuffers + 1) * sizeof(SaveState);
+	}
+
+	unsigned int Rewind::dropped() {
+		std::lock_guard<std::mutex> guard(mutex);
+		return droppedCount;
+	}
+
+	void Rewind::worker() {
+		std::unique_lock<std::mutex> guard(mutex);
+		while (true) {
+			wake.wait(guard, [this] { return stopping || !pending.empty(); });
+			if (pending.empty()) {
+				break;
+			}
+
+			SaveState *state = pending.front();
+			pending.pop_front();
+			busy = true;
+
+			Snapshot snapshot;
+			snapshot.serial = nextSerial++;
+			bool isKeyframe = needKeyframe || sinceKeyframe + 1 >= keyframeInterval || find(keyframeSerial) == nullptr;
+
+			guard.unlock();
+			const uint8_t *current = reinterpret_cast<const uint8_t *>(state);
+			if (isKeyframe) {
+				compress(current, nullptr, sizeof(SaveState), snapshot.data);
+				memcpy(keyframe, state, sizeof(SaveState));
+			}
+			else {
+				compress(current, reinterpret_cast<const uint8_t *>(keyframe), sizeof(SaveState), snapshot.data);
+			}
+			guard.lock();
+
+			if (isKeyframe) {
+				keyframeSerial = snapshot.serial;
+				sinceKeyframe = 0;
+				needKeyframe = false;
+			}
+			else {
+				++sinceKeyframe;
+			}
+			snapshot.keyframe = keyframeSerial;
+
+			insert(snapshot);
+			freeBuffers.push_back(state);
+			busy = false;
+			idle.notify_all();
+		}
+	}
+
+	void Rewind::flush(std::unique_lock<std::mutex> &guard) {
+		idle.wait(guard, [this] { return pending.empty() && !busy; });
+	}
+
+	void Rewind::insert(Snapshot &snapshot) {
+		ringBytes += snapshot.data.size();
+		ring.push_back(std::move(snapshot));
+
+		while (ring.size() > capacity) {
+			ringBytes -= ring.front().data.size();
+			ring.pop_front();
+
+			// Deltas are useless once their keyframe is gone
+			while (!ring.empty() && ring.front().keyframe != ring.front().serial) {
+				ringBytes -= ring.front().data.size();
+				ring.pop_front();
+			}
+		}
+	}
+
+	const Rewind::Snapshot *Rewind::find(uint64_t serial) const {
+		for (auto it = ring.rbegin(); it != ring.rend(); ++it) {
+			if (it->serial == serial) {
+				return &*it;
+			}
+		}
+
+		return nullptr;
+	}
+
+	static void putLength(std::vector<uint8_t> &out, size_t value) {
+		while (value >= 0x80) {
+			out.push_back((uint8_t)(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back((uint8_t)value);
+	}
+
+	static size_t getLength(const uint8_t *&in) {
+		size_t value = 0;
+		unsigned int shift = 0;
+		while (*in & 0x80) {
+			value |= (size_t)(*in++ & 0x7F) << shift;
+			shift += 7;
+		}
+		value |= (size_t)(*in++) << shift;
+		return value;
+	}
+
+	// Encodes current XOR base (base may be null) as a series of
+	// [zero run length][literal length][literal bytes] records.
+	void Rewind::compress(const uint8_t *current, const uint8_t *base, size_t size, std::vector<uint8_t> &out) {
+		auto delta = [current, base](size_t i) { return (uint8_t)(current[i] ^ (base != nullptr ? base[i] : 0)); };
+
+		out.clear();
+		size_t i = 0;
+		while (i < size) {
+			size_t start = i;
+			while (i < size && delta(i) == 0) {
+				++i;
+			}
+			size_t zeros = i - start;
+
+			// Only end a literal on a zero run long enough to pay for a new record
+			start = i;
+			while (i < size) {
+				if (delta(i) == 0) {
+					size_t run = 1;
+					while (run < 4 && i + run < size && delta(i + run) == 0) {
+						++run;
+					}
+					if (run == 4 || i + run == size) {
+						break;
+					}
+				}
+				++i;
+			}
+
+			putLength(out, zeros);
+			putLength(out, i - start);
+			for (size_t j = start; j < i; j++) {
+				out.push_back(delta(j));
+			}
+		}
+	}
+
+	// XORs the encoded bytes into out, so decoding onto zeroed memory gives
+	// a keyframe and decoding onto a keyframe gives the snapshot.
+	void Rewind::decompress(const std::vector<uint8_t> &in, uint8_t *out, size_t size) {
+		const uint8_t *pos = in.data();
+		const uint8_t *end = pos + in.size();
+		size_t i = 0;
+		while (pos < end && i < size) {
+			i += getLength(pos);
+			size_t literals = getLength(pos);
+			for (size_t j = 0; j < literals; j++) {
+				out[i++] ^= *pos++;
+			}
+		}
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cinttypes>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "core.h"
+
+namespace gameboy {
+	struct SaveState;
+
+	// Keeps a bounded history of Core snapshots for stepping backwards.
+	// Snapshots are taken on the emulation thread with a single saveState into a
+	// preallocated buffer; XOR delta encoding against the last keyframe and
+	// run-length compression happen on a background thread. If the worker falls
+	// behind, snapshots are dropped rather than stalling the caller.
+	class GAMEBOY_API Rewind {
+	public:
+		explicit Rewind(unsigned int interval, unsigned int capacity, unsigned int keyframeInterval);
+		virtual ~Rewind();
+
+		void frame(const Core &core);
+		void capture(const Core &core);
+		bool stepBack(Core &core);
+		void clear();
+		unsigned int size();
+		size_t memoryUsage();
+		unsigned int dropped();
+
+	private:
+		struct Snapshot {
+			uint64_t serial;
+			uint64_t keyframe; // Serial of the keyframe this snapshot is a delta of, equal to serial for keyframes
+			std::vector<uint8_t> data;
+		};
+
+		void worker();
+		void flush(std::unique_lock<std::mutex> &lock);
+		void insert(Snapshot &snapshot);
+		const Snapshot *find(uint64_t serial) const;
+		static void compress(const uint8_t *current, const uint8_t *base, size_t size, std::vector<uint8_t> &out);
+		static void decompress(const std::vector<uint8_t> &in, uint8_t *out, size_t size);
+
+		unsigned int interval;
+		unsigned int capacity;
+		unsigned int keyframeInterval;
+		unsigned int frames;
+		unsigned int droppedCount;
+		uint64_t nextSerial;
+
+		std::vector<SaveState *> freeBuffers;
+		std::deque<SaveState *> pending;
+		std::deque<Snapshot> ring;
+		size_t ringBytes;
+
+		SaveState *keyframe;
+		uint64_t keyframeSerial;
+		unsigned int sinceKeyframe;
+		bool needKeyframe;
+
+		bool busy;
+		bool stopping;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable idle;
+		std::thread thread;
+	};
+}
\ No newline at end of file
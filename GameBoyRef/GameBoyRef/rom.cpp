@@ -0,0 +1,189 @@
+#include "rom.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace gameboy {
+	static std::mutex cacheLock;
+	static std::map<std::string, std::weak_ptr<const Rom>> cache;
+
+	// Absolute path with . and .. and links resolved, so every spelling of a
+	// file shares one cache entry. Falls back to path if it can't be resolved.
+	static std::string canonical(const std::string &path) {
+#ifdef _WIN32
+		char resolved[MAX_PATH];
+		DWORD length = GetFullPathNameA(path.c_str(), MAX_PATH, resolved, nullptr);
+		return length > 0 && length < MAX_PATH ? std::string(resolved, length) : path;
+#else
+		char *resolved = realpath(path.c_str(), nullptr);
+		if (resolved == nullptr) {
+			return path;
+		}
+		std::string result(resolved);
+		free(resolved);
+		return result;
+#endif
+	}
+
+	// Returns the already loaded image for path if any Core still holds it,
+	// otherwise maps or reads the file. Returns null if the file can't be read.
+	// Entries for images nobody holds any more are dropped on the way.
+	std::shared_ptr<const Rom> Rom::open(const std::string &path) {
+		std::string key = canonical(path);
+		std::lock_guard<std::mutex> guard(cacheLock);
+
+		for (auto it = cache.begin(); it != cache.end();) {
+			if (it->second.expired()) {
+				it = cache.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+
+		// The last holder can let go after the sweep without taking the lock
+		auto found = cache.find(key);
+		std::shared_ptr<const Rom> cached = found != cache.end() ? found->second.lock() : nullptr;
+		if (cached) {
+			return cached;
+		}
+
+		std::shared_ptr<Rom> rom(new Rom());
+		if (!rom->map(path)) {
+			std::ifstream file(path, std::ios::binary | std::ios::ate);
+			if (!file) {
+				return nullptr;
+			}
+
+			auto length = (size_t)file.tellg();
+			file.seekg(0);
+
+			rom->allocate(length);
+			if (!file.read(reinterpret_cast<char *>(rom->buffer), length)) {
+				return nullptr;
+			}
+		}
+
+		cache[key] = rom;
+		return rom;
+	}
+
+	std::shared_ptr<const Rom> Rom::create(const uint8_t *data, size_t size) {
+		std::shared_ptr<Rom> rom(new Rom());
+		rom->allocate(size);
+		memcpy(rom->buffer, data, size);
+		return rom;
+	}
+
+	Rom::Rom() :
+		data(nullptr),
+		buffer(nullptr),
+		mapping(nullptr),
+		size(0),
+		bankCount(0) {
+	}
+
+	Rom::~Rom() {
+		if (mapping != nullptr) {
+#ifdef _WIN32
+			UnmapViewOfFile(mapping);
+#else
+			munmap(mapping, size);
+#endif
+		}
+		delete[] buffer;
+	}
+
+	// Storage is rounded up to whole banks so a bank pointer never runs past
+	// the end of a truncated image
+	void Rom::allocate(size_t size) {
+		this->size = size;
+		bankCount = (unsigned int)((size + BankSize - 1) / BankSize);
+		if (bankCount < 2) {
+			bankCount = 2;
+		}
+
+		buffer = new uint8_t[bankCount * BankSize];
+		memset(buffer, 0xFF, bankCount * BankSize);
+		data = buffer;
+	}
+
+	// Only whole-bank images are mapped, anything else needs padding and is
+	// read into a buffer instead
+	bool Rom::map(const std::string &path) {
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+
+		LARGE_INTEGER length;
+		if (!GetFileSizeEx(file, &length) || length.QuadPart < (LONGLONG)(2 * BankSize) || length.QuadPart % BankSize != 0) {
+			CloseHandle(file);
+			return false;
+		}
+
+		HANDLE view = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (view == nullptr) {
+			return false;
+		}
+
+		mapping = MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(view);
+		if (mapping == nullptr) {
+			return false;
+		}
+
+		size = (size_t)length.QuadPart;
+#else
+		int file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0) {
+			return false;
+		}
+
+		struct stat info;
+		if (fstat(file, &info) != 0 || info.st_size < (off_t)(2 * BankSize) || info.st_size % BankSize != 0) {
+			close(file);
+			return false;
+		}
+
+		void *view = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		close(file);
+		if (view == MAP_FAILED) {
+			return false;
+		}
+
+		mapping = view;
+		size = (size_t)info.st_size;
+#endif
+		bankCount = (unsigned int)(size / BankSize);
+		data = static_cast<const uint8_t *>(mapping);
+		return true;
+	}
+
+	const uint8_t *Rom::getBank(unsigned int bank) const {
+		return &data[(bank % bankCount) * BankSize];
+	}
+
+	unsigned int Rom::getBankCount() const {
+		return bankCount;
+	}
+
+	size_t Rom::getSize() const {
+		return size;
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace gameboy {
+	// Immutable cartridge ROM image. Images are shared between every Core that
+	// opens the same file, each Memory maps the banks straight into its page
+	// table so ROM bytes exist once per process. Files are memory mapped
+	// read-only when possible, so untouched banks are never even read in.
+	class Rom {
+	public:
+		static const size_t BankSize = 0x4000;
+
+		static std::shared_ptr<const Rom> open(const std::string &path);
+		static std::shared_ptr<const Rom> create(const uint8_t *data, size_t size);
+		virtual ~Rom();
+
+		const uint8_t *getBank(unsigned int bank) const;
+		unsigned int getBankCount() const;
+		size_t getSize() const;
+
+	private:
+		explicit Rom();
+		void allocate(size_t size);
+		bool map(const std::string &path);
+
+		const uint8_t *data;
+		uint8_t *buffer;
+		void *mapping;
+		size_t size;
+		unsigned int bankCount;
+	};
+}
\ No newline at end of file
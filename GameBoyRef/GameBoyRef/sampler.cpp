@@ -0,0 +1,112 @@
+#include "sampler.h"
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include "cartridge.h"
+#include "core.h"
+#include "cpuregisters.h"
+#include "memory.h"
+#include "symbols.h"
+
+namespace gameboy {
+	Sampler::Sampler(unsigned int interval) :
+		interval(interval > 0 ? interval : 1),
+		samples(0) {
+	}
+
+	Sampler::~Sampler() {
+	}
+
+	// Return addresses are guessed: a stack word counts if the bytes before
+	// it are a CALL or RST. Data that happens to look like one adds a frame
+	// to that sample but never corrupts later ones.
+	void Sampler::sample(Core &core) {
+		std::vector<uint32_t> stack;
+		uint16_t pc = core.registers->pc;
+		stack.push_back((getBank(core, pc) << 16) | pc);
+
+		uint16_t sp = core.registers->getSP();
+		for (unsigned int i = 0; i < StackDepth && sp >= 0x8000 && sp < 0xFFFE; i++, sp += 2) {
+			if (sp >= Memory::IoAddress && sp < Memory::IoAddress + Memory::IoSize) {
+				break;
+			}
+
+			uint16_t word = core.memory->readW(sp);
+			uint16_t site;
+			uint8_t call = core.memory->read(word - 3);
+			uint8_t rst = core.memory->read(word - 1);
+			if (call == 0xCD || call == 0xC4 || call == 0xCC || call == 0xD4 || call == 0xDC) {
+				site = word - 3;
+			}
+			else if ((rst & 0xC7) == 0xC7) {
+				site = word - 1;
+			}
+			else {
+				continue;
+			}
+
+			stack.push_back((getBank(core, site) << 16) | site);
+		}
+
+		++stacks[stack];
+		++samples;
+	}
+
+	void Sampler::clear() {
+		stacks.clear();
+		samples = 0;
+	}
+
+	unsigned int Sampler::getInterval() const {
+		return interval;
+	}
+
+	uint64_t Sampler::getSampleCount() const {
+		return samples;
+	}
+
+	// One line per routine, cycles are samples times the interval
+	void Sampler::writeReport(std::ostream &out, const SymbolTable &symbols) const {
+		struct Cost {
+			uint64_t self;
+			uint64_t inclusive;
+		};
+		std::unordered_map<std::string, Cost> costs;
+
+		for (auto it = stacks.begin(); it != stacks.end(); ++it) {
+			std::set<std::string> seen;
+			for (size_t i = 0; i < it->first.size(); i++) {
+				uint32_t location = it->first[i];
+				std::string name = symbols.resolve(location >> 16, location & 0xFFFF);
+				Cost &cost = costs.emplace(name, Cost{ 0, 0 }).first->second;
+				if (i == 0) {
+					cost.self += it->second;
+				}
+				if (seen.insert(name).second) {
+					cost.inclusive += it->second; // Recursion counts once per sample
+				}
+			}
+		}
+
+		std::vector<std::pair<std::string, Cost>> sorted(costs.begin(), costs.end());
+		std::sort(sorted.begin(), sorted.end(), [](const std::pair<std::string, Cost> &a, const std::pair<std::string, Cost> &b) {
+			return a.second.self != b.second.self ? a.second.self > b.second.self : a.second.inclusive > b.second.inclusive;
+		});
+
+		out << "function,self_cycles,inclusive_cycles\n";
+		for (auto it = sorted.begin(); it != sorted.end(); ++it) {
+			out << it->first << "," << it->second.self * interval << "," << it->second.inclusive * interval << "\n";
+		}
+	}
+
+	// Bank as a .sym file numbers it: the switchable ROM bank for
+	// 0x4000-0x7FFF, 0 everywhere else
+	unsigned int Sampler::getBank(const Core &core, uint16_t address) {
+		if (address >= 0x4000 && address < 0x8000 && core.cartridge != nullptr) {
+			return core.cartridge->getRomBank();
+		}
+		return 0;
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cinttypes>
+#include <map>
+#include <ostream>
+#include <vector>
+#include "core.h"
+
+namespace gameboy {
+	class SymbolTable;
+
+	// Samples the guest PC every interval M-cycles. Each sample also keeps the
+	// return addresses found on the guest stack, which gives inclusive costs
+	// without tracking calls. The report resolves both against a .sym file.
+	class GAMEBOY_API Sampler {
+	public:
+		static const unsigned int StackDepth = 16; // Stack words scanned for return addresses
+
+		explicit Sampler(unsigned int interval);
+		virtual ~Sampler();
+
+		void sample(Core &core);
+		void clear();
+		unsigned int getInterval() const;
+		uint64_t getSampleCount() const;
+		void writeReport(std::ostream &out, const SymbolTable &symbols) const;
+
+		static unsigned int getBank(const Core &core, uint16_t address);
+
+	private:
+		unsigned int interval;
+		uint64_t samples;
+		std::map<std::vector<uint32_t>, uint64_t> stacks; // Bank << 16 | address, innermost first
+	};
+}
\ No newline at end of file
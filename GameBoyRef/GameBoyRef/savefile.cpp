@@ -0,0 +1,128 @@
+#include "savefile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace gameboy {
+	// Creates the file if needed and grows it to size, new bytes read as 0.
+	// Returns null if the file can't be mapped.
+	SaveFile *SaveFile::open(const std::string &path, size_t size, std::chrono::milliseconds interval) {
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return nullptr;
+		}
+
+		HANDLE view = CreateFileMappingA(file, nullptr, PAGE_READWRITE, 0, (DWORD)size, nullptr);
+		CloseHandle(file);
+		if (view == nullptr) {
+			return nullptr;
+		}
+
+		void *mapping = MapViewOfFile(view, FILE_MAP_WRITE, 0, 0, size);
+		CloseHandle(view);
+		if (mapping == nullptr) {
+			return nullptr;
+		}
+#else
+		int file = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+		if (file < 0) {
+			return nullptr;
+		}
+
+		struct stat info;
+		if (fstat(file, &info) != 0 || (info.st_size < (off_t)size && ftruncate(file, size) != 0)) {
+			close(file);
+			return nullptr;
+		}
+
+		void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+		close(file);
+		if (mapping == MAP_FAILED) {
+			return nullptr;
+		}
+#endif
+		return new SaveFile(static_cast<uint8_t *>(mapping), size, interval);
+	}
+
+	SaveFile::SaveFile(uint8_t *data, size_t size, std::chrono::milliseconds interval) :
+		data(data),
+		size(size),
+		interval(interval),
+		dirty(false),
+		requested(false),
+		stopping(false) {
+		thread = std::thread(&SaveFile::worker, this);
+	}
+
+	SaveFile::~SaveFile() {
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			stopping = true;
+		}
+		wake.notify_one();
+		thread.join();
+
+		sync();
+#ifdef _WIN32
+		UnmapViewOfFile(data);
+#else
+		munmap(data, size);
+#endif
+	}
+
+	uint8_t *SaveFile::getData() {
+		return data;
+	}
+
+	size_t SaveFile::getSize() const {
+		return size;
+	}
+
+	// Called on every RAM write, so just a flag for the worker to pick up
+	void SaveFile::markDirty() {
+		dirty.store(true, std::memory_order_relaxed);
+	}
+
+	// Asks the worker to write the file back, returns immediately
+	void SaveFile::flush() {
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			requested = true;
+		}
+		wake.notify_one();
+	}
+
+	void SaveFile::worker() {
+		std::unique_lock<std::mutex> guard(mutex);
+		while (!stopping) {
+			wake.wait_for(guard, interval, [this] { return stopping || requested; });
+			if (stopping) {
+				break;
+			}
+
+			bool wanted = dirty.exchange(false, std::memory_order_relaxed) || requested;
+			requested = false;
+			if (wanted) {
+				guard.unlock();
+				sync();
+				guard.lock();
+			}
+		}
+	}
+
+	void SaveFile::sync() {
+#ifdef _WIN32
+		FlushViewOfFile(data, size);
+#else
+		msync(data, size, MS_SYNC);
+#endif
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace gameboy {
+	// Battery backed cartridge RAM mapped straight onto a .sav file. Writes
+	// through the mapping land in the page cache with no save step; a
+	// background thread syncs the file when asked to, and on a fixed interval
+	// if RAM was written since the last sync, so the emulation thread never
+	// waits on disk I/O and an idle cartridge costs no syncs.
+	class SaveFile {
+	public:
+		static SaveFile *open(const std::string &path, size_t size, std::chrono::milliseconds interval = std::chrono::milliseconds(1000));
+		virtual ~SaveFile();
+
+		uint8_t *getData();
+		size_t getSize() const;
+		void markDirty();
+		void flush();
+
+	private:
+		explicit SaveFile(uint8_t *data, size_t size, std::chrono::milliseconds interval);
+		void worker();
+		void sync();
+
+		uint8_t *data;
+		size_t size;
+		std::chrono::milliseconds interval;
+		std::atomic<bool> dirty;
+		bool requested;
+		bool stopping;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::thread thread;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cinttypes>
+
+namespace gameboy {
+	const uint32_t SaveStateMagic = 0x53424247; // "GBBS"
+	const uint32_t SaveStateVersion = 5;
+	const unsigned int SaveStateCartridgeRamSize = 0x20000; // Largest RAM a cartridge header can declare
+
+	struct CartridgeState {
+		uint64_t rtcSeconds; // RTC time in seconds at rtcClock
+		uint64_t rtcClock;
+		uint16_t romBank;
+		uint8_t ramBank;
+		uint8_t ramEnabled;
+		uint8_t mode; // MBC1 banking mode, MBC3 RTC register select
+		uint8_t rtcLatch;
+		uint8_t rtcFlags;
+		uint8_t rtcLatched[5];
+		uint8_t reserved[4];
+	};
+
+	// Devices outside Memory that are only present once a cartridge is loaded
+	struct IoState {
+		uint64_t gpuEvent; // Clock of the next LCD mode change
+		uint64_t frames;
+		uint64_t serialEvent; // Clock the serial transfer in progress ends
+		uint64_t divReset;
+		uint64_t timerSynced;
+		uint8_t lcdc;
+		uint8_t stat;
+		uint8_t ly;
+		uint8_t lyc;
+		uint8_t gpuMode;
+		uint8_t coincidence;
+		uint8_t joypadSelect;
+		uint8_t joypadButtons;
+		uint8_t serialData;
+		uint8_t serialControl;
+		uint8_t tima;
+		uint8_t tma;
+		uint8_t tac;
+		uint8_t reserved[3];
+	};
+
+	// Fixed layout snapshot of a Core. Fields are ordered so the struct has no
+	// padding, which lets the whole thing be written and read back as one blob.
+	struct SaveState {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t size;
+		uint32_t reserved;
+		uint64_t clock;
+		uint8_t registers[8]; // A, B, C, D, E, F, H, L
+		uint16_t sp;
+		uint16_t pc;
+		uint8_t ime;
+		uint8_t conditional;
+		uint8_t halted;
+		uint8_t padding;
+		CartridgeState cartridge;
+		IoState io;
+		uint8_t memory[0x10000];
+		uint8_t allocated[0x10000 / 8];
+		uint8_t cartridgeRam[SaveStateCartridgeRamSize];
+	};
+
+	static_assert(sizeof(CartridgeState) == 32, "CartridgeState must not contain padding");
+	static_assert(sizeof(IoState) == 56, "IoState must not contain padding");
+	static_assert(sizeof(SaveState) == 128 + 0x10000 + 0x10000 / 8 + SaveStateCartridgeRamSize, "SaveState must not contain padding");
+}
\ No newline at end of file
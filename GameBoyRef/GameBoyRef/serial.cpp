@@ -0,0 +1,88 @@
+#include "serial.h"
+
+#include "memory.h"
+#include "savestate.h"
+
+namespace gameboy {
+	Serial::Serial() :
+		memory(nullptr),
+		transferEnd(NoEvent),
+		data(0),
+		control(0) {
+	}
+
+	// Copies have to be attached to a Memory of their own
+	Serial::Serial(const Serial &other) :
+		memory(nullptr),
+		transferEnd(other.transferEnd),
+		data(other.data),
+		control(other.control),
+		output(other.output) {
+	}
+
+	Serial::~Serial() {
+	}
+
+	void Serial::attach(Memory *memory) {
+		this->memory = memory;
+		memory->mapIo(DataAddress, this);
+		memory->mapIo(ControlAddress, this);
+		memory->addClocked(this);
+	}
+
+	uint8_t Serial::readIo(uint16_t address) {
+		return address == DataAddress ? data : 0x7E | control;
+	}
+
+	// Setting bits 7 and 0 of SC together starts a transfer. With the external
+	// clock nothing ever drives the transfer, so it never finishes.
+	void Serial::writeIo(uint16_t address, uint8_t value) {
+		if (address == DataAddress) {
+			data = value;
+			return;
+		}
+
+		control = value & 0x81;
+		if (control == 0x81) {
+			output.push_back((char)data);
+			transferEnd = memory->getClock() + TransferCycles;
+			memory->schedule(transferEnd);
+		}
+		else {
+			transferEnd = NoEvent;
+		}
+	}
+
+	uint64_t Serial::update(uint64_t clock) {
+		if (clock >= transferEnd) {
+			transferEnd = NoEvent;
+			data = 0xFF;
+			control &= 0x7F;
+			memory->requestInterrupt(SerialInterrupt);
+		}
+
+		return transferEnd;
+	}
+
+	void Serial::saveState(SaveState &state) const {
+		state.io.serialEvent = transferEnd;
+		state.io.serialData = data;
+		state.io.serialControl = control;
+	}
+
+	// Only the transfer in progress is restored, output sent so far stays
+	void Serial::loadState(const SaveState &state) {
+		transferEnd = state.io.serialEvent;
+		data = state.io.serialData;
+		control = state.io.serialControl & 0x81;
+	}
+
+	// Every byte the guest has sent, in order
+	const std::string &Serial::getOutput() const {
+		return output;
+	}
+
+	void Serial::clearOutput() {
+		output.clear();
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cinttypes>
+#include <string>
+#include "core.h"
+#include "iodevice.h"
+
+namespace gameboy {
+	class Memory;
+	struct SaveState;
+
+	// SB (0xFF01) and SC (0xFF02) with nothing on the other end of the link
+	// cable. Transfers on the internal clock take 8 bits at 8192 Hz, shift in
+	// 0xFF and interrupt when done; every byte sent is kept so test ROMs that
+	// report over serial can be read back.
+	class GAMEBOY_API Serial : public IoDevice, public ClockedDevice {
+	public:
+		static const uint16_t DataAddress = 0xFF01;
+		static const uint16_t ControlAddress = 0xFF02;
+		static const unsigned int TransferCycles = 1024;
+
+		explicit Serial();
+		Serial(const Serial &other);
+		virtual ~Serial();
+
+		void attach(Memory *memory);
+		uint8_t readIo(uint16_t address);
+		void writeIo(uint16_t address, uint8_t value);
+		uint64_t update(uint64_t clock);
+		void saveState(SaveState &state) const;
+		void loadState(const SaveState &state);
+		const std::string &getOutput() const;
+		void clearOutput();
+
+	private:
+		Serial &operator=(const Serial &other);
+
+		Memory *memory;
+		uint64_t transferEnd;
+		uint8_t data;
+		uint8_t control;
+		std::string output;
+	};
+}
\ No newline at end of file
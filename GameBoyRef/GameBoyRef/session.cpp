@@ -0,0 +1,243 @@
+#include "session.h"
+
+#include <algorithm>
+#include "gpu.h"
+#include "joypad.h"
+#include "rom.h"
+
+namespace gameboy {
+	Session::Session(Core *core) :
+		core(core),
+		startClock(core->getClock()),
+		frames(0),
+		head(0),
+		tail(0),
+		queued(false),
+		running(false),
+		paused(false),
+		closed(false) {
+	}
+
+	Session::~Session() {
+		delete core;
+	}
+
+	// Queues the buttons held from the next frame on. Only one thread may
+	// push to a session. Returns false if the mailbox is full.
+	bool Session::pushButtons(uint8_t buttons) {
+		uint32_t position = tail.load(std::memory_order_relaxed);
+		if (position - head.load(std::memory_order_acquire) >= MailboxSize) {
+			return false;
+		}
+
+		mailbox[position % MailboxSize] = buttons;
+		tail.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Frames run so far
+	uint64_t Session::getFrameCount() const {
+		return frames.load(std::memory_order_relaxed);
+	}
+
+	bool Session::popButtons(uint8_t &buttons) {
+		uint32_t position = head.load(std::memory_order_relaxed);
+		if (position == tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+
+		buttons = mailbox[position % MailboxSize];
+		head.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	// speed scales the frame rate, 1 is the DMG's 59.73 Hz
+	SessionScheduler::SessionScheduler(unsigned int threads, double speed) :
+		period((int64_t)(1e9 * Gpu::FrameCycles / CyclesPerSecond / speed)),
+		stopping(false),
+		frameCount(0),
+		lateCount(0),
+		skipCount(0),
+		maxLateness(0) {
+		if (threads == 0) {
+			threads = 1;
+		}
+		for (unsigned int i = 0; i < threads; i++) {
+			this->threads.push_back(std::thread(&SessionScheduler::worker, this));
+		}
+	}
+
+	// Stops the workers and closes every session still open
+	SessionScheduler::~SessionScheduler() {
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (auto it = threads.begin(); it != threads.end(); ++it) {
+			it->join();
+		}
+
+		for (auto it = sessions.begin(); it != sessions.end(); ++it) {
+			delete *it;
+		}
+	}
+
+	// Boots rom in a new session whose first frame is due a frame from now.
+	// Returns null if the cartridge type isn't supported.
+	Session *SessionScheduler::open(std::shared_ptr<const Rom> rom) {
+		Core *core = new Core();
+		if (!rom || !core->loadCartridge(rom)) {
+			delete core;
+			return nullptr;
+		}
+		core->boot();
+
+		Session *session = new Session(core);
+		std::lock_guard<std::mutex> guard(mutex);
+		sessions.insert(session);
+		session->deadline = std::chrono::steady_clock::now() + period;
+		enqueue(session);
+		return session;
+	}
+
+	// The session is freed once no worker is running it, it can't be used
+	// after this
+	void SessionScheduler::close(Session *session) {
+		std::lock_guard<std::mutex> guard(mutex);
+		session->closed = true;
+		if (!session->queued && !session->running) {
+			destroy(session);
+		}
+	}
+
+	// A paused session drops out of the queue the next time it comes up
+	void SessionScheduler::pause(Session *session) {
+		std::lock_guard<std::mutex> guard(mutex);
+		session->paused = true;
+	}
+
+	// Carries on with the next frame due a frame from now
+	void SessionScheduler::resume(Session *session) {
+		std::lock_guard<std::mutex> guard(mutex);
+		session->paused = false;
+		if (!session->queued && !session->running && !session->closed) {
+			session->deadline = std::chrono::steady_clock::now() + period;
+			enqueue(session);
+		}
+	}
+
+	void SessionScheduler::setFrameCallback(FrameCallback callback) {
+		std::lock_guard<std::mutex> guard(mutex);
+		frameCallback = callback;
+	}
+
+	// Frames run over every session
+	uint64_t SessionScheduler::getFrameCount() const {
+		return frameCount;
+	}
+
+	// Frames finished after their deadline
+	uint64_t SessionScheduler::getLateCount() const {
+		return lateCount;
+	}
+
+	// Frames dropped by sessions that fell more than MaxLag frames behind
+	uint64_t SessionScheduler::getSkipCount() const {
+		return skipCount;
+	}
+
+	std::chrono::nanoseconds SessionScheduler::getMaxLateness() const {
+		return std::chrono::nanoseconds(maxLateness.load());
+	}
+
+	// A frame can start one period before its deadline. Workers sleep until
+	// the earliest deadline's frame can start, and a newly queued session
+	// wakes one to look again.
+	void SessionScheduler::worker() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (!stopping) {
+			if (heap.empty()) {
+				wake.wait(lock);
+				continue;
+			}
+
+			Session *session = heap.front();
+			auto start = session->deadline - period;
+			if (start > std::chrono::steady_clock::now()) {
+				wake.wait_until(lock, start);
+				continue;
+			}
+
+			std::pop_heap(heap.begin(), heap.end(), Later());
+			heap.pop_back();
+			session->queued = false;
+			if (session->closed) {
+				destroy(session);
+				continue;
+			}
+			if (session->paused) {
+				continue;
+			}
+
+			session->running = true;
+			FrameCallback callback = frameCallback;
+			lock.unlock();
+			runFrame(*session);
+			if (callback) {
+				callback(*session, *session->core);
+			}
+			lock.lock();
+			session->running = false;
+
+			if (session->closed) {
+				destroy(session);
+				continue;
+			}
+
+			auto now = std::chrono::steady_clock::now();
+			int64_t late = std::chrono::duration_cast<std::chrono::nanoseconds>(now - session->deadline).count();
+			if (late > 0) {
+				++lateCount;
+				int64_t worst = maxLateness.load();
+				while (late > worst && !maxLateness.compare_exchange_weak(worst, late)) {
+				}
+			}
+			if (late > (int64_t)MaxLag * period.count()) {
+				skipCount += late / period.count();
+				session->deadline = now;
+			}
+
+			if (!session->paused) {
+				session->deadline += period;
+				enqueue(session);
+			}
+		}
+	}
+
+	// Applies at most one queued input, then runs exactly one frame of cycles
+	// counted from when the session started
+	void SessionScheduler::runFrame(Session &session) {
+		uint8_t buttons;
+		if (session.popButtons(buttons)) {
+			session.core->joypad->setButtons(buttons);
+		}
+
+		uint64_t frame = session.frames.load(std::memory_order_relaxed) + 1;
+		session.core->runUntil(session.startClock + frame * Gpu::FrameCycles);
+		session.frames.store(frame, std::memory_order_relaxed);
+		++frameCount;
+	}
+
+	void SessionScheduler::enqueue(Session *session) {
+		session->queued = true;
+		heap.push_back(session);
+		std::push_heap(heap.begin(), heap.end(), Later());
+		wake.notify_one();
+	}
+
+	void SessionScheduler::destroy(Session *session) {
+		sessions.erase(session);
+		delete session;
+	}
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "core.h"
+
+namespace gameboy {
+	class Rom;
+	class SessionScheduler;
+
+	// One live Core hosted by a SessionScheduler. Input goes through a
+	// lock-free single producer mailbox, one entry is applied per frame so
+	// a press and release queued together still last a frame each.
+	class GAMEBOY_API Session {
+	public:
+		static const unsigned int MailboxSize = 64;
+
+		bool pushButtons(uint8_t buttons);
+		uint64_t getFrameCount() const;
+
+	private:
+		friend class SessionScheduler;
+
+		explicit Session(Core *core);
+		Session(const Session &);
+		Session &operator=(const Session &);
+		virtual ~Session();
+
+		bool popButtons(uint8_t &buttons);
+
+		Core *core;
+		uint64_t startClock;
+		std::atomic<uint64_t> frames;
+		std::atomic<uint32_t> head; // Next entry the worker reads
+		std::atomic<uint32_t> tail; // Next entry the host writes
+		uint8_t mailbox[MailboxSize];
+
+		// Guarded by the scheduler's mutex
+		std::chrono::steady_clock::time_point deadline; // When the frame being run next is due
+		bool queued;
+		bool running;
+		bool paused;
+		bool closed;
+	};
+
+	// Multiplexes many Sessions onto a fixed set of worker threads in frame
+	// sized slices. Each session's next frame is due one frame period after
+	// its last, and the workers always run the earliest deadline among the
+	// sessions whose frame has started, so every session keeps up with real
+	// time while there's capacity. A session that falls more than a few
+	// frames behind drops them rather than running a burst to catch up.
+	// Paused sessions leave the queue and cost nothing, halted guests skip
+	// to their next event through Core::runUntil.
+	class GAMEBOY_API SessionScheduler {
+	public:
+		// Called on a worker after every frame a session runs
+		typedef std::function<void(Session &session, const Core &core)> FrameCallback;
+
+		static const uint64_t CyclesPerSecond = 1048576; // M-cycles
+		static const unsigned int MaxLag = 4; // Frames behind before a session skips ahead
+
+		explicit SessionScheduler(unsigned int threads, double speed = 1.0);
+		virtual ~SessionScheduler();
+
+		Session *open(std::shared_ptr<const Rom> rom);
+		void close(Session *session);
+		void pause(Session *session);
+		void resume(Session *session);
+		void setFrameCallback(FrameCallback callback);
+		uint64_t getFrameCount() const;
+		uint64_t getLateCount() const;
+		uint64_t getSkipCount() const;
+		std::chrono::nanoseconds getMaxLateness() const;
+
+	private:
+		struct Later {
+			bool operator()(const Session *a, const Session *b) const {
+				return a->deadline > b->deadline;
+			}
+		};
+
+		SessionScheduler(const SessionScheduler &);
+		SessionScheduler &operator=(const SessionScheduler &);
+
+		void worker();
+		void runFrame(Session &session);
+		void enqueue(Session *session);
+		void destroy(Session *session);
+
+		std::chrono::nanoseconds period;
+		FrameCallback frameCallback;
+		std::unordered_set<Session *> sessions;
+		std::vector<Session *> heap; // Min-heap on deadline
+		std::vector<std::thread> threads;
+		bool stopping;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::atomic<uint64_t> frameCount;
+		std::atomic<uint64_t> lateCount;
+		std::atomic<uint64_t> skipCount;
+		std::atomic<int64_t> maxLateness; // Nanoseconds
+	};
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#include "symbols.h"
+
+#include <cstdio>
+#include <fstream>
+
+namespace gameboy {
+	SymbolTable::SymbolTable() {
+	}
+
+	SymbolTable::~SymbolTable() {
+	}
+
+	bool SymbolTable::load(const std::string &path) {
+		std::ifstream in(path);
+		if (!in) {
+			return false;
+		}
+
+		std::string line;
+		while (std::getline(in, line)) {
+			unsigned int bank, address;
+			char name[256];
+			if (line.empty() || line[0] == ';' || sscanf(line.c_str(), "%x:%x %255s", &bank, &address, name) != 3) {
+				continue;
+			}
+
+			std::string label(name);
+			if (label.find('.') == std::string::npos) {
+				add(bank, address, label);
+			}
+		}
+		return true;
+	}
+
+	void SymbolTable::add(unsigned int bank, uint16_t address, const std::string &name) {
+		symbols[key(bank, address)] = name;
+	}
+
+	// Name of the closest label at or below address in the same bank, or
+	// "BB:AAAA" if there's none. Banks are compared as the .sym file numbers
+	// them, 0 for everything outside the switchable ROM window.
+	std::string SymbolTable::resolve(unsigned int bank, uint16_t address) const {
+		auto it = symbols.upper_bound(key(bank, address));
+		if (it != symbols.begin()) {
+			--it;
+			if ((it->first >> 16) == bank) {
+				return it->second;
+			}
+		}
+
+		char name[16];
+		snprintf(name, sizeof(name), "%02X:%04X", bank, address);
+		return name;
+	}
+
+	bool SymbolTable::empty() const {
+		return symbols.empty();
+	}
+
+	uint32_t SymbolTable::key(unsigned int bank, uint16_t address) {
+		return (bank << 16) | address;
+	}
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cinttypes>
+#include <map>
+#include <string>
+#include "core.h"
+
+namespace gameboy {
+	// Labels from an RGBDS or no$gmb style .sym file, lines of the form
+	// "BB:AAAA Label". Local labels (containing a '.') are skipped so
+	// addresses resolve to the enclosing routine.
+	class GAMEBOY_API SymbolTable {
+	public:
+		explicit SymbolTable();
+		virtual ~SymbolTable();
+
+		bool load(const std::string &path);
+		void add(unsigned int bank, uint16_t address, const std::string &name);
+		std::string resolve(unsigned int bank, uint16_t address) const;
+		bool empty() const;
+
+	private:
+		static uint32_t key(unsigned int bank, uint16_t address);
+
+		std::map<uint32_t, std::string> symbols;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include "timer.h"
+
+#include "memory.h"
+#include "savestate.h"
+
+namespace gameboy {
+	// TIMA period in M-cycles for each TAC clock select
+	static const uint64_t periods[] = { 256, 4, 16, 64 };
+
+	// DIV counts up every 64 M-cycles (16384 Hz)
+	static const unsigned int DivShift = 6;
+
+	Timer::Timer() :
+		memory(nullptr),
+		divReset(0),
+		synced(0),
+		overflow(NoEvent),
+		tima(0),
+		tma(0),
+		tac(0) {
+	}
+
+	// Copies have to be attached to a Memory of their own
+	Timer::Timer(const Timer &other) :
+		memory(nullptr),
+		divReset(other.divReset),
+		synced(other.synced),
+		overflow(other.overflow),
+		tima(other.tima),
+		tma(other.tma),
+		tac(other.tac) {
+	}
+
+	Timer::~Timer() {
+	}
+
+	void Timer::attach(Memory *memory) {
+		this->memory = memory;
+		memory->mapIo(DivAddress, this);
+		memory->mapIo(TimaAddress, this);
+		memory->mapIo(TmaAddress, this);
+		memory->mapIo(TacAddress, this);
+		memory->addClocked(this);
+	}
+
+	uint8_t Timer::readIo(uint16_t address) {
+		uint64_t clock = memory->getClock();
+		switch (address) {
+		case DivAddress:
+			return (uint8_t)((clock - divReset) >> DivShift);
+		case TimaAddress:
+			sync(clock);
+			return tima;
+		case TmaAddress:
+			return tma;
+		default:
+			return 0xF8 | tac;
+		}
+	}
+
+	void Timer::writeIo(uint16_t address, uint8_t value) {
+		uint64_t clock = memory->getClock();
+		sync(clock);
+		switch (address) {
+		case DivAddress:
+			divReset = clock;
+			break;
+		case TimaAddress:
+			tima = value;
+			break;
+		case TmaAddress:
+			tma = value;
+			break;
+		default:
+			tac = value & 0x07;
+			break;
+		}
+		reschedule();
+	}
+
+	uint64_t Timer::update(uint64_t clock) {
+		if (clock >= overflow) {
+			sync(clock);
+			reschedule();
+		}
+
+		return overflow;
+	}
+
+	void Timer::saveState(SaveState &state) const {
+		state.io.divReset = divReset;
+		state.io.timerSynced = synced;
+		state.io.tima = tima;
+		state.io.tma = tma;
+		state.io.tac = tac;
+	}
+
+	void Timer::loadState(const SaveState &state) {
+		divReset = state.io.divReset;
+		synced = state.io.timerSynced;
+		tima = state.io.tima;
+		tma = state.io.tma;
+		tac = state.io.tac & 0x07;
+		reschedule();
+	}
+
+	bool Timer::isEnabled() const {
+		return (tac & 0x04) != 0;
+	}
+
+	uint64_t Timer::getPeriod() const {
+		return periods[tac & 0x03];
+	}
+
+	// Counts the TIMA ticks between synced and clock, reloading from TMA and
+	// requesting the interrupt on each overflow
+	void Timer::sync(uint64_t clock) {
+		if (clock <= synced) {
+			return;
+		}
+		if (!isEnabled()) {
+			synced = clock;
+			return;
+		}
+
+		uint64_t period = getPeriod();
+		uint64_t ticks = (clock - divReset) / period - (synced - divReset) / period;
+		synced = clock;
+		while (ticks >= 0x100u - tima) {
+			ticks -= 0x100u - tima;
+			tima = tma;
+			memory->requestInterrupt(TimerInterrupt);
+		}
+		tima += (uint8_t)ticks;
+	}
+
+	// Works out when TIMA next overflows from the state at synced
+	void Timer::reschedule() {
+		if (!isEnabled()) {
+			overflow = NoEvent;
+			return;
+		}
+
+		uint64_t period = getPeriod();
+		uint64_t first = divReset + ((synced - divReset) / period + 1) * period;
+		overflow = first + (0xFFu - tima) * period;
+		memory->schedule(overflow);
+	}
+}
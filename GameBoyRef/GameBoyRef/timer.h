@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cinttypes>
+#include "iodevice.h"
+
+namespace gameboy {
+	class Memory;
+	struct SaveState;
+
+	// DIV, TIMA, TMA and TAC (0xFF04-0xFF07). Nothing ticks per cycle: DIV is
+	// worked out from the clock it was last reset at, TIMA is brought up to
+	// date when it's read or written and the only scheduled event is its
+	// next overflow. TIMA counts on multiples of its period since the DIV
+	// reset, like the hardware's divider taps.
+	class Timer : public IoDevice, public ClockedDevice {
+	public:
+		static const uint16_t DivAddress = 0xFF04;
+		static const uint16_t TimaAddress = 0xFF05;
+		static const uint16_t TmaAddress = 0xFF06;
+		static const uint16_t TacAddress = 0xFF07;
+
+		explicit Timer();
+		Timer(const Timer &other);
+		virtual ~Timer();
+
+		void attach(Memory *memory);
+		uint8_t readIo(uint16_t address);
+		void writeIo(uint16_t address, uint8_t value);
+		uint64_t update(uint64_t clock);
+		void saveState(SaveState &state) const;
+		void loadState(const SaveState &state);
+
+	private:
+		Timer &operator=(const Timer &other);
+		bool isEnabled() const;
+		uint64_t getPeriod() const;
+		void sync(uint64_t clock);
+		void reschedule();
+
+		Memory *memory;
+		uint64_t divReset; // Clock DIV was last reset at
+		uint64_t synced; // Clock TIMA is up to date to
+		uint64_t overflow; // Clock of TIMA's next overflow, NoEvent while stopped
+		uint8_t tima;
+		uint8_t tma;
+		uint8_t tac;
+	};
+}
\ No newline at end of file
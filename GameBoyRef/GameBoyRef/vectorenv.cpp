@@ -0,0 +1,223 @@
+#include "vectorenv.h"
+
+#include <algorithm>
+#include <cstring>
+#include "gpu.h"
+#include "joypad.h"
+#include "memory.h"
+#include "rom.h"
+#include "savestate.h"
+
+namespace gameboy {
+	VectorEnv::VectorEnv(unsigned int scale, const std::vector<uint16_t> &ramAddresses) :
+		scale(scale),
+		width(Gpu::ScreenWidth / scale),
+		height(Gpu::ScreenHeight / scale),
+		ramAddresses(ramAddresses),
+		resetState(new SaveState()),
+		frames(0),
+		task(Step),
+		actions(nullptr),
+		frameskip(0),
+		observations(nullptr),
+		next(0),
+		generation(0),
+		busy(0),
+		stopping(false) {
+		unsigned int darkest = 3 * scale * scale;
+		for (unsigned int sum = 0; sum <= darkest; sum++) {
+			grays.push_back((uint8_t)(255 - (sum * 255 + darkest / 2) / darkest));
+		}
+		resetObservation.resize(getObservationSize());
+	}
+
+	// scale has to divide both sides of the screen: 1, 2, 4, 8 or 16.
+	// threads 0 means one per core. Returns nullptr if scale doesn't or the
+	// cartridge type isn't supported.
+	VectorEnv *VectorEnv::open(std::shared_ptr<const Rom> rom, unsigned int count, unsigned int scale, const std::vector<uint16_t> &ramAddresses, unsigned int threads) {
+		if (!rom || count == 0 || scale == 0 || Gpu::ScreenWidth % scale != 0 || Gpu::ScreenHeight % scale != 0) {
+			return nullptr;
+		}
+
+		Core base;
+		if (!base.loadCartridge(rom)) {
+			return nullptr;
+		}
+		base.boot();
+
+		runFrame(base);
+
+		VectorEnv *env = new VectorEnv(scale, ramAddresses);
+		base.saveState(*env->resetState);
+		env->observe(base, env->resetObservation.data());
+		for (unsigned int i = 0; i < count; i++) {
+			env->cores.push_back(base.fork());
+		}
+
+		if (threads == 0) {
+			threads = std::thread::hardware_concurrency();
+		}
+		for (unsigned int i = 1; i < threads && i < count; i++) {
+			env->threads.push_back(std::thread(&VectorEnv::worker, env));
+		}
+		return env;
+	}
+
+	VectorEnv::~VectorEnv() {
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (auto it = threads.begin(); it != threads.end(); ++it) {
+			it->join();
+		}
+
+		for (auto it = cores.begin(); it != cores.end(); ++it) {
+			delete *it;
+		}
+	}
+
+	// Puts environment i back to the reset state where mask[i] is non-zero,
+	// every environment if mask is null. Only those environments have their
+	// observation written.
+	void VectorEnv::reset(const uint8_t *mask, uint8_t *observations) {
+		this->actions = mask;
+		this->observations = observations;
+		run(Reset);
+	}
+
+	// Holds actions[i] (Joypad::Button bits) on environment i for frameskip
+	// frames and writes the observation after the last
+	void VectorEnv::step(const uint8_t *actions, unsigned int frameskip, uint8_t *observations) {
+		this->actions = actions;
+		this->frameskip = frameskip;
+		this->observations = observations;
+		run(Step);
+		frames += (uint64_t)cores.size() * frameskip;
+	}
+
+	// Makes environment index's current state the one later resets go back
+	// to, for starting episodes somewhere past the title screen
+	void VectorEnv::setResetState(unsigned int index) {
+		cores[index]->saveState(*resetState);
+		observe(*cores[index], resetObservation.data());
+	}
+
+	unsigned int VectorEnv::getCount() const {
+		return (unsigned int)cores.size();
+	}
+
+	unsigned int VectorEnv::getWidth() const {
+		return width;
+	}
+
+	unsigned int VectorEnv::getHeight() const {
+		return height;
+	}
+
+	// Bytes per environment, width * height of screen then the RAM bytes
+	size_t VectorEnv::getObservationSize() const {
+		return width * height + ramAddresses.size();
+	}
+
+	// Environment frames stepped so far, summed over every environment
+	uint64_t VectorEnv::getFrameCount() const {
+		return frames;
+	}
+
+	const Core &VectorEnv::getCore(unsigned int index) const {
+		return *cores[index];
+	}
+
+	void VectorEnv::run(Task task) {
+		this->task = task;
+		next = 0;
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			busy = (unsigned int)threads.size();
+			++generation;
+		}
+		wake.notify_all();
+
+		work();
+		std::unique_lock<std::mutex> lock(mutex);
+		idle.wait(lock, [this] { return busy == 0; });
+	}
+
+	void VectorEnv::worker() {
+		uint64_t seen = 0;
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			wake.wait(lock, [&] { return stopping || generation != seen; });
+			if (stopping) {
+				return;
+			}
+
+			seen = generation;
+			lock.unlock();
+			work();
+			lock.lock();
+			if (--busy == 0) {
+				idle.notify_one();
+			}
+		}
+	}
+
+	// Environments are taken one at a time. Each is at least a frame of
+	// emulation, so the shared counter costs next to nothing.
+	void VectorEnv::work() {
+		size_t size = getObservationSize();
+		for (unsigned int i = next++; i < cores.size(); i = next++) {
+			Core *core = cores[i];
+			uint8_t *observation = observations + i * size;
+			if (task == Reset) {
+				if (actions == nullptr || actions[i] != 0) {
+					core->loadState(*resetState);
+					memcpy(observation, resetObservation.data(), size);
+				}
+				continue;
+			}
+
+			// Only the frame observed is drawn
+			core->joypad->setButtons(actions[i]);
+			core->gpu->setDrawing(false);
+			for (unsigned int frame = 1; frame < frameskip; frame++) {
+				runFrame(*core);
+			}
+			core->gpu->setDrawing(true);
+			runFrame(*core);
+			observe(*core, observation);
+		}
+	}
+
+	// Runs to the start of the next VBlank, or for a frame's worth of
+	// cycles while the LCD is off
+	void VectorEnv::runFrame(Core &core) {
+		core.runUntil(std::min(core.gpu->getNextVBlank(), core.getClock() + Gpu::FrameCycles));
+	}
+
+	// Each gray is the mean shade of a scale by scale block
+	void VectorEnv::observe(const Core &core, uint8_t *observation) const {
+		const uint8_t *frame = core.gpu->getFrameBuffer();
+		uint16_t sums[Gpu::ScreenWidth];
+		for (unsigned int y = 0; y < height; y++) {
+			memset(sums, 0, width * sizeof(sums[0]));
+			for (unsigned int row = 0; row < scale; row++) {
+				const uint8_t *line = &frame[(y * scale + row) * Gpu::ScreenWidth];
+				for (unsigned int x = 0; x < Gpu::ScreenWidth; x++) {
+					sums[x / scale] += line[x];
+				}
+			}
+
+			for (unsigned int x = 0; x < width; x++) {
+				observation[y * width + x] = grays[sums[x]];
+			}
+		}
+
+		uint8_t *ram = observation + width * height;
+		for (size_t i = 0; i < ramAddresses.size(); i++) {
+			ram[i] = core.memory->read(ramAddresses[i]);
+		}
+	}
+}
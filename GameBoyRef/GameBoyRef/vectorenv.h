@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "core.h"
+
+namespace gameboy {
+	class Rom;
+	struct SaveState;
+
+	// A fixed set of Cores on one ROM stepped together, for training agents.
+	// Each environment's observation is the screen downsampled by scale in
+	// both directions to 8-bit grayscale (255 white), followed by the bytes
+	// at the chosen RAM addresses. Observations for every environment go
+	// straight into one caller buffer, getObservationSize apart, with
+	// nothing allocated per step.
+	//
+	// A step runs each environment to the start of VBlank frameskip times,
+	// so observations are of complete frames. While the LCD is off a frame
+	// is Gpu::FrameCycles. Environments start from a save state taken at
+	// the first VBlank after boot, and reset by loading it back.
+	//
+	// Steps are spread over a pool of threads that stays up between calls;
+	// the calling thread takes environments as well.
+	class GAMEBOY_API VectorEnv {
+	public:
+		static VectorEnv *open(std::shared_ptr<const Rom> rom, unsigned int count, unsigned int scale, const std::vector<uint16_t> &ramAddresses, unsigned int threads = 0);
+		virtual ~VectorEnv();
+
+		void reset(const uint8_t *mask, uint8_t *observations);
+		void step(const uint8_t *actions, unsigned int frameskip, uint8_t *observations);
+		void setResetState(unsigned int index);
+		unsigned int getCount() const;
+		unsigned int getWidth() const;
+		unsigned int getHeight() const;
+		size_t getObservationSize() const;
+		uint64_t getFrameCount() const;
+		const Core &getCore(unsigned int index) const;
+
+	private:
+		enum Task {
+			Reset,
+			Step
+		};
+
+		explicit VectorEnv(unsigned int scale, const std::vector<uint16_t> &ramAddresses);
+		VectorEnv(const VectorEnv &);
+		VectorEnv &operator=(const VectorEnv &);
+
+		void run(Task task);
+		void worker();
+		void work();
+		void observe(const Core &core, uint8_t *observation) const;
+		static void runFrame(Core &core);
+
+		std::vector<Core *> cores;
+		unsigned int scale;
+		unsigned int width;
+		unsigned int height;
+		std::vector<uint16_t> ramAddresses;
+		std::vector<uint8_t> grays; // Gray for each possible sum of shades over a scale by scale block
+		std::unique_ptr<SaveState> resetState;
+		std::vector<uint8_t> resetObservation; // Observation of resetState, the frame buffer isn't part of it
+		uint64_t frames;
+
+		// The call in progress, read by the workers
+		Task task;
+		const uint8_t *actions; // Or the reset mask
+		unsigned int frameskip;
+		uint8_t *observations;
+		std::atomic<unsigned int> next; // Next environment to take
+
+		std::vector<std::thread> threads;
+		uint64_t generation; // Counts calls, workers wait for it to change
+		unsigned int busy; // Workers still on the current call
+		bool stopping;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable idle;
+	};
+}
\ No newline at end of file